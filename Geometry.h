@@ -70,16 +70,17 @@ namespace vk {
         };
 
         struct Icosahedron : test_Mesh {
-            Icosahedron(float radius, int count) : test_Mesh(createVertices(radius), indices) {
-                vertices = createVertices(radius);
+            Icosahedron(float radius, int count) : vertices(createVertices(radius)), indices(baseIndices) {
                 if (count) {
                     subdivide(radius, count);
-                    test_Mesh::subdivide(vertices, indices);
                 }
+                // Built from the members so the optimizer's vertex order matches the CPU copy
+                build(vertices, indices);
             }
         public:
             // Define the 12 vertices of an icosahedron
             std::vector<triangleList> vertices;
+            std::vector<uint16_t> indices;      // This one's, subdivided from baseIndices
             inline static std::vector<triPrim> idx = {
                 {5, 0, 4}, {4, 2, 5}, {5, 10, 0},
                 {6, 1, 7}, {7, 3, 6},
@@ -88,7 +89,7 @@ namespace vk {
                 {10, 1, 0}, {10, 7, 1},
                 {11, 2, 3}, {11, 3, 7}, {11, 7, 10}, {11, 10, 5}, {11, 5, 2}
             };
-            inline static std::vector<uint16_t> indices = {
+            inline static const std::vector<uint16_t> baseIndices = {
                 5, 0, 4, 4, 2, 5, 5, 10, 0,
                 6, 1, 7, 7, 3, 6,
                 8, 4, 0, 0, 1, 8, 8, 1, 6,
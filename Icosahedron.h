@@ -3,22 +3,26 @@
 #include "vk.ubo.h"
 #include "vk.textures.h"
 #include "vk.graphics.h"
+#include "vk.library.h"
+#include "vk.culling.h"
 
 #include "Mesh.h"
 #include "Geometry.h"
 #include "Planet.h"
 
-pgl::Planet icosphere(10, 0.5f, 4);
+constexpr float icoRadius = 0.5f;
+pgl::Planet icosphere(10, icoRadius, 4);
 
-vk::UBO icoMat(icosphere.matrix, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_GEOMETRY_BIT);
+// Drawing pushes the matrix; the culler still reads it from a UBO
+vk::UBO icoMat(icosphere.matrix, VK_SHADER_STAGE_COMPUTE_BIT);
+// Bounds are padded by the tallest relief the plate simulation can raise
+vk::MeshletCuller icoCuller(icosphere, ubo, icoMat, icoRadius * icosphere.maxElevation);
 
 std::vector<VkDescriptorSet> icoSet {
     ubo.Sets[vk::SwapChain::currentFrame],
-    icoMat.Sets[vk::SwapChain::currentFrame],
 };
 std::vector<VkDescriptorSetLayout> icoLayout {
     ubo.SetLayout,
-    icoMat.SetLayout,
 };
 
 vk::Shader icoShaders[] = {
@@ -26,4 +30,4 @@ vk::Shader icoShaders[] = {
     {"ico.frag", VK_SHADER_STAGE_FRAGMENT_BIT}
 };
 
-vk::GraphicsPPL<triangleList, VK_POLYGON_MODE_LINE> icoPPL(icoShaders, icoSet, icoLayout);
\ No newline at end of file
+vk::LibraryPPL<triangleList, VK_POLYGON_MODE_LINE> icoPPL(icoShaders, icoSet, icoLayout, { vk::test_Mesh::modelRange });
\ No newline at end of file
@@ -0,0 +1,126 @@
+#pragma once
+
+#include "vk.ubo.h"
+#include "vk.graphics.h"
+#include "vk.batch.h"
+#include "vk.culling.h"
+#include "vk.atlas.h"
+
+#include <array>
+#include <memory>
+
+// Static meshes, so their vertices are stored packed
+vk::MeshArena arena(sizeof(packedTriangleList), 1 << 16, 1 << 18);
+
+std::vector<triangleList> cubeVertices = {
+    {{-0.5f,  0.5f,  0.5f, 1.f}, {-0.5f,  0.5f,  0.5f, 0.f}, {1.0f, 0.0f, 0.0f, 1.f}, {0.0f, 0.0f}},
+    {{ 0.5f,  0.5f,  0.5f, 1.f}, { 0.5f,  0.5f,  0.5f, 0.f}, {0.0f, 1.0f, 0.0f, 1.f}, {1.0f, 0.0f}},
+    {{ 0.5f,  0.5f, -0.5f, 1.f}, { 0.5f,  0.5f, -0.5f, 0.f}, {0.0f, 0.0f, 1.0f, 1.f}, {1.0f, 1.0f}},
+    {{-0.5f,  0.5f, -0.5f, 1.f}, {-0.5f,  0.5f, -0.5f, 0.f}, {1.0f, 1.0f, 1.0f, 1.f}, {0.0f, 1.0f}},
+    {{-0.5f, -0.5f,  0.5f, 1.f}, {-0.5f, -0.5f,  0.5f, 0.f}, {1.0f, 0.0f, 0.0f, 1.f}, {0.0f, 0.0f}},
+    {{ 0.5f, -0.5f,  0.5f, 1.f}, { 0.5f, -0.5f,  0.5f, 0.f}, {0.0f, 1.0f, 0.0f, 1.f}, {1.0f, 0.0f}},
+    {{ 0.5f, -0.5f, -0.5f, 1.f}, { 0.5f, -0.5f, -0.5f, 0.f}, {0.0f, 0.0f, 1.0f, 1.f}, {1.0f, 1.0f}},
+    {{-0.5f, -0.5f, -0.5f, 1.f}, {-0.5f, -0.5f, -0.5f, 0.f}, {1.0f, 1.0f, 1.0f, 1.f}, {0.0f, 1.0f}}
+};
+std::vector<uint16_t> cubeIndices = {
+    0, 1, 2, 2, 3, 0,   // top
+    4, 7, 6, 6, 5, 4,   // bottom
+    0, 4, 5, 5, 1, 0,   // front
+    1, 5, 6, 6, 2, 1,   // right
+    2, 6, 7, 7, 3, 2,   // back
+    3, 7, 4, 4, 0, 3    // left
+};
+
+std::vector<triangleList> octVertices = {
+    {{ 0.5f,  0.0f,  0.0f, 1.f}, { 1.f,  0.f,  0.f, 0.f}, {1.0f, 0.5f, 0.0f, 1.f}, {1.0f, 0.5f}},
+    {{-0.5f,  0.0f,  0.0f, 1.f}, {-1.f,  0.f,  0.f, 0.f}, {1.0f, 0.5f, 0.0f, 1.f}, {0.0f, 0.5f}},
+    {{ 0.0f,  0.5f,  0.0f, 1.f}, { 0.f,  1.f,  0.f, 0.f}, {0.0f, 0.5f, 1.0f, 1.f}, {0.5f, 1.0f}},
+    {{ 0.0f, -0.5f,  0.0f, 1.f}, { 0.f, -1.f,  0.f, 0.f}, {0.0f, 0.5f, 1.0f, 1.f}, {0.5f, 0.0f}},
+    {{ 0.0f,  0.0f,  0.5f, 1.f}, { 0.f,  0.f,  1.f, 0.f}, {0.5f, 1.0f, 0.0f, 1.f}, {0.5f, 0.5f}},
+    {{ 0.0f,  0.0f, -0.5f, 1.f}, { 0.f,  0.f, -1.f, 0.f}, {0.5f, 1.0f, 0.0f, 1.f}, {0.5f, 0.5f}}
+};
+std::vector<uint16_t> octIndices = {
+    0, 2, 4,  4, 2, 1,  1, 2, 5,  5, 2, 0,
+    4, 3, 0,  1, 3, 4,  5, 3, 1,  0, 3, 5
+};
+
+vk::MeshArena::Range cubeMesh = arena.add<packedTriangleList>(cubeVertices, cubeIndices);
+vk::MeshArena::Range octMesh = arena.add<packedTriangleList>(octVertices, octIndices);
+
+struct CulledBatch : vk::InstanceBatch
+{// Occlusion reads the depth the previous frame left behind; the pyramid, the culler and the kept depth only once a scene draws it,
+ // and only where the device can draw the culled commands from their own firstInstance
+    using vk::InstanceBatch::InstanceBatch;
+    std::unique_ptr<vk::DepthPyramid> pyramid;
+    std::unique_ptr<vk::InstanceCuller> culler;
+    void attach() override {
+        if (!culler and vk::GPU::multiDrawIndirect) {
+            pyramid = std::make_unique<vk::DepthPyramid>(app);
+            culler = std::make_unique<vk::InstanceCuller>(*this, ubo, *pyramid);
+        }
+    }
+};
+
+constexpr uint32_t batchGrid = 32;
+CulledBatch batch(arena, batchGrid * batchGrid, bindless);
+
+struct populateBatch {
+    populateBatch(vk::InstanceBatch& batch, vk::MeshArena::Range const& cube, vk::MeshArena::Range const& oct, uint32_t grid, float spacing) {
+        for (uint32_t x = 0; x < grid; x++) {
+            for (uint32_t z = 0; z < grid; z++) {
+                glm::vec3 offset((x - grid / 2.f) * spacing, -2.f, (z - grid / 2.f) * spacing);
+                glm::mat4 model = glm::scale(glm::translate(glm::mat4(1.f), offset), glm::vec3(0.25f));
+                batch.add((x + z) % 2 ? cube : oct, model);
+            }
+        }
+    }
+} batchContent(batch, cubeMesh, octMesh, batchGrid, 0.5f);
+
+vk::TextureAtlas atlas(bindless);
+
+struct textureBatch
+{// Checkers of two sizes, the smaller padded out to its layer, so the batch reads two arrays and a scaled handle; every third instance keeps its vertex colors
+    textureBatch(vk::InstanceBatch& batch, vk::TextureAtlas& atlas) {
+        auto checker = [](uint32_t width, uint32_t height, std::array<uint8_t, 4> a, std::array<uint8_t, 4> b) {
+            std::vector<uint8_t> pixels(size_t(width) * height * 4);
+            for (uint32_t y = 0; y < height; y++) {
+                for (uint32_t x = 0; x < width; x++) {
+                    std::array<uint8_t, 4> const& texel = (x / 8 + y / 8) % 2 ? a : b;
+                    std::copy(texel.begin(), texel.end(), pixels.begin() + (size_t(y) * width + x) * 4);
+                }
+            }
+            return pixels;
+        };
+        std::vector<uint8_t> large = checker(64, 64, { 255, 255, 255, 255 }, { 64, 64, 64, 255 });
+        std::vector<uint8_t> small = checker(48, 16, { 255, 200, 80, 255 }, { 40, 90, 160, 255 });
+        uint32_t textures[] = { atlas.add(large.data(), 64, 64), atlas.add(small.data(), 48, 16) };
+        atlas.build();
+
+        for (uint32_t i = 0; i < batch.instanceCount(); i++) {
+            if (i % 3) {
+                batch.texture(i, atlas[textures[i % 3 - 1]]);
+            }
+        }
+        batch.sampler = atlas.sampler;
+    }
+} batchTextures(batch, atlas);
+
+std::vector<VkDescriptorSet> batchSet{
+    ubo.Sets[vk::SwapChain::currentFrame],
+    bindless.Set
+};
+std::vector<VkDescriptorSetLayout> batchLayout{
+    ubo.SetLayout,
+    bindless.SetLayout
+};
+
+struct BatchVertex {
+    VkBool32 octahedralNormals;     // Vertices are packedTriangleList
+};
+
+vk::Shader batchShaders[] = {
+    {"batched.vert", VK_SHADER_STAGE_VERTEX_BIT, BatchVertex{ VK_TRUE }},
+    {"batched.frag", VK_SHADER_STAGE_FRAGMENT_BIT}
+};
+
+vk::GraphicsPPL<packedTriangleList> batchPPL(batchShaders, batchSet, batchLayout, { vk::Bindless::pushRange });
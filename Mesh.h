@@ -2,14 +2,23 @@
 #define hMesh
 
 #include "vk.buffers.h"
+#include "vk.queue.h"
 #include "vk.primitives.h"
+#include "MeshOptimizer.h"
+#include "Camera.h"
 
 namespace vk {
+    template<typename U>
+    constexpr VkIndexType indexTypeOf()
+    {// 32-bit indices where U is one; uint16_t and triPrim's three of them draw as 16-bit
+        return sizeof(U) == sizeof(uint32_t) ? VK_INDEX_TYPE_UINT32 : VK_INDEX_TYPE_UINT16;
+    }
+
     struct Mesh {
         alignas (16) glm::mat4 matrix = glm::mat4(1.f);
         template <typename T, typename U>
         inline Mesh(std::vector<T> vertices, std::vector<U> indices) 
-            : indexCount(setIndexCount(indices)),
+            : indexCount(setIndexCount(indices)), indexType(indexTypeOf<U>()),
             VBO(vertices.size() * sizeof(T), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT),
             EBO(indices.size() * sizeof(U), VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT),
             stageVBO(vertices.data(), VBO.size),
@@ -29,13 +38,14 @@ namespace vk {
         virtual void draw(uint32_t instanceCount = 1) {
             VkCommandBuffer& commandBuffer = EngineCPU::renderCommands[SwapChain::currentFrame];
             VkDeviceSize offsets[] = { 0 };
-            vkCmdBindVertexBuffers(commandBuffer, 0, 1, &VBO.buffer, offsets);
-            vkCmdBindIndexBuffer(commandBuffer, EBO.buffer, 0, VK_INDEX_TYPE_UINT16);
+            RenderState::bindVertexBuffers(commandBuffer, 1, &VBO.buffer, offsets);
+            RenderState::bindIndexBuffer(commandBuffer, EBO.buffer, indexType);
 
             vkCmdDrawIndexed(commandBuffer, indexCount, instanceCount, 0, 0, 0);
         }
     protected:
         uint32_t indexCount;
+        VkIndexType indexType;
         StageBuffer stageVBO, stageEBO;
         template<typename T, typename U>
         inline void subdivide(std::vector<T>& vertices, std::vector<U>& indices) {
@@ -45,6 +55,7 @@ namespace vk {
             stageEBO.~StageBuffer();
 
             indexCount = static_cast<uint32_t>(indices.size() * 3);
+            indexType = indexTypeOf<U>();
 
             VBO = Buffer(vertices.size() * sizeof(T), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
             EBO = Buffer(indices.size() * sizeof(U), VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
@@ -61,16 +72,32 @@ namespace vk {
         }
     };
 
-    struct test_Mesh {
+    struct Drawable
+    {// Anything a Scene can record after binding its pipeline
+        virtual ~Drawable() = default;
+        virtual void draw(uint32_t instanceCount = 1) = 0;
+        virtual void attach() {}    // A Scene that draws it was made; for work only worth doing once something draws it
+        virtual glm::vec4 sphere() const { return glm::vec4(0.f); }   // World-space bounds for draw sorting; a zero radius sorts first
+        struct IndirectDraw {
+            VkBuffer commands = VK_NULL_HANDLE;
+            VkBuffer count = VK_NULL_HANDLE;
+            uint32_t maxDraws = 0;
+        };
+    };
+
+    struct test_Mesh : Drawable {
         alignas (16) glm::mat4 matrix = glm::mat4(1.f);
         template <typename T, typename U>
         inline test_Mesh(std::vector<T> vertices, std::vector<U> indices)
-            : indexCount(setIndexCount(indices))
+            : indexCount(setIndexCount(indices)), indexType(indexTypeOf<U>())
         {
+            Optimizer::optimize(vertices, indices);
+            std::vector<U> chain = lodChain(vertices, indices);
+            clusterize(vertices, chain);
             VBO = new Buffer(vertices.size() * sizeof(T), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-            EBO = new Buffer(indices.size() * sizeof(U), VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+            EBO = new Buffer(chain.size() * sizeof(U), VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
             stageVBO = new StageBuffer(vertices.data(), VBO->size);
-            stageEBO = new StageBuffer(indices.data(), EBO->size);
+            stageEBO = new StageBuffer(chain.data(), EBO->size);
             stageVBO->transferData(VBO->buffer);
             stageEBO->transferData(EBO->buffer);
         }
@@ -81,43 +108,164 @@ namespace vk {
             delete stageEBO;
         };
     public:
-        Buffer* VBO;
-        Buffer* EBO;
+        Buffer* VBO = nullptr;
+        Buffer* EBO = nullptr;
+        std::vector<Optimizer::Meshlet> meshlets;  // Every LOD's, each level's range in its LOD
+        std::vector<IndirectDraw> indirect; // Per frame in flight, written by a culling pass over the selected LOD's meshlets; empty draws the LOD's index range
+
+        /* Level of detail: every level indexes the same VBO and lives in the same EBO behind LOD 0 */
+        inline static std::vector<float> lodErrors = { 0.002f, 0.01f, 0.04f };  // Simplification targets, relative to mesh extent
+        inline static float lodPixelError = 1.f;                                // Largest on-screen deviation a level may show
+        inline static Camera const* viewer = nullptr;                           // LOD 0 is always drawn without one
+        inline static VkPushConstantRange modelRange{ VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4) };  // matrix, pushed per draw
+        std::vector<Optimizer::LOD> lods;
+        glm::vec4 bounds{ 0.f };                                                // Object-space center (xyz) and radius (w)
+        glm::mat4 decode = glm::mat4(1.f);      // Stored positions to object space, set by compress; drawn as matrix * decode
+
         template<typename T, typename U>
         inline void update(std::vector<T>& vertices, std::vector<U>& indices) {
+            if (compressed) {
+                throw std::runtime_error("test_Mesh: a compressed VBO cannot take full-size vertices!");
+            }
             stageVBO->update(vertices.data(), VBO->buffer);
-            stageEBO->update(indices.data(), EBO->buffer);
+            std::vector<U> chain = lodChain(vertices, indices);
+            clusterize(vertices, chain);
+            indexType = indexTypeOf<U>();
+            if (chain.size() * sizeof(U) != EBO->size) {
+                delete EBO;
+                delete stageEBO;
+                EBO = new Buffer(chain.size() * sizeof(U), VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+                stageEBO = new StageBuffer(chain.data(), EBO->size);
+                stageEBO->transferData(EBO->buffer);
+                return;
+            }
+            stageEBO->update(chain.data(), EBO->buffer);
         }
-        virtual void draw(uint32_t instanceCount = 1) {
+        uint32_t selectLOD() const
+        {// Coarsest level whose simplification error projects below lodPixelError at the mesh's nearest point
+            if (lods.size() < 2 or viewer == nullptr) {
+                return 0;
+            }
+            float scale = std::max(std::max(glm::length(glm::vec3(matrix[0])), glm::length(glm::vec3(matrix[1]))), glm::length(glm::vec3(matrix[2])));
+            glm::vec3 center = glm::vec3(matrix * glm::vec4(glm::vec3(bounds), 1.f));
+            float radius = bounds.w * scale;
+            float distance = std::max(glm::distance(center, viewer->position) - radius, 1e-3f);
+            float pixelsPerUnit = std::abs(viewer->proj[1][1]) * 0.5f * static_cast<float>(GPU::Extent.height) / distance;
+            for (uint32_t i = static_cast<uint32_t>(lods.size()) - 1; i > 0; i--) {
+                if (lods[i].error * 2.f * radius * pixelsPerUnit <= lodPixelError) {
+                    return i;
+                }
+            }
+            return 0;
+        }
+        glm::vec4 sphere() const override {
+            float scale = std::max(std::max(glm::length(glm::vec3(matrix[0])), glm::length(glm::vec3(matrix[1]))), glm::length(glm::vec3(matrix[2])));
+            return glm::vec4(glm::vec3(matrix * glm::vec4(glm::vec3(bounds), 1.f)), bounds.w * scale);
+        }
+        void draw(uint32_t instanceCount = 1) override {
             VkCommandBuffer& commandBuffer = EngineCPU::renderCommands[SwapChain::currentFrame];
             VkDeviceSize offsets[] = { 0 };
-            vkCmdBindVertexBuffers(commandBuffer, 0, 1, &(*VBO).buffer, offsets);
-            vkCmdBindIndexBuffer(commandBuffer, EBO->buffer, 0, VK_INDEX_TYPE_UINT16);
+            RenderState::bindVertexBuffers(commandBuffer, 1, &VBO->buffer, offsets);
+            RenderState::bindIndexBuffer(commandBuffer, EBO->buffer, indexType);
+            glm::mat4 model = matrix * decode;
+            RenderState::pushConstants(commandBuffer, modelRange, &model);
 
-            vkCmdDrawIndexed(commandBuffer, indexCount, instanceCount, 0, 0, 0);
+            if (!indirect.empty()) {
+                IndirectDraw& draws = indirect[SwapChain::currentFrame];
+                vkCmdDrawIndexedIndirectCount(commandBuffer, draws.commands, 0, draws.count, 0, draws.maxDraws, sizeof(VkDrawIndexedIndirectCommand));
+                return;
+            }
+            Optimizer::LOD const& lod = lods[selectLOD()];
+            vkCmdDrawIndexed(commandBuffer, lod.indexCount, instanceCount, lod.firstIndex, 0, 0);
+        }
+        template<typename P, VkPrimitiveTopology topology>
+        inline void compress(std::vector<Primitive<topology>> const& vertices)
+        {// Re-uploads the VBO in a compact PackedPrimitive layout, for P's pipeline. The position decode is kept apart from matrix,
+         // so bounds, LOD selection and meshlet culling stay in object space. Only for meshes whose vertices never change:
+         // the staging buffer shrinks with the VBO
+            if (dynamic) {
+                throw std::runtime_error("test_Mesh: cannot compress a mesh that re-uploads its vertices!");
+            }
+            Quantization quantization = P::quantize(vertices);
+            std::vector<P> packed = P::encode(vertices, quantization);
+            decode = quantization.matrix();
+
+            VkDeviceSize fullSize = VBO->size;
+            delete VBO;
+            delete stageVBO;
+            VBO = new Buffer(packed.size() * sizeof(P), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+            stageVBO = new StageBuffer(packed.data(), VBO->size);
+            stageVBO->transferData(VBO->buffer);
+            compressed = true;
+
+            std::cout << "VBO compressed: " << fullSize << " -> " << VBO->size << " bytes" << std::endl;
         }
     protected:
-        uint32_t indexCount;
-        StageBuffer* stageVBO;
-        StageBuffer* stageEBO;
+        uint32_t indexCount = 0;
+        VkIndexType indexType = VK_INDEX_TYPE_UINT16;
+        bool dynamic = false;       // Re-uploads full-size vertices after construction, so compress refuses it
+        bool compressed = false;
+        StageBuffer* stageVBO = nullptr;
+        StageBuffer* stageEBO = nullptr;
+        test_Mesh() = default;      // For meshes that make their own geometry first; they call build once it is done
         template<typename T, typename U>
-        inline void subdivide(std::vector<T>& vertices, std::vector<U>& indices) {
+        inline void build(std::vector<T>& vertices, std::vector<U>& indices)
+        {// Optimizes the caller's vertices and indices in place, so its CPU copy stays in the uploaded order
             delete VBO;
             delete EBO;
             delete stageVBO;
             delete stageEBO;
 
+            Optimizer::optimize(vertices, indices);
             indexCount = setIndexCount(indices);
+            indexType = indexTypeOf<U>();
+            std::vector<U> chain = lodChain(vertices, indices);
+            clusterize(vertices, chain);
 
             VBO = new Buffer(vertices.size() * sizeof(T), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-            EBO = new Buffer(indices.size() * sizeof(U), VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+            EBO = new Buffer(chain.size() * sizeof(U), VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
             stageVBO = new StageBuffer(vertices.data(), VBO->size);
-            stageEBO = new StageBuffer(indices.data(), EBO->size);
+            stageEBO = new StageBuffer(chain.data(), EBO->size);
 
             stageVBO->transferData(VBO->buffer);
             stageEBO->transferData(EBO->buffer);
         }
     private:
+        template<typename T, typename U>
+        inline void clusterize(std::vector<T>& vertices, std::vector<U>& chain)
+        {// Each LOD of the chain split into its own meshlets, so a culler can draw whichever level is selected
+            if constexpr (T::primitiveTopology == VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST) {
+                meshlets.clear();
+                for (Optimizer::LOD& lod : lods) {
+                    std::vector<U> level(chain.begin() + lod.firstIndex, chain.begin() + lod.firstIndex + lod.indexCount);
+                    std::vector<Optimizer::Meshlet> clusters = Optimizer::buildMeshlets(vertices, level);
+                    for (Optimizer::Meshlet& meshlet : clusters) {
+                        meshlet.firstIndex += lod.firstIndex;
+                    }
+                    lod.firstMeshlet = static_cast<uint32_t>(meshlets.size());
+                    lod.meshletCount = static_cast<uint32_t>(clusters.size());
+                    meshlets.insert(meshlets.end(), clusters.begin(), clusters.end());
+                }
+            }
+        }
+        template<typename T, typename U>
+        inline std::vector<U> lodChain(std::vector<T>& vertices, std::vector<U>& indices) {
+            if constexpr (T::primitiveTopology == VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST) {
+                glm::vec3 center(0.f);
+                for (auto const& vertex : vertices) {
+                    center += glm::vec3(vertex.position);
+                }
+                center /= static_cast<float>(std::max<size_t>(vertices.size(), 1));
+                float radius = 0.f;
+                for (auto const& vertex : vertices) {
+                    radius = std::max(radius, glm::distance(center, glm::vec3(vertex.position)));
+                }
+                bounds = glm::vec4(center, radius);
+                return Optimizer::buildLODs(vertices, indices, lodErrors, lods);
+            }
+            lods = { { 0, static_cast<uint32_t>(indices.size()), 0.f } };
+            return indices;
+        }
         template<typename U>
         inline uint32_t setIndexCount(std::vector<U>& indices) {
             if (sizeof(U) == 6) {
@@ -0,0 +1,671 @@
+#pragma once
+#ifndef hMeshOptimizer
+#define hMeshOptimizer
+
+#include "vk.primitives.h"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <numeric>
+#include <algorithm>
+#include <iostream>
+#include <cmath>
+#include <tuple>
+#include <chrono>
+#include <execution>
+
+namespace vk {
+    namespace Optimizer
+    {// Index/vertex reordering for the post-transform vertex cache, vertex fetch and overdraw
+        inline static bool enabled = true;      // Run by test_Mesh before every upload
+        inline static uint32_t cacheSize = 16;  // FIFO entries assumed by the Tipsify pass and the ACMR/ATVR report
+        inline static bool overdraw = true;     // Sort Tipsify clusters front-to-back from the mesh center
+
+        struct CacheStats {
+            float acmr = 0.f; // Average cache miss ratio: transformed vertices per triangle (0.5 - 3.0)
+            float atvr = 0.f; // Average transformed vertex ratio: transformed vertices per referenced vertex (1.0 is optimal)
+        };
+
+        struct Meshlet {
+            inline static constexpr uint32_t maxVertices = 64;
+            inline static constexpr uint32_t maxTriangles = 124;
+
+            glm::vec4 sphere;       // Object-space center (xyz) and radius (w)
+            glm::vec4 cone;         // Average facing (xyz) and sin of the cone half-angle (w), 1 disables the cone test
+            uint32_t firstIndex;
+            uint32_t indexCount;
+            uint32_t vertexCount;
+            uint32_t triangleCount;
+        };
+
+        template<typename U>
+        inline CacheStats analyzeCache(std::vector<U> const& indices, size_t vertexCount, uint32_t cacheSize = Optimizer::cacheSize)
+        {// Simulates a FIFO post-transform cache over the index buffer
+            std::vector<uint32_t> timestamps(vertexCount, 0);
+            std::vector<bool> referenced(vertexCount, false);
+            uint32_t time = cacheSize + 1;
+            uint32_t misses = 0;
+            uint32_t unique = 0;
+            for (U index : indices) {
+                if (time - timestamps[index] > cacheSize) {
+                    timestamps[index] = time++;
+                    misses++;
+                }
+                if (!referenced[index]) {
+                    referenced[index] = true;
+                    unique++;
+                }
+            }
+            CacheStats stats;
+            if (!indices.empty()) {
+                stats.acmr = static_cast<float>(misses) / (indices.size() / 3);
+                stats.atvr = static_cast<float>(misses) / unique;
+            }
+            return stats;
+        }
+
+        template<typename U>
+        inline std::vector<uint32_t> tipsify(std::vector<U>& indices, size_t vertexCount, uint32_t cacheSize = Optimizer::cacheSize)
+        {// Sander, Nehab & Barczak 2007: fans around the most recently cached vertex, returns the cluster start of each hard boundary (in triangles)
+            size_t triangleCount = indices.size() / 3;
+
+            /* Vertex-triangle adjacency */
+            std::vector<uint32_t> live(vertexCount, 0);
+            for (U index : indices) {
+                live[index]++;
+            }
+            std::vector<uint32_t> offsets(vertexCount + 1, 0);
+            std::partial_sum(live.begin(), live.end(), offsets.begin() + 1);
+            std::vector<uint32_t> adjacency(indices.size());
+            std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+            for (uint32_t i = 0; i < indices.size(); i++) {
+                adjacency[fill[indices[i]]++] = i / 3;
+            }
+
+            std::vector<uint32_t> timestamps(vertexCount, 0);
+            std::vector<bool> emitted(triangleCount, false);
+            std::vector<uint32_t> deadEnd;
+            std::vector<uint32_t> candidates;
+            std::vector<U> output;
+            output.reserve(indices.size());
+            std::vector<uint32_t> clusters = { 0 };
+
+            uint32_t time = cacheSize + 1;
+            size_t cursor = 0;
+            int64_t fan = indices.empty() ? -1 : indices[0];
+            while (fan >= 0) {
+                candidates.clear();
+                for (uint32_t a = offsets[fan]; a < offsets[fan + 1]; a++) {
+                    uint32_t t = adjacency[a];
+                    if (emitted[t]) {
+                        continue;
+                    }
+                    for (int k = 0; k < 3; k++) {
+                        U v = indices[3 * t + k];
+                        output.push_back(v);
+                        deadEnd.push_back(v);
+                        candidates.push_back(v);
+                        live[v]--;
+                        if (time - timestamps[v] > cacheSize) {
+                            timestamps[v] = time++;
+                        }
+                    }
+                    emitted[t] = true;
+                }
+
+                /* Next fanning vertex: the candidate that stays in cache longest while still having live triangles */
+                int64_t next = -1;
+                int64_t priority = -1;
+                for (uint32_t v : candidates) {
+                    if (live[v] == 0) {
+                        continue;
+                    }
+                    int64_t p = 0;
+                    if (time - timestamps[v] + 2 * live[v] <= cacheSize) {
+                        p = time - timestamps[v];
+                    }
+                    if (p > priority) {
+                        priority = p;
+                        next = v;
+                    }
+                }
+                if (next < 0) {
+                    while (!deadEnd.empty() and next < 0) {
+                        uint32_t d = deadEnd.back();
+                        deadEnd.pop_back();
+                        if (live[d] > 0) {
+                            next = d;
+                        }
+                    }
+                    while (next < 0 and cursor < indices.size()) {
+                        U v = indices[cursor++];
+                        if (live[v] > 0) {
+                            next = v;
+                        }
+                    }
+                    if (next >= 0 and output.size() / 3 != clusters.back()) {
+                        clusters.push_back(static_cast<uint32_t>(output.size() / 3));
+                    }
+                }
+                fan = next;
+            }
+            indices.swap(output);
+            return clusters;
+        }
+
+        template<typename T, typename U>
+        inline void sortClusters(std::vector<T> const& vertices, std::vector<U>& indices, std::vector<uint32_t> const& clusters)
+        {// Orders clusters outermost-facing first so occluders are drawn before what they hide
+            glm::vec3 center(0.f);
+            for (auto const& vertex : vertices) {
+                center += glm::vec3(vertex.position);
+            }
+            center /= static_cast<float>(std::max<size_t>(vertices.size(), 1));
+
+            size_t triangleCount = indices.size() / 3;
+            std::vector<float> keys(clusters.size());
+            for (size_t c = 0; c < clusters.size(); c++) {
+                size_t end = (c + 1 < clusters.size()) ? clusters[c + 1] : triangleCount;
+                glm::vec3 centroid(0.f), normal(0.f);
+                float area = 0.f;
+                for (size_t t = clusters[c]; t < end; t++) {
+                    glm::vec3 a(vertices[indices[3 * t]].position);
+                    glm::vec3 b(vertices[indices[3 * t + 1]].position);
+                    glm::vec3 c_(vertices[indices[3 * t + 2]].position);
+                    glm::vec3 n = glm::cross(b - a, c_ - a);
+                    float weight = glm::length(n);
+                    centroid += weight * (a + b + c_) / 3.f;
+                    normal += n;
+                    area += weight;
+                }
+                if (area > 0.f) {
+                    centroid /= area;
+                }
+                float len = glm::length(normal);
+                keys[c] = (len > 0.f) ? glm::dot(centroid - center, normal / len) : 0.f;
+            }
+
+            std::vector<uint32_t> order(clusters.size());
+            std::iota(order.begin(), order.end(), 0);
+            std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return keys[a] > keys[b]; });
+
+            std::vector<U> sorted;
+            sorted.reserve(indices.size());
+            for (uint32_t c : order) {
+                size_t end = (c + 1 < clusters.size()) ? clusters[c + 1] : triangleCount;
+                sorted.insert(sorted.end(), indices.begin() + 3 * clusters[c], indices.begin() + 3 * end);
+            }
+            indices.swap(sorted);
+        }
+
+        template<typename T, typename U>
+        inline void reorderFetch(std::vector<T>& vertices, std::vector<U>& indices)
+        {// Renumbers vertices in order of first use; unreferenced vertices keep their relative order at the end
+            constexpr U unused = std::numeric_limits<U>::max();
+            std::vector<U> remap(vertices.size(), unused);
+            U next = 0;
+            for (U& index : indices) {
+                if (remap[index] == unused) {
+                    remap[index] = next++;
+                }
+                index = remap[index];
+            }
+            for (U& slot : remap) {
+                if (slot == unused) {
+                    slot = next++;
+                }
+            }
+            std::vector<T> reordered(vertices.size());
+            for (size_t v = 0; v < vertices.size(); v++) {
+                reordered[remap[v]] = vertices[v];
+            }
+            vertices.swap(reordered);
+        }
+
+        template<typename T, typename U>
+        inline std::vector<Meshlet> buildMeshlets(std::vector<T> const& vertices, std::vector<U> const& indices)
+        {// Splits the (already cache-ordered) index buffer into contiguous clusters with bounding spheres and normal cones
+            std::vector<Meshlet> meshlets;
+            std::vector<uint32_t> stamp(vertices.size(), UINT32_MAX);
+            std::vector<U> unique;
+            unique.reserve(Meshlet::maxVertices);
+
+            auto close = [&](uint32_t firstIndex, uint32_t indexCount) {
+                Meshlet meshlet{};
+                meshlet.firstIndex = firstIndex;
+                meshlet.indexCount = indexCount;
+                meshlet.vertexCount = static_cast<uint32_t>(unique.size());
+                meshlet.triangleCount = indexCount / 3;
+
+                glm::vec3 center(0.f);
+                for (U v : unique) {
+                    center += glm::vec3(vertices[v].position);
+                }
+                center /= static_cast<float>(unique.size());
+                float radius = 0.f;
+                for (U v : unique) {
+                    radius = std::max(radius, glm::length(glm::vec3(vertices[v].position) - center));
+                }
+
+                /* Triangle normals are oriented by the vertex normals so the cone does not depend on winding */
+                std::vector<glm::vec3> normals;
+                normals.reserve(meshlet.triangleCount);
+                glm::vec3 axis(0.f);
+                for (uint32_t i = firstIndex; i < firstIndex + indexCount; i += 3) {
+                    glm::vec3 a(vertices[indices[i]].position);
+                    glm::vec3 b(vertices[indices[i + 1]].position);
+                    glm::vec3 c(vertices[indices[i + 2]].position);
+                    glm::vec3 n = glm::cross(b - a, c - a);
+                    float len = glm::length(n);
+                    if (len == 0.f) {
+                        continue;
+                    }
+                    n /= len;
+                    glm::vec3 shading = glm::vec3(vertices[indices[i]].normal) + glm::vec3(vertices[indices[i + 1]].normal) + glm::vec3(vertices[indices[i + 2]].normal);
+                    if (glm::dot(n, shading) < 0.f) {
+                        n = -n;
+                    }
+                    normals.push_back(n);
+                    axis += n;
+                }
+                float cutoff = 1.f; // Disables cone culling
+                float len = glm::length(axis);
+                if (len > 0.f) {
+                    axis /= len;
+                    float minDot = 1.f;
+                    for (glm::vec3 const& n : normals) {
+                        minDot = std::min(minDot, glm::dot(n, axis));
+                    }
+                    if (minDot > 0.1f) {
+                        cutoff = std::sqrt(1.f - minDot * minDot);
+                    }
+                }
+                meshlet.sphere = glm::vec4(center, radius);
+                meshlet.cone = glm::vec4(axis, cutoff);
+                meshlets.push_back(meshlet);
+                unique.clear();
+            };
+
+            uint32_t first = 0;
+            for (uint32_t i = 0; i + 2 < indices.size(); i += 3) {
+                uint32_t id = static_cast<uint32_t>(meshlets.size());
+                uint32_t added = 0;
+                for (int k = 0; k < 3; k++) {
+                    added += (stamp[indices[i + k]] != id);
+                }
+                if (unique.size() + added > Meshlet::maxVertices or (i - first) / 3 + 1 > Meshlet::maxTriangles) {
+                    close(first, i - first);
+                    first = i;
+                    id++;
+                }
+                for (int k = 0; k < 3; k++) {
+                    U v = indices[i + k];
+                    if (stamp[v] != id) {
+                        stamp[v] = id;
+                        unique.push_back(v);
+                    }
+                }
+            }
+            if (!unique.empty()) {
+                close(first, static_cast<uint32_t>(indices.size() / 3 * 3) - first);
+            }
+            return meshlets;
+        }
+
+        struct Quadric
+        {// Weighted sum of squared distances to a set of planes, stored as the 10 unique terms of the symmetric 4x4 matrix
+         // and the weights' total; error divides by that, so it is a mean squared distance in position units
+            float a2 = 0.f, ab = 0.f, ac = 0.f, ad = 0.f;
+            float b2 = 0.f, bc = 0.f, bd = 0.f;
+            float c2 = 0.f, cd = 0.f;
+            float d2 = 0.f;
+            float w = 0.f;
+
+            static Quadric plane(glm::vec3 n, float d, float weight) {
+                Quadric q;
+                q.a2 = weight * n.x * n.x; q.ab = weight * n.x * n.y; q.ac = weight * n.x * n.z; q.ad = weight * n.x * d;
+                q.b2 = weight * n.y * n.y; q.bc = weight * n.y * n.z; q.bd = weight * n.y * d;
+                q.c2 = weight * n.z * n.z; q.cd = weight * n.z * d;
+                q.d2 = weight * d * d;
+                q.w = weight;
+                return q;
+            }
+            Quadric& operator+=(Quadric const& q) {
+                a2 += q.a2; ab += q.ab; ac += q.ac; ad += q.ad;
+                b2 += q.b2; bc += q.bc; bd += q.bd;
+                c2 += q.c2; cd += q.cd;
+                d2 += q.d2;
+                w += q.w;
+                return *this;
+            }
+            float error(glm::vec3 p) const {
+                float e = a2 * p.x * p.x + 2.f * (ab * p.x * p.y + ac * p.x * p.z + ad * p.x)
+                    + b2 * p.y * p.y + 2.f * (bc * p.y * p.z + bd * p.y)
+                    + c2 * p.z * p.z + 2.f * cd * p.z + d2;
+                return w > 0.f ? std::max(e, 0.f) / w : 0.f;
+            }
+        };
+
+        template<typename T, typename U>
+        inline std::vector<U> simplify(std::vector<T> const& vertices, std::vector<U> const& indices, size_t targetIndexCount, float targetError, float* resultError = nullptr)
+        {// Garland-Heckbert edge collapse onto existing vertices, so the result indexes the same vertex buffer.
+         // Errors are relative to the mesh extent; seam, crease and open border vertices never move.
+            size_t vertexCount = vertices.size();
+            std::vector<glm::vec3> positions(vertexCount);
+            glm::vec3 lo(std::numeric_limits<float>::max()), hi(-std::numeric_limits<float>::max());
+            for (size_t v = 0; v < vertexCount; v++) {
+                positions[v] = glm::vec3(vertices[v].position);
+                lo = glm::min(lo, positions[v]);
+                hi = glm::max(hi, positions[v]);
+            }
+            glm::vec3 span = hi - lo;
+            float extent = std::max(std::max(span.x, span.y), std::max(span.z, 1e-12f));
+            for (glm::vec3& p : positions) {
+                p = (p - lo) / extent;
+            }
+
+            /* Weld duplicates with matching attributes; positions shared by differing attributes are seams and stay locked */
+            std::vector<uint32_t> remap(vertexCount);
+            std::vector<bool> locked(vertexCount, false);
+            {
+                std::vector<uint32_t> order(vertexCount);
+                std::iota(order.begin(), order.end(), 0);
+                std::sort(std::execution::par, order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+                    auto const& pa = vertices[a].position;
+                    auto const& pb = vertices[b].position;
+                    return std::tie(pa.x, pa.y, pa.z, a) < std::tie(pb.x, pb.y, pb.z, b);
+                });
+                auto same = [&](T const& a, T const& b) {
+                    constexpr float eps = 1e-4f;
+                    return glm::all(glm::lessThanEqual(glm::abs(a.normal - b.normal), glm::vec4(eps)))
+                        and glm::all(glm::lessThanEqual(glm::abs(a.color - b.color), glm::vec4(eps)))
+                        and glm::all(glm::lessThanEqual(glm::abs(a.texCoord - b.texCoord), glm::vec2(eps)));
+                };
+                std::vector<uint32_t> reps;
+                for (size_t begin = 0; begin < vertexCount;) {
+                    size_t end = begin + 1;
+                    while (end < vertexCount and glm::vec3(vertices[order[end]].position) == glm::vec3(vertices[order[begin]].position)) {
+                        end++;
+                    }
+                    reps.clear();
+                    for (size_t i = begin; i < end; i++) {
+                        uint32_t v = order[i];
+                        auto rep = std::find_if(reps.begin(), reps.end(), [&](uint32_t r) { return same(vertices[r], vertices[v]); });
+                        remap[v] = (rep != reps.end()) ? *rep : v;
+                        if (rep == reps.end()) {
+                            reps.push_back(v);
+                        }
+                    }
+                    if (reps.size() > 1) {
+                        for (uint32_t r : reps) {
+                            locked[r] = true;
+                        }
+                    }
+                    begin = end;
+                }
+            }
+
+            std::vector<uint32_t> triangles(indices.size() / 3 * 3);
+            for (size_t i = 0; i < triangles.size(); i++) {
+                triangles[i] = remap[indices[i]];
+            }
+
+            /* Open borders: undirected edges used by a single triangle */
+            {
+                std::vector<uint64_t> edges;
+                edges.reserve(triangles.size());
+                for (size_t i = 0; i < triangles.size(); i += 3) {
+                    for (int k = 0; k < 3; k++) {
+                        uint64_t a = triangles[i + k], b = triangles[i + (k + 1) % 3];
+                        edges.push_back(std::min(a, b) << 32 | std::max(a, b));
+                    }
+                }
+                std::sort(std::execution::par, edges.begin(), edges.end());
+                for (size_t i = 0; i < edges.size();) {
+                    size_t j = i + 1;
+                    while (j < edges.size() and edges[j] == edges[i]) {
+                        j++;
+                    }
+                    if (j - i == 1) {
+                        locked[edges[i] >> 32] = true;
+                        locked[edges[i] & 0xffffffff] = true;
+                    }
+                    i = j;
+                }
+            }
+
+            std::vector<Quadric> quadrics(vertexCount);
+            for (size_t i = 0; i < triangles.size(); i += 3) {
+                glm::vec3 const& p0 = positions[triangles[i]];
+                glm::vec3 n = glm::cross(positions[triangles[i + 1]] - p0, positions[triangles[i + 2]] - p0);
+                float area = glm::length(n);
+                if (area == 0.f) {
+                    continue;
+                }
+                n /= area;
+                Quadric q = Quadric::plane(n, -glm::dot(n, p0), area);
+                for (int k = 0; k < 3; k++) {
+                    quadrics[triangles[i + k]] += q;
+                }
+            }
+
+            struct Collapse {
+                uint32_t from, to;
+                float cost;
+            };
+            float limit = targetError * targetError;
+            float worst = 0.f;
+            std::vector<uint32_t> offsets(vertexCount + 1), adjacency, fill;
+            std::vector<Collapse> best(vertexCount), candidates;
+            std::vector<uint32_t> vertexIds(vertexCount);
+            std::iota(vertexIds.begin(), vertexIds.end(), 0);
+            std::vector<uint32_t> collapse(vertexCount);
+            std::vector<bool> touched(vertexCount);
+
+            while (triangles.size() > targetIndexCount) {
+                /* Vertex-triangle adjacency of the current mesh */
+                std::fill(offsets.begin(), offsets.end(), 0);
+                for (uint32_t v : triangles) {
+                    offsets[v + 1]++;
+                }
+                std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+                adjacency.resize(triangles.size());
+                fill.assign(offsets.begin(), offsets.end() - 1);
+                for (uint32_t i = 0; i < triangles.size(); i++) {
+                    adjacency[fill[triangles[i]]++] = i / 3;
+                }
+
+                /* Cheapest collapse per vertex, evaluated in parallel */
+                std::for_each(std::execution::par, vertexIds.begin(), vertexIds.end(), [&](uint32_t a) {
+                    best[a] = { a, a, std::numeric_limits<float>::max() };
+                    if (locked[a]) {
+                        return;
+                    }
+                    for (uint32_t t = offsets[a]; t < offsets[a + 1]; t++) {
+                        for (int k = 0; k < 3; k++) {
+                            uint32_t b = triangles[3 * adjacency[t] + k];
+                            if (b == a) {
+                                continue;
+                            }
+                            Quadric q = quadrics[a];
+                            q += quadrics[b];
+                            float cost = q.error(positions[b]);
+                            if (cost < best[a].cost) {
+                                best[a] = { a, b, cost };
+                            }
+                        }
+                    }
+                });
+                candidates.clear();
+                for (Collapse const& c : best) {
+                    if (c.from != c.to and c.cost <= limit) {
+                        candidates.push_back(c);
+                    }
+                }
+                if (candidates.empty()) {
+                    break;
+                }
+                std::sort(std::execution::par, candidates.begin(), candidates.end(), [](Collapse const& a, Collapse const& b) { return a.cost < b.cost; });
+
+                /* Greedy independent collapses: a collapse freezes the one-ring it changes for the rest of the pass */
+                std::iota(collapse.begin(), collapse.end(), 0);
+                std::fill(touched.begin(), touched.end(), false);
+                size_t remaining = triangles.size();
+                size_t applied = 0;
+                for (Collapse const& c : candidates) {
+                    if (remaining <= targetIndexCount) {
+                        break;
+                    }
+                    if (touched[c.from] or touched[c.to]) {
+                        continue;
+                    }
+                    bool flips = false;
+                    size_t removed = 0;
+                    for (uint32_t t = offsets[c.from]; t < offsets[c.from + 1] and !flips; t++) {
+                        uint32_t const* tri = &triangles[3 * adjacency[t]];
+                        if (tri[0] == c.to or tri[1] == c.to or tri[2] == c.to) {
+                            removed += 3;
+                            continue;
+                        }
+                        glm::vec3 p[3], q[3];
+                        for (int k = 0; k < 3; k++) {
+                            p[k] = positions[tri[k]];
+                            q[k] = positions[tri[k] == c.from ? c.to : tri[k]];
+                        }
+                        glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+                        glm::vec3 after = glm::cross(q[1] - q[0], q[2] - q[0]);
+                        flips = glm::dot(before, after) <= 0.f;
+                    }
+                    if (flips) {
+                        continue;
+                    }
+                    collapse[c.from] = c.to;
+                    quadrics[c.to] += quadrics[c.from];
+                    for (uint32_t t = offsets[c.from]; t < offsets[c.from + 1]; t++) {
+                        for (int k = 0; k < 3; k++) {
+                            touched[triangles[3 * adjacency[t] + k]] = true;
+                        }
+                    }
+                    remaining -= removed;
+                    worst = std::max(worst, c.cost);
+                    applied++;
+                }
+                if (applied == 0) {
+                    break;
+                }
+
+                /* Rewrite the index list and drop degenerate triangles */
+                size_t write = 0;
+                for (size_t i = 0; i < triangles.size(); i += 3) {
+                    uint32_t a = collapse[triangles[i]], b = collapse[triangles[i + 1]], c = collapse[triangles[i + 2]];
+                    if (a != b and b != c and c != a) {
+                        triangles[write++] = a;
+                        triangles[write++] = b;
+                        triangles[write++] = c;
+                    }
+                }
+                triangles.resize(write);
+            }
+
+            if (resultError) {
+                *resultError = std::sqrt(worst);
+            }
+            return std::vector<U>(triangles.begin(), triangles.end());
+        }
+
+        template<typename T, typename U>
+        inline void optimize(std::vector<T>& vertices, std::vector<U>& indices)
+        {// Full pass for triangle lists: vertex cache, then optional overdraw ordering, then vertex fetch; other topologies are left as they are
+            if (!enabled) {
+                return;
+            }
+            if constexpr (T::primitiveTopology == VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST) {
+                if (indices.size() < 3 or indices.size() % 3) {
+                    return;
+                }
+                CacheStats before = analyzeCache(indices, vertices.size());
+
+                std::vector<uint32_t> clusters = tipsify(indices, vertices.size());
+                if (overdraw) {
+                    sortClusters(vertices, indices, clusters);
+                }
+                reorderFetch(vertices, indices);
+
+                CacheStats after = analyzeCache(indices, vertices.size());
+                std::cout << "mesh optimized (" << indices.size() / 3 << " triangles, " << clusters.size() << " clusters): ACMR "
+                    << before.acmr << " -> " << after.acmr << ", ATVR " << before.atvr << " -> " << after.atvr << std::endl;
+            }
+        }
+
+        struct LOD {
+            uint32_t firstIndex;
+            uint32_t indexCount;
+            float error;            // Deviation relative to the mesh extent
+            uint32_t firstMeshlet = 0;  // This level's clusters, where the mesh has them
+            uint32_t meshletCount = 0;
+        };
+
+        template<typename T, typename U>
+        inline std::vector<U> buildLODs(std::vector<T> const& vertices, std::vector<U> const& indices, std::vector<float> const& errors, std::vector<LOD>& lods)
+        {// Simplifies every level from the full mesh in parallel and concatenates them behind LOD 0 for a single index buffer
+            std::vector<std::vector<U>> levels(errors.size());
+            std::vector<float> levelErrors(errors.size(), 0.f);
+            std::vector<uint32_t> ids(errors.size());
+            std::iota(ids.begin(), ids.end(), 0);
+            std::for_each(std::execution::par, ids.begin(), ids.end(), [&](uint32_t i) {
+                levels[i] = simplify(vertices, indices, 0, errors[i], &levelErrors[i]);
+            });
+
+            std::vector<U> chain(indices.begin(), indices.end());
+            lods = { { 0, static_cast<uint32_t>(indices.size()), 0.f } };
+            for (uint32_t i = 0; i < levels.size(); i++) {
+                // Levels that barely reduce the previous one cost memory without saving vertex work
+                if (levels[i].empty() or levels[i].size() > lods.back().indexCount * 9 / 10) {
+                    continue;
+                }
+                lods.push_back({ static_cast<uint32_t>(chain.size()), static_cast<uint32_t>(levels[i].size()), levelErrors[i] });
+                chain.insert(chain.end(), levels[i].begin(), levels[i].end());
+            }
+            return chain;
+        }
+
+        inline void benchmarkSimplify(uint32_t gridSize = 708, float targetError = 0.01f)
+        {// Times the simplifier on a gridSize^2 quad heightfield (~1M triangles at the default size)
+            std::vector<triangleList> vertices(gridSize * gridSize);
+            for (uint32_t j = 0; j < gridSize; j++) {
+                for (uint32_t i = 0; i < gridSize; i++) {
+                    float x = static_cast<float>(i) / gridSize;
+                    float z = static_cast<float>(j) / gridSize;
+                    triangleList& vertex = vertices[j * gridSize + i];
+                    vertex.position = { x, 0.05f * std::sin(12.f * x) * std::cos(9.f * z), z, 1.f };
+                    vertex.normal = { 0.f, 1.f, 0.f, 0.f };
+                    vertex.color = { 1.f, 1.f, 1.f, 1.f };
+                    vertex.texCoord = { x, z };
+                }
+            }
+            std::vector<uint32_t> indices;
+            indices.reserve(6 * (gridSize - 1) * (gridSize - 1));
+            for (uint32_t j = 0; j + 1 < gridSize; j++) {
+                for (uint32_t i = 0; i + 1 < gridSize; i++) {
+                    uint32_t a = j * gridSize + i, b = a + 1, c = a + gridSize, d = c + 1;
+                    indices.insert(indices.end(), { a, c, b, b, c, d });
+                }
+            }
+
+            auto start = std::chrono::high_resolution_clock::now();
+            float error = 0.f;
+            std::vector<uint32_t> simplified = simplify(vertices, indices, 0, targetError, &error);
+            auto single = std::chrono::high_resolution_clock::now();
+            std::vector<LOD> lods;
+            std::vector<uint32_t> chain = buildLODs(vertices, indices, { 0.001f, 0.005f, 0.02f }, lods);
+            auto end = std::chrono::high_resolution_clock::now();
+
+            std::cout << "simplify: " << indices.size() / 3 << " -> " << simplified.size() / 3 << " triangles (error " << error << ") in "
+                << std::chrono::duration<double, std::milli>(single - start).count() << " ms; "
+                << lods.size() << "-level chain in " << std::chrono::duration<double, std::milli>(end - single).count() << " ms" << std::endl;
+        }
+    }
+}
+
+#endif
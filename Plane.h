@@ -3,29 +3,36 @@
 #include "vk.ubo.h"
 #include "vk.textures.h"
 #include "vk.graphics.h"
+#include "vk.virtual.h"
+#include "vk.noise.h"
 
 #include "Mesh.h"
 #include "Geometry.h"
 
 vk::Geometry::Plane plane({ 300, 200 }, { 0.025, 0.025 });
 
-vk::UBO modMat(plane.matrix, VK_SHADER_STAGE_VERTEX_BIT);
-vk::ComputeImage heightMap({ 3000, 2000 }, VK_SHADER_STAGE_VERTEX_BIT);
+vk::Shader terrainGenerator("plane.comp", VK_SHADER_STAGE_COMPUTE_BIT);
+vk::VirtualTexture heightMap(terrainGenerator, vk::noise::Terrain{});
 
 std::vector<VkDescriptorSet> planeSet{
     ubo.Sets[vk::SwapChain::currentFrame],
-    modMat.Sets[vk::SwapChain::currentFrame],
-    heightMap.Sets[vk::SwapChain::currentFrame]
+    heightMap.Sets[vk::SwapChain::currentFrame]     // Replaced at bind time by planeFrames
 };
 std::vector<VkDescriptorSetLayout> planeLayout{
     ubo.SetLayout,
-    modMat.SetLayout,
     heightMap.SetLayout
 };
 
 vk::Shader planeShaders[] = {
-    {"plane.vert", VK_SHADER_STAGE_VERTEX_BIT},
+    {"plane.vert", VK_SHADER_STAGE_VERTEX_BIT, heightMap.constants()},
     {"plane.frag", VK_SHADER_STAGE_FRAGMENT_BIT}
 };
 
-vk::GraphicsPPL<triangleList, VK_POLYGON_MODE_LINE> planePPL(planeShaders, planeSet, planeLayout);
\ No newline at end of file
+vk::GraphicsPPL<triangleList, VK_POLYGON_MODE_LINE> planePPL(planeShaders, planeSet, planeLayout, { vk::test_Mesh::modelRange });
+
+struct perFrameSet
+{// Each frame slot's feedback is read back and cleared by VirtualTexture::record, so the plane writes the slot it draws in
+    perFrameSet(vk::Pipeline& pipeline, uint32_t set, std::vector<VkDescriptorSet> const& ownerSets) {
+        pipeline.perFrame(set, ownerSets);
+    }
+} planeFrames(planePPL, 1, heightMap.Sets);
\ No newline at end of file
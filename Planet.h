@@ -7,32 +7,50 @@
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtx/rotate_vector.hpp>
 #include <glm/gtx/vector_angle.hpp>
+#include <glm/gtx/hash.hpp>
 
 /* For Planet Generation */
 #include <thread>
 #include <random>
 #include <functional>
+#include <chrono>
+#include <unordered_map>
 
 /* For Linear Algebra */
 #include <Eigen/Dense>
 
 
 
-struct Adjacency {
-    Adjacency(std::vector<triangleList>& vertices) {
-        uint16_t size = vertices.size();
-        uint16_t linear_size = size * size;
-        matrix.resize(linear_size);
-
-        for (const auto& vtx : vertices) {
-            for (const auto& vty : vertices) {
-                if (&vtx != &vty) {
-
-                }
-            }
+struct PlateGraph {
+    // Sparse plate adjacency; each entry counts the mesh edges two plates share along their boundary.
+    std::vector<std::unordered_map<uint16_t, uint32_t>> edges;
+    void resize(uint16_t plate_count) {
+        edges.assign(plate_count, {});
+    }
+    void link(uint16_t a, uint16_t b) {
+        if (a == b) {
+            return;
+        }
+        edges[a][b]++;
+        edges[b][a]++;
+    }
+    void unlink(uint16_t a, uint16_t b) {
+        if (a == b) {
+            return;
+        }
+        release(a, b);
+        release(b, a);
+    }
+    bool connected(uint16_t a, uint16_t b) const {
+        return edges[a].contains(b);
+    }
+private:
+    void release(uint16_t a, uint16_t b) {
+        auto edge = edges[a].find(b);
+        if (edge != edges[a].end() and --edge->second == 0) {
+            edges[a].erase(edge);
         }
     }
-    std::vector<int> matrix;
 };
 
 namespace vk {
@@ -55,6 +73,7 @@ namespace pgl {
             std::uniform_real_distribution<float> XYZ(-1.0f, 1.0f);
             std::uniform_real_distribution<float> offset(-0.25f, 0.25f);
             std::uniform_real_distribution<float> angularVelocity(-0.02f, 0.02f);
+            std::uniform_real_distribution<float> crust(2.7f, 3.3f);
 
             std::thread t_pos([this, radius, XYZ, offset] { init_pos(radius, XYZ, offset); });
             std::jthread t_rgb([this, RGB] { init_rgb(RGB); });
@@ -67,11 +86,13 @@ namespace pgl {
             t_pos.join();
             axis = glm::normalize(glm::cross(randOrtho, position));
             omega  = angularVelocity(global_rng);
+            density = crust(global_rng);
             //plateID = i;
         }
         Plate() = default;
     public:
         float omega = 0.f;
+        float density = 3.f; // Denser (oceanic) crust subducts beneath lighter (continental) crust
         glm::vec3 axis{ 0.f };
 
         Eigen::MatrixXf vertexGraph;
@@ -84,12 +105,12 @@ namespace pgl {
             return(rotQuat * position) * cnjQuat;
         }
 
-        void setWeights() {
-
+        glm::vec3 velocity(const glm::vec3& position) const
+        {// Surface velocity of the plate rotating about its Euler pole
+            return omega * glm::cross(axis, position);
         }
 
         std::vector<uint16_t> vtx_ids;
-        std::vector<uint16_t> vtx_edge;
     protected:
         uint16_t plateID = 0;
     private:
@@ -113,73 +134,321 @@ namespace pgl {
 
     struct Planet : vk::Geometry::Icosahedron {
         Planet(uint16_t plate_count, float radius, int subdivisions)
-            : Icosahedron(radius, subdivisions)
+            : Icosahedron(radius, subdivisions), radius(radius)
         {
+            dynamic = true;
             this->plate_count = plate_count;
             plates.resize(plate_count);
             for (int i = 0; i < plate_count; i++) {
                 plates[i] = Plate(radius);
             }
             assignVertices(plate_count, vertices, plates, plate_ids);
+            vtx_slot.resize(vertices.size());
+            for (auto& plate : plates) {
+                for (uint32_t i = 0; i < plate.vtx_ids.size(); i++) {
+                    vtx_slot[plate.vtx_ids[i]] = i;
+                }
+            }
 
+            weldVertices();
             connectPlates(indices);
+            calcWeights();
             stageVBO->update(vertices.data(), VBO->buffer);
         }
     public:
-        void updatePlates() {
-            for (auto& plate : plates) {//TODO: dispatch to GPU with compute shader
-                
-                for (uint16_t& i : plate.vtx_ids) {
-                    //vertices[i].position = plate.shiftVertex(vertices[i].position);
+        // Simulation constants, in units of planet radius per second of plate motion
+        float upliftRate = 0.5f;
+        float subductionRate = 0.35f;
+        float riftRate = 0.1f;
+        float captureDepth = 0.02f; // Subducted crust deeper than this is consumed by the overriding plate
+        float maxElevation = 0.08f;
+
+        void updatePlates()
+        {// Uploads only the vertices of nodes that changed, coalesced into runs
+            runSim(static_cast<float>(vk::dt));
+            if (!dirty.empty()) {
+                stageVBO->update(vertices.data(), VBO->buffer, dirtyRegions());
+                clearDirty();
+            }
+        }
+        void benchmark(uint32_t ticks = 1000, float tick = 1.f / 60.f)
+        {// Runs the plate simulation for a fixed number of ticks without uploading to the GPU
+            auto start = std::chrono::high_resolution_clock::now();
+            size_t boundaryTotal = 0;
+            size_t dirtyTotal = 0;
+            VkDeviceSize uploadTotal = 0;
+            for (uint32_t i = 0; i < ticks; i++) {
+                boundaryTotal += boundary.size();
+                runSim(tick);
+                dirtyTotal += dirty.size();
+                for (VkBufferCopy const& region : dirtyRegions()) {
+                    uploadTotal += region.size;
                 }
+                clearDirty();
             }
-            stageVBO->update(vertices.data(), VBO->buffer);
+            auto stop = std::chrono::high_resolution_clock::now();
+            double ms = std::chrono::duration<double, std::milli>(stop - start).count();
+
+            std::cout << "plate sim: " << ticks << " ticks, " << ms / ticks << " ms/tick, "
+                << boundaryTotal / ticks << " boundary nodes of " << node_plate.size() << ", "
+                << dirtyTotal / ticks << " changed, " << uploadTotal / ticks << " of " << VBO->size << " VBO bytes uploaded per tick" << std::endl;
         }
     protected:
-        Eigen::MatrixXi A;
+        PlateGraph graph;
         void connectPlates(std::vector<uint16_t>& indices)
-        {// Maps triangle indices to plateIDs stored in the vertex map.
-            A = Eigen::MatrixXi::Constant(plate_count, plate_count, 0);
-            for (uint16_t i = 0; i < indices.size(); i+=3) {
-                 uint16_t j = i + 1;
-                 uint16_t k = i + 2;
-                 uint16_t vtx_i = indices[i];
-                 uint16_t vtx_j = indices[i + 1];
-                 uint16_t vtx_k = indices[i + 2];
-
-                 uint16_t plate_i = plate_ids[vtx_i];
-                 uint16_t plate_j = plate_ids[vtx_j];
-                 uint16_t plate_k = plate_ids[vtx_k];
-
-                 if ((plate_i != plate_j) and (plate_i != plate_k) and (plate_j != plate_k)) {
-                     A(plate_i, plate_j) = 1;
-                     A(plate_i, plate_k) = 1;
-                     A(plate_j, plate_i) = 1;
-                     A(plate_j, plate_k) = 1;
-                     A(plate_k, plate_i) = 1;
-                     A(plate_k, plate_j) = 1;
-                 }
-            }
-            std::cout << A << std::endl;
-        }
-        void calcWeights() {
-            for (uint16_t i = 0; i < plate_count; i++) {
-                for (uint16_t j = 0; j < plate_count; j++) {
-                    if (A(i, j)) {
+        {// Builds the welded vertex neighborhoods and the sparse plate graph from the triangle indices.
+            neighbors.assign(node_plate.size(), {});
+            for (size_t i = 0; i < indices.size(); i += 3) {
+                uint16_t a = weld[indices[i]];
+                uint16_t b = weld[indices[i + 1]];
+                uint16_t c = weld[indices[i + 2]];
+                connect(a, b);
+                connect(b, c);
+                connect(c, a);
+            }
 
+            graph.resize(plate_count);
+            boundary_slot.assign(node_plate.size(), -1);
+            for (uint16_t node = 0; node < node_plate.size(); node++) {
+                for (uint16_t n : neighbors[node]) {
+                    if (n > node) {
+                        graph.link(node_plate[node], node_plate[n]);
                     }
                 }
+                refreshBoundary(node);
+            }
+        }
+        void calcWeights()
+        {// Row-normalized boundary weights between every pair of touching plates
+            for (uint16_t i = 0; i < plate_count; i++) {
+                calcWeights(i);
             }
+        }
+        void calcWeights(uint16_t plate)
+        {
+            std::vector<float>& weights = plates[plate].Adjacency;
+            weights.assign(plate_count, 0.f);
 
+            uint32_t total = 0;
+            for (auto const& [other, count] : graph.edges[plate]) {
+                total += count;
+            }
+            for (auto const& [other, count] : graph.edges[plate]) {
+                weights[other] = static_cast<float>(count) / total;
+            }
         }
-        void runSim() {
+        void runSim(float dt)
+        {// Advances plate collision and subduction along the boundary only.
+            transfers.clear();
+            for (uint16_t node : boundary) {
+                uint16_t p = node_plate[node];
+                glm::vec3 pos = direction[node];
+
+                float uplift = 0.f;
+                for (uint16_t n : neighbors[node]) {
+                    uint16_t q = node_plate[n];
+                    if (q == p) {
+                        continue;
+                    }
+                    glm::vec3 toward = glm::normalize(direction[n] - pos);
+                    float closing = glm::dot(plates[p].velocity(pos) - plates[q].velocity(direction[n]), toward);
+
+                    if (closing <= 0.f) {
+                        uplift += riftRate * closing;
+                    }
+                    else if (plates[p].density > plates[q].density) {
+                        uplift -= subductionRate * closing;
+                    }
+                    else {
+                        uplift += upliftRate * closing;
+                    }
+                }
+                float raised = std::clamp(elevation[node] + uplift * dt, -maxElevation, maxElevation);
+                if (raised != elevation[node]) {
+                    elevation[node] = raised;
+                    markDirty(node);
+                }
 
+                if (elevation[node] < -captureDepth) {
+                    transfers.push_back(node);
+                }
+            }
+            for (uint16_t node : transfers) {
+                capture(node);
+            }
+            for (uint16_t node : dirty) {
+                writeNode(node);
+            }
         }
     private:
         int plate_count = 0;
+        float radius;
         std::vector<Plate> plates;
         std::vector<uint16_t> plate_ids;
-        std::vector<uint16_t> index_map;
+        std::vector<uint32_t> vtx_slot; // vertex -> position in its plate's vtx_ids
+
+        /* Welded mesh: subdivision duplicates shared midpoints, so boundaries are tracked per unique position */
+        std::vector<uint16_t> weld;                         // vertex -> node
+        std::vector<std::vector<uint16_t>> welded;          // node -> duplicate vertices
+        std::vector<std::vector<uint16_t>> neighbors;       // node -> adjacent nodes
+        std::vector<glm::vec3> direction;                   // node -> unit direction from the planet center
+        std::vector<uint16_t> node_plate;
+        std::vector<float> elevation;
+
+        std::vector<uint16_t> boundary;
+        std::vector<int32_t> boundary_slot;
+        std::vector<uint16_t> dirty;
+        std::vector<bool> queued;                           // node -> already in dirty
+        std::vector<uint16_t> transfers;
+
+        inline static constexpr float weldTolerance = 1e-4f;   // Unit directions closer than this are one node
+
+        void weldVertices()
+        {// Hashed into cells the size of the tolerance; a vertex joins any node within it in its own or a neighboring cell,
+         // so duplicates that straddle a cell border still weld
+            std::unordered_map<glm::ivec3, std::vector<uint16_t>> cells;
+            weld.resize(vertices.size());
+            for (uint16_t v = 0; v < vertices.size(); v++) {
+                glm::vec3 dir = glm::normalize(glm::vec3(vertices[v].position));
+                glm::ivec3 cell = glm::ivec3(glm::floor(dir / weldTolerance));
+
+                int32_t found = -1;
+                for (int x = -1; x <= 1 and found < 0; x++) {
+                    for (int y = -1; y <= 1 and found < 0; y++) {
+                        for (int z = -1; z <= 1 and found < 0; z++) {
+                            auto nodes = cells.find(cell + glm::ivec3(x, y, z));
+                            if (nodes == cells.end()) {
+                                continue;
+                            }
+                            for (uint16_t node : nodes->second) {
+                                if (glm::distance(direction[node], dir) <= weldTolerance) {
+                                    found = node;
+                                    break;
+                                }
+                            }
+                        }
+                    }
+                }
+                if (found < 0) {
+                    found = static_cast<int32_t>(welded.size());
+                    welded.push_back({});
+                    direction.push_back(dir);
+                    node_plate.push_back(plate_ids[v]);
+                    cells[cell].push_back(static_cast<uint16_t>(found));
+                }
+                weld[v] = static_cast<uint16_t>(found);
+                welded[found].push_back(v);
+            }
+            elevation.assign(welded.size(), 0.f);
+            queued.assign(welded.size(), false);
+        }
+        void markDirty(uint16_t node) {
+            if (!queued[node]) {
+                queued[node] = true;
+                dirty.push_back(node);
+            }
+        }
+        void clearDirty() {
+            for (uint16_t node : dirty) {
+                queued[node] = false;
+            }
+            dirty.clear();
+        }
+        std::vector<VkBufferCopy> dirtyRegions() const
+        {// The dirty nodes' vertices as byte ranges of the VBO, adjacent vertices merged
+            std::vector<uint16_t> touched;
+            for (uint16_t node : dirty) {
+                touched.insert(touched.end(), welded[node].begin(), welded[node].end());
+            }
+            std::sort(touched.begin(), touched.end());
+
+            std::vector<VkBufferCopy> regions;
+            VkDeviceSize stride = sizeof(triangleList);
+            for (size_t i = 0; i < touched.size(); i++) {
+                VkDeviceSize offset = touched[i] * stride;
+                if (!regions.empty() and regions.back().srcOffset + regions.back().size == offset) {
+                    regions.back().size += stride;
+                    continue;
+                }
+                regions.push_back({ offset, offset, stride });
+            }
+            return regions;
+        }
+        void connect(uint16_t a, uint16_t b) {
+            if (a == b or std::find(neighbors[a].begin(), neighbors[a].end(), b) != neighbors[a].end()) {
+                return;
+            }
+            neighbors[a].push_back(b);
+            neighbors[b].push_back(a);
+        }
+        void refreshBoundary(uint16_t node) {
+            bool onBoundary = std::any_of(neighbors[node].begin(), neighbors[node].end(),
+                [&](uint16_t n) { return node_plate[n] != node_plate[node]; });
+
+            int32_t& slot = boundary_slot[node];
+            if (onBoundary and slot < 0) {
+                slot = static_cast<int32_t>(boundary.size());
+                boundary.push_back(node);
+            }
+            else if (!onBoundary and slot >= 0) {
+                uint16_t last = boundary.back();
+                boundary[slot] = last;
+                boundary_slot[last] = slot;
+                boundary.pop_back();
+                slot = -1;
+            }
+        }
+        void capture(uint16_t node)
+        {// Hands a subducted node to the neighboring plate that overrides it, updating the graph incrementally.
+            uint16_t from = node_plate[node];
+            uint16_t to = from;
+            float lightest = plates[from].density;
+            for (uint16_t n : neighbors[node]) {
+                uint16_t q = node_plate[n];
+                if (plates[q].density < lightest) {
+                    lightest = plates[q].density;
+                    to = q;
+                }
+            }
+            if (to == from) {
+                return;
+            }
+
+            for (uint16_t n : neighbors[node]) {
+                graph.unlink(from, node_plate[n]);
+                graph.link(to, node_plate[n]);
+            }
+            node_plate[node] = to;
+            elevation[node] = 0.f;
+            markDirty(node);
+            for (uint16_t v : welded[node]) {
+                plate_ids[v] = to;
+                auto& owned = plates[from].vtx_ids;
+                uint16_t last = owned.back();
+                owned[vtx_slot[v]] = last;
+                vtx_slot[last] = vtx_slot[v];
+                owned.pop_back();
+
+                vtx_slot[v] = static_cast<uint32_t>(plates[to].vtx_ids.size());
+                plates[to].vtx_ids.push_back(v);
+            }
+
+            refreshBoundary(node);
+            for (uint16_t n : neighbors[node]) {
+                refreshBoundary(n);
+            }
+            calcWeights(from);
+            calcWeights(to);
+        }
+        void writeNode(uint16_t node) {
+            glm::vec4 position = glm::vec4((radius * (1.f + elevation[node])) * direction[node], 1.f);
+            float shade = 1.f + elevation[node] / maxElevation;
+            glm::vec4 color = glm::vec4(glm::vec3(plates[node_plate[node]].color) * (0.5f + 0.5f * shade), 1.f);
+            for (uint16_t v : welded[node]) {
+                vertices[v].position = position;
+                vertices[v].color = color;
+            }
+        }
 
         static void assignVertices(uint16_t plate_count, std::vector<triangleList>& vertices, std::vector<Plate>& plates, std::vector<uint16_t>& vertex_map)
         {
@@ -194,13 +463,11 @@ namespace pgl {
                     float distance = glm::distance(glm::vec3(vertices[v].position), plates[i].position);
                     if (distance < min)
                     {
-                        vertices[v].color = glm::vec4(plates[i].axis, 1.f);
-                       
                         plateIndex = i;
                         min = distance;
                     }
                 }
-                //plates[plateIndex].vertices.push_back(&vertices[v]);
+                vertices[v].color = plates[plateIndex].color;
                 plates[plateIndex].vtx_ids.push_back(v);
                 vertex_map[v] = plateIndex;
             }
@@ -3,6 +3,7 @@
 #include "Model.h"
 #include "vk.ubo.h"
 #include "vk.textures.h"
+#include "vk.streaming.h"
 #include "vk.graphics.h"
 
 
@@ -26,7 +27,8 @@ vk::Mesh model(vertices, indices);
 vk::Uniforms uniforms;
 
 vk::UBO ubo(uniforms, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT);
-vk::Texture planks("textures/planks.png");
+vk::TextureStreamer streamer;
+vk::StreamedTexture planks(streamer, "textures/planks.png");
 vk::Sampler sampler(planks.mipLevels);
 //vk::CombinedImageSampler planksImageSampler("textures/planks.png");
 
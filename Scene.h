@@ -2,19 +2,21 @@
 #define hScene
 
 #include "Mesh.h"
+#include "vk.queue.h"
 
 namespace vk {
 	struct Scene {
-        Scene(Pipeline& renderPipeline, test_Mesh& gameObject)
-            : pPipeline(&renderPipeline), pGameObject(&gameObject) {}
+        Scene(Pipeline& renderPipeline, Drawable& gameObject)
+            : pPipeline(&renderPipeline), pGameObject(&gameObject) {
+            gameObject.attach();
+        }
     public:
-        void render() {
-            pPipeline->bind();
-            pGameObject->draw();
+        void render(RenderQueue& queue, RenderQueue::Pass pass = RenderQueue::Opaque) {
+            queue.submit(*pPipeline, *pGameObject, pass);
         }
     private:
         Pipeline* pPipeline;
-        test_Mesh* pGameObject;
+        Drawable* pGameObject;
 	};
 }
 
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "vk.allocator.h"
+
 #include <set>
 
 namespace vk {
@@ -7,34 +9,18 @@ namespace vk {
         VkDescriptorSetLayout SetLayout;
         std::vector<VkDescriptorSet> Sets;
         Descriptor(VkDescriptorType type, VkShaderStageFlags flag, uint32_t bindingCount = 1) {
-            createDescriptorPool(type, bindingCount);
             createDescriptorSetLayout(type, flag, bindingCount);
             allocateDescriptorSets();
         }
+        // The layout belongs to LayoutCache; the sets go back to the persistent DescriptorAllocator
         ~Descriptor() {
-            if (Pool != VK_NULL_HANDLE) {
-                vkDestroyDescriptorPool(GPU::device, Pool, nullptr);
-            }
-            if (SetLayout != VK_NULL_HANDLE) {
-                vkDestroyDescriptorSetLayout(GPU::device, SetLayout, nullptr);
+            if (DescriptorAllocator::persistent) {
+                DescriptorAllocator::persistent->free(Sets);
             }
         }
     protected:
-        VkDescriptorPool Pool;
         virtual void writeDescriptorSets(uint32_t bindingCount) {}
     private:
-        void createDescriptorPool(VkDescriptorType& type, uint32_t bindingCount) {
-            VkDescriptorPoolSize poolSizes
-            { type , static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT) * bindingCount };
-
-            VkDescriptorPoolCreateInfo poolInfo
-            { VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO };
-            poolInfo.poolSizeCount = 1;
-            poolInfo.pPoolSizes = &poolSizes;
-            poolInfo.maxSets = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
-
-            VK_CHECK_RESULT(vkCreateDescriptorPool(GPU::device, &poolInfo, nullptr, &Pool));
-        }
         void createDescriptorSetLayout(VkDescriptorType& type, VkShaderStageFlags& flag, uint32_t bindingCount) {
             std::vector<VkDescriptorSetLayoutBinding> layoutBindings(bindingCount);
             for (uint32_t i = 0; i < bindingCount; i++) {
@@ -44,26 +30,11 @@ namespace vk {
                 layoutBindings[i].pImmutableSamplers = nullptr;
                 layoutBindings[i].stageFlags = flag;
             }
-
-            VkDescriptorSetLayoutCreateInfo layoutInfo
-            { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO };
-            layoutInfo.bindingCount = bindingCount;
-            layoutInfo.pBindings = layoutBindings.data();
-
-            VK_CHECK_RESULT(vkCreateDescriptorSetLayout(GPU::device, &layoutInfo, nullptr, &SetLayout));
+            SetLayout = LayoutCache::setLayout(layoutBindings);
         }
         void allocateDescriptorSets() {
             std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, SetLayout);
-
-            VkDescriptorSetAllocateInfo allocInfo
-            { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO };
-            allocInfo.descriptorPool = Pool;
-            allocInfo.descriptorSetCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
-            allocInfo.pSetLayouts = layouts.data();
-
-            Sets.resize(MAX_FRAMES_IN_FLIGHT);
-
-            VK_CHECK_RESULT(vkAllocateDescriptorSets(GPU::device, &allocInfo, Sets.data()));
+            DescriptorAllocator::persistent->allocate(layouts, Sets);
         }
     };
 
@@ -91,9 +62,7 @@ namespace vk {
             createSetLayout();
             createSet();
         }
-        ~DescriptorSet() {
-            vkDestroyDescriptorSetLayout(GPU::device, layout, nullptr);
-        }
+        ~DescriptorSet() = default;
     public:
         VkDescriptorSet set;
         VkDescriptorSetLayout layout;
@@ -124,13 +93,7 @@ namespace vk {
                 layoutBindings[i].pImmutableSamplers = nullptr;
                 layoutBindings[i].stageFlags = pDescriptors[i].stageFlags;
             }
-
-            VkDescriptorSetLayoutCreateInfo layoutInfo
-            { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO };
-            layoutInfo.bindingCount = size;
-            layoutInfo.pBindings = layoutBindings.data();
-
-            VK_CHECK_RESULT(vkCreateDescriptorSetLayout(GPU::device, &layoutInfo, nullptr, &layout));
+            layout = LayoutCache::setLayout(layoutBindings);
         }
         
     };
@@ -157,7 +120,7 @@ namespace vk {
 
             VkDescriptorPoolCreateInfo poolInfo
             { VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO };
-            poolInfo.poolSizeCount = size;
+            poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
             poolInfo.pPoolSizes = poolSizes.data();
             poolInfo.maxSets = size; //if MAX_FRAMES_IN_FLIGHT == 1, then there will be only 1 set.
             // ^number of sets that can be allocated by vkAllocateDescriptorSets()
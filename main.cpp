@@ -1,8 +1,14 @@
 #include "vk.engine.h"
 #include "vk.textures.h"
+#include "vk.bindless.h"
+#include "vk.streaming.h"
 
 #include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <format>
 #include <functional>
+#include <string_view>
 
 bool hasStencilComponent(VkFormat format) {
     return format == VK_FORMAT_D32_SFLOAT_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT;
@@ -18,23 +24,100 @@ vk::Engine app;
 
 vk::Uniforms uniforms;
 vk::UBO ubo(uniforms, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_GEOMETRY_BIT | VK_SHADER_STAGE_COMPUTE_BIT);
+vk::Bindless bindless;
 
 #include "Plane.h"
 #include "Icosahedron.h"
 #include "Particles.h"
+#include "Instances.h"
 
 vk::Scene world[] = {
     //{ planePPL, plane },
+    { batchPPL, batch },
     { icoPPL, icosphere },
 };
 
-vk::Shader planeCompute("plane.comp", VK_SHADER_STAGE_COMPUTE_BIT);
-vk::Shader particleCompute("point.comp", VK_SHADER_STAGE_COMPUTE_BIT);
+struct ParticleConstants {
+    vk::Workgroup localSize;    // Each workgroup is one particle and its invocations the others, so this is not tuned
+    float c;                    // Speed limit
+    float boundary;             // Half-width of the box particles wrap around
+};
+
+vk::Shader particleCompute("point.comp", VK_SHADER_STAGE_COMPUTE_BIT, ParticleConstants{ { 10, 10, 10 }, 1.0f, 0.8f });
 vk::ComputePPL computePPL[] = {
-    //{ planeCompute, planeSet, planeLayout, {heightMap.extent.width/100, heightMap.extent.height/100, 1 } },
     { particleCompute, pointSet, pointLayout, {100, 100, 10} }
 };
 
+void vertexBenchmark(uint32_t frames)
+{// The batch's grid drawn unculled from its packed arena, then from a full-precision copy, and an icosphere compressed and not; timed and counted on the GPU
+    vk::MeshArena fullArena(sizeof(triangleList), 1 << 16, 1 << 18);
+    vk::MeshArena::Range fullCube = fullArena.add(cubeVertices, cubeIndices);
+    vk::MeshArena::Range fullOct = fullArena.add(octVertices, octIndices);
+
+    vk::InstanceBatch packedBatch(arena, batchGrid * batchGrid, bindless);
+    vk::InstanceBatch fullBatch(fullArena, batchGrid * batchGrid, bindless);
+    populateBatch(packedBatch, cubeMesh, octMesh, batchGrid, 0.5f);
+    populateBatch(fullBatch, fullCube, fullOct, batchGrid, 0.5f);
+
+    vk::Shader fullShaders[] = {
+        {"batched.vert", VK_SHADER_STAGE_VERTEX_BIT, BatchVertex{ VK_FALSE }},
+        {"batched.frag", VK_SHADER_STAGE_FRAGMENT_BIT}
+    };
+    vk::GraphicsPPL<triangleList> fullPPL(fullShaders, batchSet, batchLayout, { vk::Bindless::pushRange });
+
+    vk::Profiler::enabled = true;
+    vk::Scene packedWorld[] = { { batchPPL, packedBatch } };
+    vk::Scene fullWorld[] = { { fullPPL, fullBatch } };
+    std::cout << std::format("arena vertices: {} bytes packed, {} at full precision\n", arena.storedBytes, fullArena.storedBytes);
+
+    auto measure = [&](auto& scenes, char const* name, VkDeviceSize stride) {
+        for (uint32_t i = 0; i < frames and !glfwWindowShouldClose(vk::Window::handle); i++) {
+            glfwPollEvents();
+            ubo.update(uniforms);
+            app.run(scenes, computePPL, particlePPL, ssbo);
+        }
+        vkDeviceWaitIdle(vk::GPU::device);
+        for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+            vk::Profiler::collect((vk::SwapChain::currentFrame + i) % MAX_FRAMES_IN_FLIGHT);
+        }
+        auto const& passes = vk::Profiler::results();
+        auto scene = std::find_if(passes.begin(), passes.end(), [](vk::Profiler::Pass const& pass) { return std::string_view(pass.name) == "scene"; });
+        if (scene == passes.end()) {
+            throw std::runtime_error("the scene pass was not timed; the graphics queue has no timestamps!");
+        }
+        std::cout << std::format("{:<6} {:8.3f} ms scene pass (average)", name, scene->average);
+        if (scene->statistics) {
+            std::cout << std::format(", {} vertex shader invocations, at most {} KiB of vertices fetched", scene->vertices, scene->vertices * stride >> 10);
+        }
+        std::cout << std::endl;
+    };
+    measure(packedWorld, "packed", sizeof(packedTriangleList));
+    measure(fullWorld, "full", sizeof(triangleList));
+
+    // A static icosphere drawn as built and again after compress, whose decode must bring every vertex back within a quantization step
+    vk::Geometry::Icosahedron fullSphere(icoRadius, 4);
+    vk::Geometry::Icosahedron quantizedSphere(icoRadius, 4);
+    quantizedSphere.compress<quantizedTriangleList>(quantizedSphere.vertices);
+
+    Quantization quantization = quantizedTriangleList::quantize(quantizedSphere.vertices);
+    float worst = 0.f;
+    for (triangleList const& vertex : quantizedSphere.vertices) {
+        quantizedTriangleList stored = quantizedTriangleList::encode(vertex, quantization);
+        glm::vec4 position = glm::unpackSnorm4x16(glm::packUint4x16(stored.position));
+        glm::vec3 decoded = glm::vec3(quantizedSphere.decode * glm::vec4(glm::vec3(position), 1.f));
+        worst = std::max(worst, glm::distance(decoded, glm::vec3(vertex.position)));
+    }
+    if (worst > glm::length(quantization.scale) / 32767.f or quantizedSphere.sphere() != fullSphere.sphere()) {
+        throw std::runtime_error(std::format("compress moved the mesh: {} off a vertex, or its bounds changed!", worst));
+    }
+    vk::GraphicsPPL<triangleList> fullSpherePPL(icoShaders, icoSet, icoLayout, { vk::test_Mesh::modelRange });
+    vk::GraphicsPPL<quantizedTriangleList> quantizedSpherePPL(icoShaders, icoSet, icoLayout, { vk::test_Mesh::modelRange });
+    vk::Scene fullSphereWorld[] = { { fullSpherePPL, fullSphere } };
+    vk::Scene quantizedSphereWorld[] = { { quantizedSpherePPL, quantizedSphere } };
+    measure(quantizedSphereWorld, "quantized sphere", sizeof(quantizedTriangleList));
+    measure(fullSphereWorld, "full sphere", sizeof(triangleList));
+}
+
 //double mouseX;
 //double mouseY;
 //void trackMouse(double x, double y) {
@@ -99,25 +182,171 @@ struct test_memcpy {
     }
 };
 
-int main() {
+int main(int argc, char** argv) {
+    if (argc == 3 and std::string(argv[1]) == "--texture-benchmark") {
+        try {
+            vk::TextureStreamer::benchmark(argv[2]);
+        }
+        catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+    if (argc == 3 and std::string(argv[1]) == "--archive-benchmark") {
+        try {
+            vk::StagingRing::benchmark(argv[2]);
+        }
+        catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+    if (argc == 2 and std::string(argv[1]) == "--terrain-benchmark") {
+        try {
+            vk::VirtualTexture::benchmark(terrainGenerator, vk::noise::Terrain{});
+            vk::noise::benchmark();
+        }
+        catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+    if (argc >= 2 and argc <= 3 and std::string(argv[1]) == "--planet-benchmark") {
+        try {
+            icosphere.benchmark(argc == 3 ? static_cast<uint32_t>(std::stoul(argv[2])) : 1000);
+        }
+        catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+    if (argc >= 2 and argc <= 3 and std::string(argv[1]) == "--simplify-benchmark") {
+        try {
+            vk::Optimizer::benchmarkSimplify(argc == 3 ? static_cast<uint32_t>(std::stoul(argv[2])) : 708);
+        }
+        catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+    if (argc >= 2 and argc <= 3 and std::string(argv[1]) == "--vertex-benchmark") {
+        try {
+            vertexBenchmark(argc == 3 ? static_cast<uint32_t>(std::stoul(argv[2])) : 300);
+        }
+        catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+    // --capture out.png|out.exr [frames] [golden]: the last of frames as presented, compared against golden when given
+    std::filesystem::path captureOutput, captureGolden;
+    uint32_t captureFrames = 0;
+    std::atomic<bool> capturePassed = true;
+    if (argc >= 3 and std::string(argv[1]) == "--capture") {
+        captureOutput = argv[2];
+        captureFrames = argc >= 4 ? static_cast<uint32_t>(std::stoul(argv[3])) : 60;
+        if (argc >= 5) {
+            captureGolden = argv[4];
+        }
+    }
+    // --profile trace.json [frames]: GPU passes of every frame, as a Chrome trace, and the last frame's as a table
+    std::filesystem::path profileOutput;
+    uint32_t profileFrames = 0;
+    if (argc >= 3 and std::string(argv[1]) == "--profile") {
+        profileOutput = argv[2];
+        profileFrames = argc >= 4 ? static_cast<uint32_t>(std::stoul(argv[3])) : 300;
+        vk::Profiler::enabled = true;
+        vk::Profiler::trace(true);
+    }
+    auto saveCapture = [&](vk::Readback::Capture& capture) {
+        try {
+            if (captureOutput.extension() == ".exr") {
+                vk::Readback::writeEXR(captureOutput, capture);
+            }
+            else {
+                vk::Readback::writePNG(captureOutput, capture);
+            }
+            if (!captureGolden.empty()) {
+                std::filesystem::path diff = captureOutput;
+                diff.replace_extension(".diff.png");
+                vk::Readback::Comparison comparison = vk::Readback::compare(capture, captureGolden, diff);
+                std::cout << std::format("{} against {}: PSNR {:.2f} dB, mean deltaE {:.3f}, {:.3f}% of pixels perceptibly different\n",
+                    captureOutput.string(), captureGolden.string(), comparison.psnr, comparison.meanDeltaE, 100. * comparison.perceptible);
+                capturePassed = comparison.pass();
+            }
+        }
+        catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+            capturePassed = false;
+        }
+    };
     //vk::Geometry::test_graph testGraph(icosphere.vertices);
     test_memcpy testing(test_vtx, test_idx);
     try {
         glfwSetKeyCallback(vk::Window::handle, userInput);
+        keyboard_map[GLFW_KEY_M] = []
+        {// The next sample count the device has, and after the most back to one
+            VkSampleCountFlags higher = vk::GPU::sampleCounts & ~((vk::GPU::msaaSamples << 1) - 1);
+            VkSampleCountFlagBits next = higher ? static_cast<VkSampleCountFlagBits>(higher & ~(higher - 1)) : VK_SAMPLE_COUNT_1_BIT;
+            try {
+                app.setSampleCount(next);
+                std::cout << std::format("{}x MSAA, {} KiB of render targets committed\n", static_cast<uint32_t>(next), app.targets.stats.committed >> 10);
+            }
+            catch (const std::exception& e) {
+                std::cerr << e.what() << std::endl;
+            }
+        };
+        keyboard_map[GLFW_KEY_P] = []
+        {// The first press turns the profiler on, later ones print the last frame it measured
+            if (!vk::Profiler::enabled) {
+                vk::Profiler::enabled = true;
+                std::cout << "profiling GPU passes; P again prints them\n";
+                return;
+            }
+            std::cout << vk::Profiler::report() << std::flush;
+        };
+        vk::test_Mesh::viewer = &uniforms.camera;
+        vk::RenderQueue::viewer = &uniforms.camera;
         //auto* instance = static_cast<vk::Camera*>(glfwGetWindowUserPointer(vk::Window::handle));
         //if (instance) {
         //    /* do stuff */
         //}
+        uint32_t frame = 0;
+        uint32_t lastFrame = std::max(captureFrames, profileFrames);  // None: until the window closes
         while (!glfwWindowShouldClose(vk::Window::handle)) {
             glfwPollEvents();
             //std::jthread tMouse(trackMouse, mouseX, mouseY);
 
             ubo.update(uniforms);
             
+            if (++frame == captureFrames) {
+                app.captureFrame(saveCapture);
+            }
             app.run(world, computePPL, particlePPL, ssbo);
             icosphere.updatePlates();
+            if (lastFrame and frame == lastFrame) {
+                break;
+            }
         }
         vkDeviceWaitIdle(vk::GPU::device);
+        if (profileFrames) {
+            // The frames still in flight, oldest first
+            for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+                vk::Profiler::collect((vk::SwapChain::currentFrame + i) % MAX_FRAMES_IN_FLIGHT);
+            }
+            vk::Profiler::writeTrace(profileOutput);
+            std::cout << std::format("{} frames traced to {}; the last:\n", frame, profileOutput.string()) << vk::Profiler::report();
+        }
+        if (captureFrames) {
+            app.readback.flush();
+            return capturePassed ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
     }
     catch (const std::exception& e) {
         std::cerr << e.what() << std::endl;
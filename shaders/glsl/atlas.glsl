@@ -0,0 +1,19 @@
+// Sampling TextureAtlas handles; include after #version and GL_EXT_nonuniform_qualifier, with ATLAS_SET the Bindless set
+#ifndef ATLAS_SET
+#define ATLAS_SET 1
+#endif
+
+// Bindless bindings 0 and 1, the images viewed as the atlas's 2D arrays
+layout(set = ATLAS_SET, binding = 0) uniform texture2DArray atlasArrays[];
+layout(set = ATLAS_SET, binding = 1) uniform sampler atlasSamplers[];
+
+// x: Bindless image slot in the low half, layer in the high; y: the texture's share of its layer, packUnorm2x16
+bool atlasTextured(uvec2 handle) {
+    return handle.y != 0u;
+}
+
+// uv over the texture alone, in 0..1; the handle may differ between invocations, the sampler slot may not
+vec4 atlasSample(uvec2 handle, uint samplerSlot, vec2 uv) {
+    vec3 coord = vec3(uv * unpackUnorm2x16(handle.y), float(handle.x >> 16));
+    return texture(sampler2DArray(atlasArrays[nonuniformEXT(handle.x & 0xFFFFu)], atlasSamplers[samplerSlot]), coord);
+}
@@ -0,0 +1,23 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+#extension GL_GOOGLE_include_directive : require
+
+#define ATLAS_SET 1
+#include "atlas.glsl"
+
+layout(location = 0) in vec4 fragNormal;
+layout(location = 1) in vec4 fragColor;
+layout(location = 2) in vec2 fragTexCoord;
+layout(location = 3) flat in uvec2 fragTexture;
+
+layout(location = 0) out vec4 outColor;
+
+layout(push_constant) uniform Handles {
+    uint instances;
+    uint atlasSampler; // Bindless sampler slot of the batch's atlas
+    uint unused[2];
+} handles;
+
+void main() {
+    outColor = atlasTextured(fragTexture) ? fragColor * atlasSample(fragTexture, handles.atlasSampler, fragTexCoord) : fragColor;
+}
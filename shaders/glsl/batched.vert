@@ -0,0 +1,60 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+#extension GL_GOOGLE_include_directive : require
+
+#include "packed.glsl"
+
+// packedTriangleList: half-float position, octahedral normal in xy; off for full-precision triangleList
+layout(constant_id = 0) const bool octahedralNormals = true;
+
+layout(location = 0) in vec4 inPosition;
+layout(location = 1) in vec4 inNormal;
+layout(location = 2) in vec4 inColor;
+layout(location = 3) in vec2 inTexCoord;
+
+layout(location = 0) out vec4 fragNormal;
+layout(location = 1) out vec4 fragColor;
+layout(location = 2) out vec2 fragTexCoord;
+layout(location = 3) flat out uvec2 fragTexture;
+
+struct camera{
+    mat4 view;
+    mat4 proj;
+    vec3 position;
+};
+
+struct Instance {
+    mat4 model;
+    vec4 bounds; // world-space center (xyz), radius (w)
+    uint mesh;
+    uint textureHandle; // TextureAtlas::Handle, zero for none
+    uint textureScale;
+};
+
+layout(set = 0, binding = 0) uniform UniformBufferObject {
+    double dt;
+    mat4 model;
+    camera cam; 
+} ubo;
+
+// Bindless table, binding 2: every registered storage buffer, viewed here as instance arrays
+layout(std430, set = 1, binding = 2) readonly buffer instanceSSBO {
+    Instance instances[ ];
+} buffers[ ];
+
+layout(push_constant) uniform Handles {
+    uint instances; // Bindless buffer slot of this frame's instance SSBO
+    uint atlasSampler;
+    uint unused[2];
+} handles;
+
+void main() {
+    Instance instance = buffers[handles.instances].instances[gl_InstanceIndex];
+    mat4 model = instance.model;
+    gl_Position = ubo.cam.proj * ubo.cam.view * model * inPosition;
+    fragColor = inColor;
+    vec3 normal = octahedralNormals ? octDecode(inNormal.xy) : inNormal.xyz;
+    fragNormal = vec4(mat3(model) * normal, 0.0);
+    fragTexCoord = inTexCoord;
+    fragTexture = uvec2(instance.textureHandle, instance.textureScale);
+}
@@ -21,7 +21,7 @@ layout(set = 0, binding = 0) uniform UniformBufferObject {
     camera cam; 
 } ubo;
 
-layout(set = 1, binding = 0) uniform model_UBO{
+layout(push_constant) uniform Model {
     mat4 matrix;
 } ico;
 
@@ -19,10 +19,6 @@ layout(set = 1, binding = 0) readonly buffer inSSBO {
    mat4 model[];
 } iSSBO;
 
-layout(set = 1, binding = 1) buffer outSSBO {
-   mat4 model[];
-} oSSBO;
-
 layout(set = 0, binding = 0) uniform UniformBufferObject {
     double dt;
     mat4 model;
@@ -30,9 +26,7 @@ layout(set = 0, binding = 0) uniform UniformBufferObject {
 } UBO;
 
 void main() {
-    oSSBO.model[gl_InstanceIndex] = iSSBO.model[gl_InstanceIndex];
-
-    gl_Position = UBO.cam.proj * UBO.cam.view * oSSBO.model[gl_InstanceIndex] * inPosition;
+    gl_Position = UBO.cam.proj * UBO.cam.view * iSSBO.model[gl_InstanceIndex] * inPosition;
     fragColor = inColor;
     fragTexCoord = inTexCoord;
 }
\ No newline at end of file
@@ -0,0 +1,9 @@
+// Decoding for PackedPrimitive attributes; include after #version
+
+// R16G16_SNORM octahedral normal back onto the unit sphere
+vec3 octDecode(vec2 oct) {
+    vec3 n = vec3(oct, 1.0 - abs(oct.x) - abs(oct.y));
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
@@ -21,15 +21,90 @@ layout(set = 0, binding = 0) uniform UniformBufferObject {
     camera cam; 
 } ubo;
 
-layout(set = 1, binding = 0) uniform model_UBO{
+layout(push_constant) uniform Model {
     mat4 matrix;
 } plane;
 
-layout (set = 2, binding = 0, rgba8_snorm) uniform readonly image2D heightMap;
+// VirtualTexture settings, see VirtualTexture::constants()
+layout (constant_id = 0) const int pageSize = 128;
+layout (constant_id = 1) const int window = 32;
+layout (constant_id = 2) const int levels = 8;
+layout (constant_id = 3) const int cacheSide = 16;
+layout (constant_id = 4) const float texelSize = 0.025;
+layout (constant_id = 5) const float lodDistance = 256.0;
+
+layout (set = 1, binding = 0, r32f) uniform readonly image2D cache;
+layout (set = 1, binding = 1) readonly buffer PageTable {
+    uint entries[];     // Slot + 1 in the low half, tag in the high; 0 when not resident
+};
+// A bit per table cell, then the pages this frame asked for as x, y, level, unused
+layout (set = 1, binding = 2) buffer Feedback {
+    uint count;
+    uint pad[3];
+    uint words[];
+};
+
+const int cells = levels * window * window;
+
+ivec2 floorDiv(ivec2 a, int b) {
+    return ivec2(floor(vec2(a) / float(b)));
+}
+int cellOf(ivec2 page, int level) {
+    ivec2 wrapped = page & (window - 1);
+    return (level * window + wrapped.y) * window + wrapped.x;
+}
+void request(ivec2 page, int level) {
+    // Once per cell and frame; VirtualTexture::record() reads the list back
+    int cell = cellOf(page, level);
+    uint bit = 1u << (cell & 31);
+    if ((atomicOr(words[cell >> 5], bit) & bit) == 0) {
+        uint index = uint(cells / 32) + 4u * atomicAdd(count, 1u);
+        words[index] = uint(page.x);
+        words[index + 1] = uint(page.y);
+        words[index + 2] = uint(level);
+    }
+}
+float height(ivec2 texel, int level) {
+    // The finest resident level from the one wanted up, read bilinearly by hand since r32f storage images have no sampler
+    int shift = findLSB(window);
+    for (int k = level; k < levels; k++) {
+        vec2 coord = vec2(texel) / float(1 << k);
+        ivec2 page = floorDiv(ivec2(floor(coord)), pageSize);
+        uint entry = entries[cellOf(page, k)];
+        uint tag = uint((page.x >> shift) & 0xFF) | (uint((page.y >> shift) & 0xFF) << 8);
+        if (entry == 0 || (entry >> 16) != tag) {
+            continue;
+        }
+        int slot = int(entry & 0xFFFF) - 1;
+        ivec2 origin = ivec2(slot % cacheSide, slot / cacheSide) * (pageSize + 1);
+        vec2 local = coord - vec2(page * pageSize);
+        ivec2 base = origin + ivec2(floor(local));
+        vec2 f = fract(local);
+        float h00 = imageLoad(cache, base).r;
+        float h10 = imageLoad(cache, base + ivec2(1, 0)).r;
+        float h01 = imageLoad(cache, base + ivec2(0, 1)).r;
+        float h11 = imageLoad(cache, base + ivec2(1, 1)).r;
+        return mix(mix(h00, h10, f.x), mix(h01, h11, f.x), f.y);
+    }
+    return 0.0;
+}
 
 void main() {
-    vec4 heightData = imageLoad(heightMap, ivec2(inTexCoord));
-    vec4 pos = vec4(inPosition.x, length(heightData), inPosition.z, inPosition[3]);
+    // The grid follows the viewer a whole texel at a time, so its vertices always land on texels
+    vec2 snap = floor(ubo.cam.position.xz / texelSize) * texelSize;
+    vec4 world = plane.matrix * inPosition + vec4(snap.x, 0, snap.y, 0);
+    ivec2 texel = ivec2(round(world.xz / texelSize));
+    ivec2 viewer = ivec2(floor(ubo.cam.position.xz / texelSize));
+
+    // Twice as coarse each lodDistance doubling, and coarser still if the finer page would fall outside its level's window
+    float dist = length(vec2(texel - viewer));
+    int level = clamp(int(floor(log2(max(dist, 1.0) / lodDistance))) + 1, 0, levels - 1);
+    while (level < levels - 1 && any(greaterThan(abs(floorDiv(texel >> level, pageSize) - floorDiv(viewer >> level, pageSize)), ivec2(window / 2 - 1)))) {
+        level++;
+    }
+    request(floorDiv(texel >> level, pageSize), level);
+
+    vec4 pos = vec4(inPosition.x + snap.x, height(texel, level), inPosition.z + snap.y, inPosition[3]);
 
     gl_Position = ubo.cam.proj * ubo.cam.view * plane.matrix * pos;
     fragColor = inColor;
@@ -0,0 +1,83 @@
+// Offline texture cooker: images in, KTX2 files with a full precomputed mip chain out. Needs no GPU or Vulkan loader,
+// only the Vulkan and stb headers, e.g.
+//     g++ -std=c++20 -O2 -I.. -I<stb> texcook.cpp ../vk.ktx.cpp -o texcook
+// Each image a/b.png becomes a/b.<codec>.ktx2 for every codec asked for; CompressedTexture("a/b") picks among them at load.
+#include "../vk.ktx.h"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+namespace {
+    void usage() {
+        std::cerr << "usage: texcook [--codecs bc7,bc3,bc1,bc4,bc5,rgba8] [--linear] image...\n"
+                     "  --codecs  files to write, in any order (default bc7,bc1,rgba8)\n"
+                     "  --linear  data rather than colour, e.g. normal maps: no sRGB encoding or sRGB-correct mips\n";
+    }
+}
+
+int main(int argc, char** argv) {
+    std::vector<vk::ktx::Codec> codecs = { vk::ktx::Codec::BC7, vk::ktx::Codec::BC1, vk::ktx::Codec::RGBA8 };
+    bool srgb = true;
+    std::vector<std::filesystem::path> images;
+    try {
+        for (int i = 1; i < argc; i++) {
+            std::string argument = argv[i];
+            if (argument == "--codecs" and i + 1 < argc) {
+                codecs.clear();
+                std::stringstream list(argv[++i]);
+                for (std::string name; std::getline(list, name, ',');) {
+                    codecs.push_back(vk::ktx::codec(name));
+                }
+            }
+            else if (argument == "--linear") {
+                srgb = false;
+            }
+            else if (argument.starts_with("--")) {
+                usage();
+                return EXIT_FAILURE;
+            }
+            else {
+                images.push_back(argument);
+            }
+        }
+        if (images.empty()) {
+            usage();
+            return EXIT_FAILURE;
+        }
+        for (std::filesystem::path const& image : images) {
+            int width, height, channels;
+            stbi_uc* pixels = stbi_load(image.string().c_str(), &width, &height, &channels, STBI_rgb_alpha);
+            if (!pixels) {
+                throw std::runtime_error("failed to load " + image.string() + ": " + stbi_failure_reason());
+            }
+            VkDeviceSize uncompressed = 0;
+            for (vk::ktx::Level const& level : vk::ktx::mipChain(pixels, width, height, srgb)) {
+                uncompressed += level.data.size();
+            }
+            for (vk::ktx::Codec codec : codecs) {
+                auto start = std::chrono::steady_clock::now();
+                vk::ktx::File file = vk::ktx::cook(pixels, width, height, codec, srgb);
+
+                std::filesystem::path output = image;
+                output.replace_extension("." + std::string(vk::ktx::name(codec)) + ".ktx2");
+                vk::ktx::write(output, file);
+                double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+                std::cout << output.string() << ": " << width << "x" << height << ", " << file.levels.size() << " levels, "
+                    << std::fixed << std::setprecision(1) << file.size() / 1024.0 << " KiB ("
+                    << double(uncompressed) / file.size() << "x smaller than RGBA8 with mips), "
+                    << std::setprecision(0) << milliseconds << " ms\n";
+            }
+            stbi_image_free(pixels);
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,118 @@
+// Asset packer: loose files in, one archive out, for Archive::mounted() to read in place. Needs no Vulkan, e.g.
+//     g++ -std=c++20 -O2 -I.. vkpak.cpp ../vk.archive.cpp -o vkpak
+// Entries are named by their path relative to the working directory with '/' separators, so run it from where
+// the engine runs: vkpak assets.vkpak shaders textures packs shaders/mipmap.comp.spv as the Shader "mipmap.comp" looks it up.
+#include "../vk.archive.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+namespace {
+    void usage() {
+        std::cerr << "usage: vkpak [--lz4] [--align bytes] [--exclude .ext,...] archive path...\n"
+                     "       vkpak --list archive\n"
+                     "  --lz4      compress entries LZ4 shrinks by an eighth or more; those are no longer read in place\n"
+                     "  --align    blob alignment, a power of two (default 256, a multiple of every texel block and copy alignment)\n"
+                     "  --exclude  extensions to leave out of directories (default .glsl sources: .vert,.frag,.comp,.geom,.tesc,.tese,.glsl)\n";
+    }
+    std::string lower(std::string text) {
+        std::transform(text.begin(), text.end(), text.begin(), [](char c) { return static_cast<char>(std::tolower(c)); });
+        return text;
+    }
+    std::vector<uint8_t> load(std::filesystem::path const& path) {
+        std::ifstream stream(path, std::ios::binary | std::ios::ate);
+        if (!stream) {
+            throw std::runtime_error("failed to open " + path.string() + "!");
+        }
+        std::vector<uint8_t> bytes(static_cast<size_t>(stream.tellg()));
+        stream.seekg(0);
+        stream.read(reinterpret_cast<char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+        return bytes;
+    }
+    int list(std::filesystem::path const& path) {
+        vk::Archive archive(path);
+        uint64_t raw = 0, stored = 0;
+        for (std::string const& name : archive.names()) {
+            vk::Archive::Entry const& entry = *archive.find(name);
+            std::cout << std::setw(12) << entry.rawSize << std::setw(12) << entry.size
+                      << (entry.compression == vk::Archive::Compression::LZ4 ? "  lz4   " : "  stored") << "  " << name << '\n';
+            raw += entry.rawSize;
+            stored += entry.size;
+        }
+        std::cout << std::setw(12) << raw << std::setw(12) << stored << "  " << archive.names().size() << " entries, aligned to " << archive.alignment << '\n';
+        return EXIT_SUCCESS;
+    }
+}
+
+int main(int argc, char** argv) {
+    bool compress = false;
+    uint32_t alignment = 256;
+    std::vector<std::string> excluded = { ".vert", ".frag", ".comp", ".geom", ".tesc", ".tese", ".glsl" };
+    std::vector<std::filesystem::path> arguments;
+    try {
+        for (int i = 1; i < argc; i++) {
+            std::string argument = argv[i];
+            if (argument == "--list" and i + 2 == argc) {
+                return list(argv[i + 1]);
+            }
+            else if (argument == "--lz4") {
+                compress = true;
+            }
+            else if (argument == "--align" and i + 1 < argc) {
+                alignment = static_cast<uint32_t>(std::stoul(argv[++i]));
+            }
+            else if (argument == "--exclude" and i + 1 < argc) {
+                excluded.clear();
+                std::stringstream extensions(argv[++i]);
+                for (std::string extension; std::getline(extensions, extension, ',');) {
+                    excluded.push_back(lower(extension));
+                }
+            }
+            else if (argument.starts_with("--")) {
+                usage();
+                return EXIT_FAILURE;
+            }
+            else {
+                arguments.push_back(argument);
+            }
+        }
+        if (arguments.size() < 2) {
+            usage();
+            return EXIT_FAILURE;
+        }
+
+        // Files named outright are always packed; directories are walked, less the excluded extensions
+        std::vector<std::filesystem::path> files;
+        for (auto path = arguments.begin() + 1; path != arguments.end(); path++) {
+            if (!std::filesystem::is_directory(*path)) {
+                files.push_back(*path);
+                continue;
+            }
+            for (std::filesystem::directory_entry const& entry : std::filesystem::recursive_directory_iterator(*path)) {
+                std::string extension = lower(entry.path().extension().string());
+                if (entry.is_regular_file() and std::find(excluded.begin(), excluded.end(), extension) == excluded.end()) {
+                    files.push_back(entry.path());
+                }
+            }
+        }
+        std::sort(files.begin(), files.end());
+
+        vk::Archive::Writer writer(arguments[0], alignment);
+        for (std::filesystem::path const& file : files) {
+            std::string name = vk::Archive::name(std::filesystem::relative(file));
+            std::vector<uint8_t> bytes = load(file);
+            vk::Archive::Compression compression = writer.add(name, bytes, compress);
+            std::cout << (compression == vk::Archive::Compression::LZ4 ? "lz4     " : "stored  ") << name << '\n';
+        }
+        writer.finish();
+        std::cout << files.size() << " files, " << writer.rawBytes << " bytes packed into " << writer.storedBytes
+                  << " (" << std::fixed << std::setprecision(1) << (writer.rawBytes ? 100. * writer.storedBytes / writer.rawBytes : 100.) << "%)\n";
+    }
+    catch (std::exception const& e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
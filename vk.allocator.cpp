@@ -0,0 +1,209 @@
+#include "vk.allocator.h"
+
+namespace vk {
+    /* Layout Cache */
+    VkDescriptorSetLayout LayoutCache::setLayout(std::vector<VkDescriptorSetLayoutBinding> bindings) {
+        std::sort(bindings.begin(), bindings.end(), [](VkDescriptorSetLayoutBinding const& a, VkDescriptorSetLayoutBinding const& b) { return a.binding < b.binding; });
+        SetKey key{ std::move(bindings) };
+        if (auto cached = setLayouts.find(key); cached != setLayouts.end()) {
+            hits++;
+            return cached->second;
+        }
+
+        VkDescriptorSetLayoutCreateInfo layoutInfo
+        { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO };
+        layoutInfo.bindingCount = static_cast<uint32_t>(key.bindings.size());
+        layoutInfo.pBindings = key.bindings.data();
+
+        VkDescriptorSetLayout layout;
+        VK_CHECK_RESULT(vkCreateDescriptorSetLayout(GPU::device, &layoutInfo, nullptr, &layout));
+        setLayouts.emplace(std::move(key), layout);
+        return layout;
+    }
+    VkPipelineLayout LayoutCache::pipelineLayout(std::vector<VkDescriptorSetLayout> const& layouts, std::vector<VkPushConstantRange> const& pushRanges) {
+        PipelineKey key{ layouts, pushRanges };
+        if (auto cached = pipelineLayouts.find(key); cached != pipelineLayouts.end()) {
+            hits++;
+            return cached->second;
+        }
+
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo
+        { VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO };
+        pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(layouts.size());
+        pipelineLayoutInfo.pSetLayouts = layouts.data();
+        pipelineLayoutInfo.pushConstantRangeCount = static_cast<uint32_t>(pushRanges.size());
+        pipelineLayoutInfo.pPushConstantRanges = pushRanges.data();
+
+        VkPipelineLayout layout;
+        VK_CHECK_RESULT(vkCreatePipelineLayout(GPU::device, &pipelineLayoutInfo, nullptr, &layout));
+        pipelineLayouts.emplace(std::move(key), layout);
+        return layout;
+    }
+    void LayoutCache::destroy() {
+        for (auto& [key, layout] : pipelineLayouts) {
+            vkDestroyPipelineLayout(GPU::device, layout, nullptr);
+        }
+        for (auto& [key, layout] : setLayouts) {
+            vkDestroyDescriptorSetLayout(GPU::device, layout, nullptr);
+        }
+        pipelineLayouts.clear();
+        setLayouts.clear();
+    }
+    /* Private */
+    bool LayoutCache::SetKey::operator==(SetKey const& other) const {
+        return std::equal(bindings.begin(), bindings.end(), other.bindings.begin(), other.bindings.end(),
+            [](VkDescriptorSetLayoutBinding const& a, VkDescriptorSetLayoutBinding const& b) {
+                return a.binding == b.binding and a.descriptorType == b.descriptorType and a.descriptorCount == b.descriptorCount
+                    and a.stageFlags == b.stageFlags and a.pImmutableSamplers == b.pImmutableSamplers;
+            });
+    }
+    bool LayoutCache::PipelineKey::operator==(PipelineKey const& other) const {
+        return setLayouts == other.setLayouts and std::equal(pushRanges.begin(), pushRanges.end(), other.pushRanges.begin(), other.pushRanges.end(),
+            [](VkPushConstantRange const& a, VkPushConstantRange const& b) {
+                return a.stageFlags == b.stageFlags and a.offset == b.offset and a.size == b.size;
+            });
+    }
+    size_t LayoutCache::Hash::operator()(SetKey const& key) const
+    {// FNV-1a over the fields operator== compares
+        size_t hash = 14695981039346656037ull;
+        auto mix = [&](uint64_t value) { hash = (hash ^ value) * 1099511628211ull; };
+        for (VkDescriptorSetLayoutBinding const& binding : key.bindings) {
+            mix(binding.binding);
+            mix(binding.descriptorType);
+            mix(binding.descriptorCount);
+            mix(binding.stageFlags);
+            mix(reinterpret_cast<uintptr_t>(binding.pImmutableSamplers));
+        }
+        return hash;
+    }
+    size_t LayoutCache::Hash::operator()(PipelineKey const& key) const {
+        size_t hash = 14695981039346656037ull;
+        auto mix = [&](uint64_t value) { hash = (hash ^ value) * 1099511628211ull; };
+        for (VkDescriptorSetLayout layout : key.setLayouts) {
+            mix(reinterpret_cast<uint64_t>(layout));
+        }
+        for (VkPushConstantRange const& range : key.pushRanges) {
+            mix(range.stageFlags);
+            mix((uint64_t(range.offset) << 32) | range.size);
+        }
+        return hash;
+    }
+
+    /* Descriptor Allocator */
+    VkDescriptorSet DescriptorAllocator::allocate(VkDescriptorSetLayout layout) {
+        std::vector<VkDescriptorSet> sets;
+        allocate({ layout }, sets);
+        return sets[0];
+    }
+    void DescriptorAllocator::allocate(std::vector<VkDescriptorSetLayout> const& layouts, std::vector<VkDescriptorSet>& sets) {
+        if (current == VK_NULL_HANDLE) {
+            current = nextPool();
+        }
+        sets.resize(layouts.size());
+
+        VkDescriptorSetAllocateInfo allocInfo
+        { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO };
+        allocInfo.descriptorPool = current;
+        allocInfo.descriptorSetCount = static_cast<uint32_t>(layouts.size());
+        allocInfo.pSetLayouts = layouts.data();
+
+        VkResult result = vkAllocateDescriptorSets(GPU::device, &allocInfo, sets.data());
+        if (result == VK_ERROR_OUT_OF_POOL_MEMORY or result == VK_ERROR_FRAGMENTED_POOL) {
+            // The current pool is full; retry once in a fresh one
+            current = nextPool();
+            allocInfo.descriptorPool = current;
+            result = vkAllocateDescriptorSets(GPU::device, &allocInfo, sets.data());
+        }
+        VK_CHECK_RESULT(result);
+        for (VkDescriptorSet set : sets) {
+            owners[set] = current;
+        }
+        live[current] += static_cast<uint32_t>(sets.size());
+    }
+    void DescriptorAllocator::free(std::vector<VkDescriptorSet> const& sets) {
+        std::vector<VkDescriptorSet> unique(sets);
+        std::sort(unique.begin(), unique.end());
+        unique.erase(std::unique(unique.begin(), unique.end()), unique.end());
+
+        std::unordered_map<VkDescriptorPool, std::vector<VkDescriptorSet>> byPool;
+        for (VkDescriptorSet set : unique) {
+            if (auto owner = owners.find(set); owner != owners.end()) {
+                byPool[owner->second].push_back(set);
+                owners.erase(owner);
+            }
+        }
+        for (auto& [pool, poolSets] : byPool) {
+            VK_CHECK_RESULT(vkFreeDescriptorSets(GPU::device, pool, static_cast<uint32_t>(poolSets.size()), poolSets.data()));
+            uint32_t& count = live[pool];
+            count -= static_cast<uint32_t>(poolSets.size());
+            if (count == 0 and pool != current) {
+                // Reset rather than left to fragment, and handed out again before a new pool is made
+                VK_CHECK_RESULT(vkResetDescriptorPool(GPU::device, pool, 0));
+                std::erase(used, pool);
+                ready.push_back(pool);
+                live.erase(pool);
+            }
+        }
+    }
+    void DescriptorAllocator::reset()
+    {// Only once the GPU has finished with every set this allocator handed out
+        for (VkDescriptorPool pool : used) {
+            VK_CHECK_RESULT(vkResetDescriptorPool(GPU::device, pool, 0));
+            ready.push_back(pool);
+        }
+        used.clear();
+        owners.clear();
+        live.clear();
+        current = VK_NULL_HANDLE;
+    }
+    void DescriptorAllocator::destroy() {
+        reset();
+        for (VkDescriptorPool pool : ready) {
+            vkDestroyDescriptorPool(GPU::device, pool, nullptr);
+        }
+        ready.clear();
+    }
+    void DescriptorAllocator::create() {
+        persistent = new DescriptorAllocator(64);
+        for (DescriptorAllocator*& frame : frames) {
+            frame = new DescriptorAllocator(256);
+        }
+    }
+    void DescriptorAllocator::destroyAll() {
+        persistent->destroy();
+        delete persistent;
+        persistent = nullptr;   // Owners that outlive the device have nothing left to give back
+        for (DescriptorAllocator*& frame : frames) {
+            frame->destroy();
+            delete frame;
+            frame = nullptr;
+        }
+    }
+    /* Private */
+    VkDescriptorPool DescriptorAllocator::nextPool() {
+        if (!ready.empty()) {
+            VkDescriptorPool pool = ready.back();
+            ready.pop_back();
+            used.push_back(pool);
+            return pool;
+        }
+
+        std::array<VkDescriptorPoolSize, ratios.size()> poolSizes;
+        for (size_t i = 0; i < ratios.size(); i++) {
+            poolSizes[i] = { ratios[i].first, static_cast<uint32_t>(ratios[i].second * setsPerPool) };
+        }
+        VkDescriptorPoolCreateInfo poolInfo
+        { VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO };
+        poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+        poolInfo.pPoolSizes = poolSizes.data();
+        poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+        poolInfo.maxSets = setsPerPool;
+
+        VkDescriptorPool pool;
+        VK_CHECK_RESULT(vkCreateDescriptorPool(GPU::device, &poolInfo, nullptr, &pool));
+        used.push_back(pool);
+        // Each new pool is twice the last, so a thousand materials cost a handful of pools
+        setsPerPool = std::min(setsPerPool * 2, 4096u);
+        return pool;
+    }
+}
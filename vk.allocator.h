@@ -0,0 +1,76 @@
+#pragma once
+#ifndef hAllocator
+#define hAllocator
+
+#include "vk.gpu.h"
+
+#include <algorithm>
+#include <array>
+#include <unordered_map>
+
+namespace vk {
+    struct LayoutCache
+    {// Set and pipeline layouts deduplicated by content; every handle lives until the device is destroyed
+        static VkDescriptorSetLayout setLayout(std::vector<VkDescriptorSetLayoutBinding> bindings);
+        static VkPipelineLayout pipelineLayout(std::vector<VkDescriptorSetLayout> const& setLayouts, std::vector<VkPushConstantRange> const& pushRanges = {});
+        static void destroy();
+    public:
+        inline static uint32_t hits = 0;    // Requests served without creating a layout
+    private:
+        struct SetKey {
+            std::vector<VkDescriptorSetLayoutBinding> bindings;  // Sorted by binding
+            bool operator==(SetKey const& other) const;
+        };
+        struct PipelineKey {
+            std::vector<VkDescriptorSetLayout> setLayouts;
+            std::vector<VkPushConstantRange> pushRanges;
+            bool operator==(PipelineKey const& other) const;
+        };
+        struct Hash {
+            size_t operator()(SetKey const& key) const;
+            size_t operator()(PipelineKey const& key) const;
+        };
+        inline static std::unordered_map<SetKey, VkDescriptorSetLayout, Hash> setLayouts;
+        inline static std::unordered_map<PipelineKey, VkPipelineLayout, Hash> pipelineLayouts;
+    };
+
+    struct DescriptorAllocator
+    {// Chained pools that grow as they fill; sets go back one by one with free(), or all at once with reset(),
+     // and a filled pool whose sets have all gone back is reset and reused
+        DescriptorAllocator(uint32_t setsPerPool = 64) : setsPerPool(setsPerPool) {}
+    public:
+        inline static DescriptorAllocator* persistent = nullptr;   // Sets that live as long as their owner
+        // Transient sets, for one frame's commands; reset when the frame slot comes around again, once its fences have passed
+        inline static std::array<DescriptorAllocator*, MAX_FRAMES_IN_FLIGHT> frames{};
+
+        VkDescriptorSet allocate(VkDescriptorSetLayout layout);
+        void allocate(std::vector<VkDescriptorSetLayout> const& layouts, std::vector<VkDescriptorSet>& sets);
+        // Once the GPU is done with them; a set may appear more than once, and null handles are skipped
+        void free(std::vector<VkDescriptorSet> const& sets);
+        void reset();
+        bool empty() const { return used.empty(); }     // Nothing handed out since the last reset
+        void destroy();
+        static void create();
+        static void destroyAll();
+    private:
+        uint32_t setsPerPool;
+        VkDescriptorPool current = VK_NULL_HANDLE;
+        std::vector<VkDescriptorPool> used;         // Filled pools, including current
+        std::vector<VkDescriptorPool> ready;        // Reset pools waiting to be reused
+        std::unordered_map<VkDescriptorSet, VkDescriptorPool> owners;
+        std::unordered_map<VkDescriptorPool, uint32_t> live;    // Sets handed out and not yet freed, per pool
+        inline static constexpr std::array<std::pair<VkDescriptorType, float>, 7> ratios{ {
+            { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2.f },
+            { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4.f },
+            { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4.f },
+            { VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 2.f },
+            { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 2.f },
+            { VK_DESCRIPTOR_TYPE_SAMPLER, 1.f },
+            { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1.f }
+        } };    // Descriptors of each type per set in a pool
+
+        VkDescriptorPool nextPool();
+    };
+}
+
+#endif
@@ -0,0 +1,392 @@
+#include "vk.archive.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace vk {
+    namespace lz4 {
+        namespace {
+            constexpr size_t minMatch = 4;
+            constexpr size_t lastLiterals = 5;     // The format ends every block on at least this many literals
+            constexpr size_t matchLimit = 12;      // ... and starts no match closer than this to the end
+            constexpr uint32_t hashBits = 12;
+
+            uint32_t read32(uint8_t const* p) {
+                uint32_t value;
+                std::memcpy(&value, p, sizeof(value));
+                return value;
+            }
+            void putLength(std::vector<uint8_t>& out, size_t length) {
+                // Past the token's 15, in runs of 255 closed by a smaller byte
+                for (; length >= 255; length -= 255) {
+                    out.push_back(255);
+                }
+                out.push_back(static_cast<uint8_t>(length));
+            }
+            void putSequence(std::vector<uint8_t>& out, uint8_t const* literals, size_t literalCount, size_t offset, size_t matchLength) {
+                size_t extraMatch = matchLength ? matchLength - minMatch : 0;
+                out.push_back(static_cast<uint8_t>((std::min<size_t>(literalCount, 15) << 4) | std::min<size_t>(extraMatch, 15)));
+                if (literalCount >= 15) {
+                    putLength(out, literalCount - 15);
+                }
+                out.insert(out.end(), literals, literals + literalCount);
+                if (!matchLength) {
+                    return;
+                }
+                out.push_back(static_cast<uint8_t>(offset));
+                out.push_back(static_cast<uint8_t>(offset >> 8));
+                if (extraMatch >= 15) {
+                    putLength(out, extraMatch - 15);
+                }
+            }
+        }
+        std::vector<uint8_t> compress(std::span<uint8_t const> source)
+        {// Greedy, one candidate per hash; fast rather than tight
+            std::vector<uint8_t> out;
+            out.reserve(source.size() + source.size() / 255 + 16);
+            uint8_t const* in = source.data();
+            size_t size = source.size(), anchor = 0;
+            if (size > matchLimit) {
+                std::vector<uint32_t> table(size_t(1) << hashBits, 0);     // Position + 1 of the last 4 bytes with each hash
+                for (size_t position = 0; position < size - matchLimit;) {
+                    uint32_t sequence = read32(in + position);
+                    uint32_t& slot = table[(sequence * 2654435761u) >> (32 - hashBits)];
+                    size_t candidate = slot;
+                    slot = static_cast<uint32_t>(position + 1);
+                    if (!candidate-- or position - candidate > 65535 or read32(in + candidate) != sequence) {
+                        position++;
+                        continue;
+                    }
+                    size_t length = minMatch;
+                    while (position + length < size - lastLiterals and in[candidate + length] == in[position + length]) {
+                        length++;
+                    }
+                    putSequence(out, in + anchor, position - anchor, position - candidate, length);
+                    position += length;
+                    anchor = position;
+                }
+            }
+            putSequence(out, in + anchor, size - anchor, 0, 0);
+            return out;
+        }
+        void decompress(std::span<uint8_t const> source, std::span<uint8_t> destination) {
+            uint8_t const* in = source.data();
+            uint8_t const* inEnd = in + source.size();
+            uint8_t* out = destination.data();
+            uint8_t* outEnd = out + destination.size();
+            auto corrupt = []() { throw std::runtime_error("corrupt LZ4 block!"); };
+            auto length = [&](size_t value) {
+                if (value == 15) {
+                    for (uint8_t byte = 255; byte == 255;) {
+                        if (in == inEnd) {
+                            corrupt();
+                        }
+                        byte = *in++;
+                        value += byte;
+                    }
+                }
+                return value;
+            };
+            while (in < inEnd) {
+                uint8_t token = *in++;
+                size_t literals = length(token >> 4);
+                if (literals > size_t(inEnd - in) or literals > size_t(outEnd - out)) {
+                    corrupt();
+                }
+                std::memcpy(out, in, literals);
+                in += literals;
+                out += literals;
+                if (in == inEnd) {
+                    break;      // Last sequence: literals only
+                }
+                if (inEnd - in < 2) {
+                    corrupt();
+                }
+                size_t offset = in[0] | (in[1] << 8);
+                in += 2;
+                size_t matchLength = length(token & 15) + minMatch;
+                if (offset == 0 or offset > size_t(out - destination.data()) or matchLength > size_t(outEnd - out)) {
+                    corrupt();
+                }
+                // Byte by byte: a match may overlap the bytes it is producing
+                uint8_t const* match = out - offset;
+                for (size_t i = 0; i < matchLength; i++) {
+                    out[i] = match[i];
+                }
+                out += matchLength;
+            }
+            if (out != outEnd) {
+                corrupt();
+            }
+        }
+    }
+
+    namespace {
+        struct Header {
+            char magic[8];
+            uint32_t version;
+            uint32_t alignment;
+            uint32_t entryCount;
+            uint32_t reserved;
+            uint64_t tableOffset;
+            uint64_t tableSize;
+        };
+        static_assert(sizeof(Header) == 40);
+        struct Record {     // One per entry in the table of contents, followed by nameLength bytes of name
+            uint64_t offset;
+            uint64_t size;
+            uint64_t rawSize;
+            uint32_t compression;
+            uint32_t nameLength;
+        };
+        static_assert(sizeof(Record) == 32);
+    }
+
+    Archive::Archive(std::filesystem::path const& path) : path(path)
+    {
+        std::string const name = path.string();
+#ifdef _WIN32
+        file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        LARGE_INTEGER fileSize{};
+        if (file == INVALID_HANDLE_VALUE or !GetFileSizeEx(file, &fileSize)) {
+            if (file != INVALID_HANDLE_VALUE) {
+                CloseHandle(file);
+            }
+            file = nullptr;
+            throw std::runtime_error("failed to open " + name + "!");
+        }
+        size = static_cast<uint64_t>(fileSize.QuadPart);
+        mapping = size ? CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+        data = mapping ? static_cast<uint8_t const*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+#else
+        descriptor = open(name.c_str(), O_RDONLY);
+        struct stat status {};
+        if (descriptor < 0 or fstat(descriptor, &status) != 0) {
+            unmap();
+            throw std::runtime_error("failed to open " + name + "!");
+        }
+        size = static_cast<uint64_t>(status.st_size);
+        void* address = size ? mmap(nullptr, size, PROT_READ, MAP_SHARED, descriptor, 0) : MAP_FAILED;
+        data = address == MAP_FAILED ? nullptr : static_cast<uint8_t const*>(address);
+#endif
+        // From here the destructor would not run, so failures unmap first
+        auto fail = [&](std::string const& reason) {
+            unmap();
+            throw std::runtime_error(name + ": " + reason);
+        };
+        if (!data or size < sizeof(Header)) {
+            fail("not a packed archive!");
+        }
+        Header header;
+        std::memcpy(&header, data, sizeof(Header));
+        if (std::memcmp(header.magic, magic, sizeof(magic)) != 0 or header.version != version) {
+            fail("not a packed archive, or one from another version!");
+        }
+        if (header.tableOffset > size or header.tableSize > size - header.tableOffset) {
+            fail("table of contents past the end of the file!");
+        }
+        alignment = header.alignment;
+
+        uint8_t const* record = data + header.tableOffset;
+        uint8_t const* end = record + header.tableSize;
+        for (uint32_t i = 0; i < header.entryCount; i++) {
+            Record fields;
+            if (size_t(end - record) < sizeof(Record)) {
+                fail("truncated table of contents!");
+            }
+            std::memcpy(&fields, record, sizeof(Record));
+            record += sizeof(Record);
+            if (size_t(end - record) < fields.nameLength) {
+                fail("truncated table of contents!");
+            }
+            std::string entryName(reinterpret_cast<char const*>(record), fields.nameLength);
+            record += fields.nameLength;
+            if (fields.offset > header.tableOffset or fields.size > header.tableOffset - fields.offset or fields.compression > uint32_t(Compression::LZ4)
+                or (fields.compression == uint32_t(Compression::None) and fields.size != fields.rawSize)) {
+                fail("bad entry " + entryName + "!");
+            }
+            entries.emplace(std::move(entryName), Entry{ fields.offset, fields.size, fields.rawSize, Compression(fields.compression) });
+        }
+    }
+    Archive::~Archive() {
+        unmap();
+    }
+    /* Public */
+    Archive::Entry const* Archive::find(std::string_view name) const {
+        auto entry = entries.find(name);
+        return entry == entries.end() ? nullptr : &entry->second;
+    }
+    std::vector<std::string> Archive::names() const {
+        std::vector<std::string> result;
+        result.reserve(entries.size());
+        for (auto const& [name, entry] : entries) {
+            result.push_back(name);
+        }
+        return result;
+    }
+    std::span<uint8_t const> Archive::stored(Entry const& entry) const {
+        return { data + entry.offset, static_cast<size_t>(entry.size) };
+    }
+    std::span<uint8_t const> Archive::view(std::string_view name) const {
+        Entry const& entry = at(name);
+        if (entry.compression != Compression::None) {
+            throw std::runtime_error(std::string(name) + " is compressed in " + path.string() + " and cannot be read in place!");
+        }
+        return stored(entry);
+    }
+    std::span<uint8_t const> Archive::contents(Entry const& entry, std::vector<uint8_t>& scratch) const {
+        if (entry.compression == Compression::None) {
+            return stored(entry);
+        }
+        scratch.resize(static_cast<size_t>(entry.rawSize));
+        read(entry, scratch.data());
+        return scratch;
+    }
+    void Archive::read(Entry const& entry, void* destination) const {
+        std::span<uint8_t> out(static_cast<uint8_t*>(destination), static_cast<size_t>(entry.rawSize));
+        if (entry.compression == Compression::None) {
+            std::memcpy(out.data(), data + entry.offset, out.size());
+        }
+        else {
+            lz4::decompress(stored(entry), out);
+        }
+    }
+    std::vector<uint8_t> Archive::read(std::string_view name) const {
+        Entry const& entry = at(name);
+        std::vector<uint8_t> bytes(static_cast<size_t>(entry.rawSize));
+        read(entry, bytes.data());
+        return bytes;
+    }
+    Archive const* Archive::mounted() {
+        static std::unique_ptr<Archive> const archive = []() -> std::unique_ptr<Archive> {
+            char const* variable = std::getenv("VK_ASSETS");
+            std::filesystem::path file = variable ? variable : "assets.vkpak";
+            if (!std::filesystem::exists(file)) {
+                return nullptr;
+            }
+            return std::make_unique<Archive>(file);
+        }();
+        return archive.get();
+    }
+    std::string Archive::name(std::filesystem::path const& path) {
+        return path.lexically_normal().generic_string();
+    }
+    /* Private */
+    void Archive::unmap() {
+#ifdef _WIN32
+        if (data) {
+            UnmapViewOfFile(data);
+        }
+        if (mapping) {
+            CloseHandle(mapping);
+        }
+        if (file) {
+            CloseHandle(file);
+        }
+        mapping = file = nullptr;
+#else
+        if (data) {
+            munmap(const_cast<uint8_t*>(data), size);
+        }
+        if (descriptor >= 0) {
+            close(descriptor);
+        }
+        descriptor = -1;
+#endif
+        data = nullptr;
+    }
+    Archive::Entry const& Archive::at(std::string_view name) const {
+        Entry const* entry = find(name);
+        if (!entry) {
+            throw std::runtime_error(std::string(name) + " is not in " + path.string() + "!");
+        }
+        return *entry;
+    }
+
+    /* Writer */
+    Archive::Writer::Writer(std::filesystem::path const& path, uint32_t alignment)
+        : file(path, std::ios::binary | std::ios::trunc), path(path), alignment(alignment)
+    {
+        if (!file) {
+            throw std::runtime_error("failed to create " + path.string() + "!");
+        }
+        if (alignment < 4 or (alignment & (alignment - 1))) {
+            throw std::runtime_error("archive alignment must be a power of two, at least 4 for SPIR-V!");
+        }
+        Header header{};
+        file.write(reinterpret_cast<char const*>(&header), sizeof(Header));
+    }
+    Archive::Writer::~Writer() {
+        if (!finished and file.is_open()) {
+            // Unfinished archives have no table of contents; better none at all
+            file.close();
+            std::error_code error;
+            std::filesystem::remove(path, error);
+        }
+    }
+    Archive::Compression Archive::Writer::add(std::string const& name, std::span<uint8_t const> data, bool compress) {
+        if (entries.contains(name)) {
+            throw std::runtime_error(name + " is packed twice!");
+        }
+        std::vector<uint8_t> compressed;
+        Compression compression = Compression::None;
+        std::span<uint8_t const> blob = data;
+        if (compress and !data.empty()) {
+            compressed = lz4::compress(data);
+            if (compressed.size() <= data.size() - data.size() / 8) {
+                compression = Compression::LZ4;
+                blob = compressed;
+            }
+        }
+        uint64_t offset = static_cast<uint64_t>(file.tellp());
+        uint64_t padding = (alignment - offset % alignment) % alignment;
+        static constexpr char zeros[256] = {};
+        for (uint64_t written = 0; written < padding; written += sizeof(zeros)) {
+            file.write(zeros, static_cast<std::streamsize>(std::min<uint64_t>(sizeof(zeros), padding - written)));
+        }
+        offset += padding;
+        file.write(reinterpret_cast<char const*>(blob.data()), static_cast<std::streamsize>(blob.size()));
+        if (!file) {
+            throw std::runtime_error("failed to write " + path.string() + "!");
+        }
+        entries.emplace(name, Entry{ offset, blob.size(), data.size(), compression });
+        rawBytes += data.size();
+        storedBytes += blob.size();
+        return compression;
+    }
+    void Archive::Writer::finish() {
+        Header header{};
+        std::memcpy(header.magic, magic, sizeof(magic));
+        header.version = version;
+        header.alignment = alignment;
+        header.entryCount = static_cast<uint32_t>(entries.size());
+        header.tableOffset = static_cast<uint64_t>(file.tellp());
+        for (auto const& [name, entry] : entries) {
+            Record record{ entry.offset, entry.size, entry.rawSize, uint32_t(entry.compression), static_cast<uint32_t>(name.size()) };
+            file.write(reinterpret_cast<char const*>(&record), sizeof(Record));
+            file.write(name.data(), static_cast<std::streamsize>(name.size()));
+        }
+        header.tableSize = static_cast<uint64_t>(file.tellp()) - header.tableOffset;
+        file.seekp(0);
+        file.write(reinterpret_cast<char const*>(&header), sizeof(Header));
+        file.close();
+        if (!file) {
+            throw std::runtime_error("failed to write " + path.string() + "!");
+        }
+        finished = true;
+    }
+}
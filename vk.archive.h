@@ -0,0 +1,98 @@
+#pragma once
+#ifndef hArchive
+#define hArchive
+
+// Needs no Vulkan at all, so the packer can be built on its own
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace vk {
+    namespace lz4 {
+        // LZ4 block format, so entries can be checked against the reference tool; no frame header
+        std::vector<uint8_t> compress(std::span<uint8_t const> source);
+        // Throws std::runtime_error unless exactly destination.size() bytes come out
+        void decompress(std::span<uint8_t const> source, std::span<uint8_t> destination);
+    }
+
+    struct Archive
+    {// Assets packed into one file and mapped read-only; stored entries are read in place, straight from the mapping
+     // Layout: header, blobs each at alignment, table of contents at the end
+        Archive(std::filesystem::path const& path);
+        ~Archive();
+        Archive(Archive const&) = delete;
+        Archive& operator=(Archive const&) = delete;
+    public:
+        enum class Compression : uint32_t {
+            None,
+            LZ4
+        };
+        struct Entry {
+            uint64_t offset;        // From the start of the file; a multiple of the archive's alignment
+            uint64_t size;          // Stored
+            uint64_t rawSize;       // Once decompressed
+            Compression compression;
+        };
+        struct Writer
+        {// Blobs go out as they are added, the table of contents on finish()
+            Writer(std::filesystem::path const& path, uint32_t alignment = 256);
+            ~Writer();
+        public:
+            uint64_t rawBytes = 0;
+            uint64_t storedBytes = 0;
+
+            // LZ4 is kept only when it saves at least an eighth; returns how the entry was stored
+            Compression add(std::string const& name, std::span<uint8_t const> data, bool compress);
+            void finish();
+        private:
+            std::ofstream file;
+            std::filesystem::path path;
+            uint32_t alignment;
+            std::map<std::string, Entry> entries;
+            bool finished = false;
+        };
+        std::filesystem::path path;
+        uint32_t alignment;
+
+        Entry const* find(std::string_view name) const;
+        bool contains(std::string_view name) const { return find(name) != nullptr; }
+        std::vector<std::string> names() const;
+        // Stored bytes inside the mapping; only raw data for Compression::None
+        std::span<uint8_t const> stored(Entry const& entry) const;
+        // Raw bytes of a stored entry, in place; throws if the entry is compressed
+        std::span<uint8_t const> view(std::string_view name) const;
+        // Raw bytes: in place when stored, else decompressed into scratch
+        std::span<uint8_t const> contents(Entry const& entry, std::vector<uint8_t>& scratch) const;
+        // rawSize bytes to destination, decompressed if need be
+        void read(Entry const& entry, void* destination) const;
+        std::vector<uint8_t> read(std::string_view name) const;
+
+        // assets.vkpak in the working directory, or $VK_ASSETS, opened on first use; nullptr when there is none
+        static Archive const* mounted();
+        // Entry name of a path relative to the working directory, as the packer writes it
+        static std::string name(std::filesystem::path const& path);
+    private:
+        inline static constexpr char magic[8] = { 'V', 'K', 'P', 'A', 'K', '\r', '\n', '\x1a' };
+        inline static constexpr uint32_t version = 1;
+
+        uint8_t const* data = nullptr;
+        uint64_t size = 0;
+#ifdef _WIN32
+        void* file = nullptr;
+        void* mapping = nullptr;
+#else
+        int descriptor = -1;
+#endif
+        std::map<std::string, Entry, std::less<>> entries;
+
+        void unmap();
+        Entry const& at(std::string_view name) const;
+    };
+}
+
+#endif
@@ -0,0 +1,203 @@
+#include "vk.atlas.h"
+#include "vk.textures.h"
+
+#include <stb_image.h>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <format>
+
+namespace vk {
+    TextureAtlas::TextureAtlas(Bindless& bindless, uint32_t maxSide)
+        : maxSide(maxSide), bindless(bindless)
+    {
+        VkPhysicalDeviceProperties properties{};
+        vkGetPhysicalDeviceProperties(GPU::physicalDevice, &properties);
+
+        // Clamped, as the padding past a texture only repeats its edge
+        VkSamplerCreateInfo samplerInfo
+        { VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO };
+        samplerInfo.magFilter = VK_FILTER_LINEAR;
+        samplerInfo.minFilter = VK_FILTER_LINEAR;
+        samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.anisotropyEnable = VK_TRUE;
+        samplerInfo.maxAnisotropy = properties.limits.maxSamplerAnisotropy;
+        samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+        samplerInfo.unnormalizedCoordinates = VK_FALSE;
+        samplerInfo.compareEnable = VK_FALSE;
+        samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+        samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+        samplerInfo.minLod = 0.f;
+        samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+
+        VK_CHECK_RESULT(vkCreateSampler(GPU::device, &samplerInfo, nullptr, &Sampler));
+        sampler = bindless.addSampler(Sampler);
+    }
+    TextureAtlas::~TextureAtlas() {
+        for (std::unique_ptr<Array> const& array : arrays) {
+            bindless.release(Bindless::Images, array->slot);
+        }
+        bindless.release(Bindless::Samplers, sampler);
+        vkDestroySampler(GPU::device, Sampler, nullptr);
+    }
+    /* Public */
+    uint32_t TextureAtlas::add(std::string const& filename) {
+        int width, height, channels;
+        uint8_t* pixels = loadPixels(filename, width, height, channels);
+        if (!pixels) {
+            throw std::runtime_error("failed to load texture image " + filename + "!");
+        }
+        uint32_t index;
+        try {
+            index = add(pixels, static_cast<uint32_t>(width), static_cast<uint32_t>(height));
+        }
+        catch (...) {
+            stbi_image_free(pixels);
+            throw;
+        }
+        stbi_image_free(pixels);
+        return index;
+    }
+    uint32_t TextureAtlas::add(uint8_t const* pixels, uint32_t width, uint32_t height) {
+        if (width == 0 or height == 0 or width > maxSide or height > maxSide) {
+            throw std::runtime_error(std::format("a {}x{} texture does not fit an atlas layer of at most {}x{}!", width, height, maxSide, maxSide));
+        }
+        Size size{ std::bit_ceil(width), std::bit_ceil(height) };
+        Layer layer{ static_cast<uint32_t>(handles.size()), std::vector<uint8_t>(size_t(size.first) * size.second * 4) };
+        // Past the texture, every texel repeats the nearest edge one
+        for (uint32_t y = 0; y < size.second; y++) {
+            uint8_t const* row = pixels + size_t(std::min(y, height - 1)) * width * 4;
+            uint8_t* out = layer.pixels.data() + size_t(y) * size.first * 4;
+            memcpy(out, row, size_t(width) * 4);
+            for (uint32_t x = width; x < size.first; x++) {
+                memcpy(out + size_t(x) * 4, row + size_t(width - 1) * 4, 4);
+            }
+        }
+        auto unorm16 = [](uint32_t part, uint32_t whole) {
+            return static_cast<uint32_t>(std::lround(65535.0 * part / whole)); };
+        handles.push_back({ 0, unorm16(width, size.first) | (unorm16(height, size.second) << 16) });
+        pending[size].push_back(std::move(layer));
+
+        stats.textures++;
+        stats.padding += (VkDeviceSize(size.first) * size.second - VkDeviceSize(width) * height) * 4;
+        return static_cast<uint32_t>(handles.size() - 1);
+    }
+    void TextureAtlas::build()
+    {// An array per size, or several where a size has more textures than the device allows layers; each uploaded in one submission
+        VkPhysicalDeviceProperties properties{};
+        vkGetPhysicalDeviceProperties(GPU::physicalDevice, &properties);
+        uint32_t maxLayers = std::min(properties.limits.maxImageArrayLayers, 0x10000u);
+
+        for (auto& [size, layers] : pending) {
+            auto [width, height] = size;
+            for (size_t first = 0; first < layers.size(); first += maxLayers) {
+                uint32_t count = static_cast<uint32_t>(std::min<size_t>(maxLayers, layers.size() - first));
+
+                auto array = std::make_unique<Array>();
+                array->format = VK_FORMAT_R8G8B8A8_SRGB;
+                array->usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+                array->extent = { width, height };
+                array->layers = count;
+                array->viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+                array->mipLevels = static_cast<uint32_t>(std::bit_width(std::max(width, height)));
+                Image::createImage(*array, VK_SAMPLE_COUNT_1_BIT, array->mipLevels);
+
+                VkDeviceSize bytes = 0;
+                for (uint32_t level = 0; level < array->mipLevels; level++) {
+                    bytes += VkDeviceSize(std::max(width >> level, 1u)) * std::max(height >> level, 1u) * 4 * count;
+                }
+                StagingRing::Allocation staging = StagingRing::get().allocate(bytes);
+                std::vector<VkBufferImageCopy> regions;
+                VkDeviceSize offset = 0;
+                for (uint32_t i = 0; i < count; i++) {
+                    std::vector<uint8_t> pixels = std::move(layers[first + i].pixels);
+                    for (uint32_t level = 0; level < array->mipLevels; level++) {
+                        uint32_t levelWidth = std::max(width >> level, 1u);
+                        uint32_t levelHeight = std::max(height >> level, 1u);
+                        memcpy(static_cast<uint8_t*>(staging.data) + offset, pixels.data(), pixels.size());
+
+                        VkBufferImageCopy region{};
+                        region.bufferOffset = staging.offset + offset;
+                        region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, i, 1 };
+                        region.imageExtent = { levelWidth, levelHeight, 1 };
+                        regions.push_back(region);
+                        offset += pixels.size();
+
+                        if (level + 1 < array->mipLevels) {
+                            pixels = downsample(pixels, levelWidth, levelHeight);
+                        }
+                    }
+                }
+                array->upload(staging, regions);
+                Image::createImageView(*array, array->mipLevels);
+                array->slot = bindless.addImage(array->ImageView);
+
+                for (uint32_t i = 0; i < count; i++) {
+                    handles[layers[first + i].index].texture = array->slot | (i << 16);
+                }
+                stats.arrays++;
+                stats.bytes += bytes;
+                arrays.push_back(std::move(array));
+            }
+        }
+        pending.clear();
+    }
+    /* Private */
+    void TextureAtlas::Array::upload(StagingRing::Allocation const& staging, std::vector<VkBufferImageCopy> const& regions) {
+        VkImageMemoryBarrier barrier = createMemoryBarrier(Image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mipLevels);
+
+        beginCommand();
+        vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+            0, nullptr, 0, nullptr, 1, &barrier);
+        vkCmdCopyBufferToImage(cmdBuffer, staging.buffer, Image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            static_cast<uint32_t>(regions.size()), regions.data());
+        updateMemoryBarrier(barrier, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+            0, nullptr, 0, nullptr, 1, &barrier);
+        endCommand();
+    }
+    std::vector<uint8_t> TextureAtlas::downsample(std::vector<uint8_t> const& pixels, uint32_t width, uint32_t height) {
+        static std::array<float, 256> const linear = [] {
+            std::array<float, 256> table{};
+            for (uint32_t i = 0; i < 256; i++) {
+                float c = i / 255.f;
+                table[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+            }
+            return table;
+        }();
+        auto encode = [](float c) {
+            c = c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.f / 2.4f) - 0.055f;
+            return static_cast<uint8_t>(std::lround(std::clamp(c, 0.f, 1.f) * 255.f));
+        };
+        uint32_t nextWidth = std::max(width / 2, 1u);
+        uint32_t nextHeight = std::max(height / 2, 1u);
+        std::vector<uint8_t> next(size_t(nextWidth) * nextHeight * 4);
+        for (uint32_t y = 0; y < nextHeight; y++) {
+            for (uint32_t x = 0; x < nextWidth; x++) {
+                uint32_t xs[2] = { std::min(2 * x, width - 1), std::min(2 * x + 1, width - 1) };
+                uint32_t ys[2] = { std::min(2 * y, height - 1), std::min(2 * y + 1, height - 1) };
+                float sum[4]{};
+                for (uint32_t sy : ys) {
+                    for (uint32_t sx : xs) {
+                        uint8_t const* texel = pixels.data() + (size_t(sy) * width + sx) * 4;
+                        for (int c = 0; c < 3; c++) {
+                            sum[c] += linear[texel[c]];
+                        }
+                        sum[3] += texel[3] / 255.f;
+                    }
+                }
+                uint8_t* out = next.data() + (size_t(y) * nextWidth + x) * 4;
+                for (int c = 0; c < 3; c++) {
+                    out[c] = encode(sum[c] / 4.f);
+                }
+                out[3] = static_cast<uint8_t>(std::lround(sum[3] / 4.f * 255.f));
+            }
+        }
+        return next;
+    }
+}
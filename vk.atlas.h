@@ -0,0 +1,63 @@
+#pragma once
+#ifndef hAtlas
+#define hAtlas
+
+#include "vk.image.h"
+#include "vk.buffers.h"
+#include "vk.bindless.h"
+
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+
+namespace vk {
+    struct TextureAtlas
+    {// Many small RGBA8 textures in a few 2D array images, one per power-of-two size, shared through Bindless in place of
+     // an image, view, pool and set each. Every texture has a layer to itself, in its corner, with its edge texels repeated
+     // over the rest, so neither filtering nor any mip level reaches a neighbour. Shaders sample a Handle with atlas.glsl
+        TextureAtlas(Bindless& bindless, uint32_t maxSide = 1024);
+        ~TextureAtlas();
+        TextureAtlas(TextureAtlas const&) = delete;
+        TextureAtlas& operator=(TextureAtlas const&) = delete;
+    public:
+        struct Handle {
+            uint32_t texture;   // Bindless image slot in the low half, layer in the high
+            uint32_t scale;     // The texture's share of its layer in u and v, packUnorm2x16; multiplies its UVs
+        };
+        struct Stats {
+            uint32_t textures = 0;
+            uint32_t arrays = 0;        // Images, views and descriptors for all of them
+            VkDeviceSize bytes = 0;     // Uploaded, over every level
+            VkDeviceSize padding = 0;   // Repeated edges at level 0
+        } stats;
+        uint32_t const maxSide;         // Larger textures belong in a Texture of their own
+        uint32_t sampler;               // Bindless sampler slot: trilinear, anisotropic, clamped to the edge
+
+        // Textures wait in system memory until build(); the index returned reads their handle after it
+        uint32_t add(std::string const& filename);
+        uint32_t add(uint8_t const* pixels, uint32_t width, uint32_t height);
+        void build();
+        Handle operator[](uint32_t index) const { return handles.at(index); }
+    private:
+        using Size = std::pair<uint32_t, uint32_t>;     // Of a layer: the texture's size rounded up to powers of two
+        struct Layer {
+            uint32_t index;                 // Into handles
+            std::vector<uint8_t> pixels;    // Level 0, padded
+        };
+        struct Array : Image, Command {
+            uint32_t slot = 0;
+            void upload(StagingRing::Allocation const& staging, std::vector<VkBufferImageCopy> const& regions);
+        };
+        Bindless& bindless;
+        VkSampler Sampler;
+        std::vector<Handle> handles;
+        std::map<Size, std::vector<Layer>> pending;
+        std::vector<std::unique_ptr<Array>> arrays;
+
+        // sRGB-correct 2x2 average, down to 1 in either direction
+        static std::vector<uint8_t> downsample(std::vector<uint8_t> const& pixels, uint32_t width, uint32_t height);
+    };
+}
+
+#endif
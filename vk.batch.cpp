@@ -0,0 +1,133 @@
+#include "vk.batch.h"
+
+namespace vk {
+    /* Mesh Arena */
+    MeshArena::MeshArena(VkDeviceSize vertexStride, uint32_t vertexCapacity, uint32_t indexCapacity)
+        : stride(vertexStride), vertexCapacity(vertexCapacity), indexCapacity(indexCapacity)
+    {
+        VBO = new Buffer(vertexCapacity * vertexStride, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        EBO = new Buffer(indexCapacity * sizeof(uint16_t), VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    }
+    MeshArena::~MeshArena() {
+        delete VBO;
+        delete EBO;
+    }
+    void MeshArena::bind(VkCommandBuffer& commandBuffer) {
+        VkDeviceSize offsets[] = { 0 };
+        RenderState::bindVertexBuffers(commandBuffer, 1, &VBO->buffer, offsets);
+        RenderState::bindIndexBuffer(commandBuffer, EBO->buffer, VK_INDEX_TYPE_UINT16);
+    }
+
+    /* Instance Batch */
+    InstanceBatch::InstanceBatch(MeshArena& arena, uint32_t maxInstances, Bindless& bindless)
+        : arena(arena), bindless(bindless), maxInstances(maxInstances), stale(MAX_FRAMES_IN_FLIGHT, true)
+    {
+        instanceBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+        instanceHandles.resize(MAX_FRAMES_IN_FLIGHT);
+        drawBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+        instanceData.resize(MAX_FRAMES_IN_FLIGHT);
+        drawData.resize(MAX_FRAMES_IN_FLIGHT);
+        // Host-visible so a changed transform costs a memcpy, not a staging submit
+        for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+            instanceBuffers[i] = new Buffer(maxInstances * sizeof(Instance), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+            drawBuffers[i] = new Buffer(maxInstances * sizeof(VkDrawIndexedIndirectCommand), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+            VK_CHECK_RESULT(vkMapMemory(GPU::device, instanceBuffers[i]->memory, 0, instanceBuffers[i]->size, 0, &instanceData[i]));
+            VK_CHECK_RESULT(vkMapMemory(GPU::device, drawBuffers[i]->memory, 0, drawBuffers[i]->size, 0, &drawData[i]));
+            instanceHandles[i] = bindless.addBuffer(instanceBuffers[i]->buffer);
+        }
+    }
+    InstanceBatch::~InstanceBatch() {
+        for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+            bindless.release(Bindless::Buffers, instanceHandles[i]);
+            vkUnmapMemory(GPU::device, instanceBuffers[i]->memory);
+            vkUnmapMemory(GPU::device, drawBuffers[i]->memory);
+            delete instanceBuffers[i];
+            delete drawBuffers[i];
+        }
+    }
+    /* Public */
+    uint32_t InstanceBatch::add(MeshArena::Range const& mesh, glm::mat4 const& model) {
+        if (transforms.size() == maxInstances) {
+            throw std::runtime_error("InstanceBatch: instance capacity exceeded!");
+        }
+        auto slot = std::find_if(meshes.begin(), meshes.end(), [&](MeshArena::Range const& range) { return range.firstIndex == mesh.firstIndex; });
+        if (slot == meshes.end()) {
+            slot = meshes.insert(meshes.end(), mesh);
+        }
+        instanceMesh.push_back(static_cast<uint32_t>(slot - meshes.begin()));
+        transforms.push_back(model);
+        textures.push_back({});
+        std::fill(stale.begin(), stale.end(), true);
+        return static_cast<uint32_t>(transforms.size() - 1);
+    }
+    void InstanceBatch::move(uint32_t instance, glm::mat4 const& model) {
+        transforms[instance] = model;
+        std::fill(stale.begin(), stale.end(), true);
+    }
+    void InstanceBatch::texture(uint32_t instance, TextureAtlas::Handle handle) {
+        textures[instance] = handle;
+        std::fill(stale.begin(), stale.end(), true);
+    }
+    void InstanceBatch::update(uint32_t frame) {
+        if (stale[frame]) {
+            rebuild(frame);
+        }
+    }
+    void InstanceBatch::draw(uint32_t instanceCount) {
+        VkCommandBuffer& commandBuffer = EngineCPU::renderCommands[SwapChain::currentFrame];
+        update(SwapChain::currentFrame);
+        if (meshes.empty()) {
+            return;
+        }
+        // The bindless set stays bound across batches; only this frame's instance buffer handle and the sampler change
+        Bindless::push(commandBuffer, RenderState::layout, { instanceHandles[SwapChain::currentFrame], sampler });
+        arena.bind(commandBuffer);
+
+        if (!indirect.empty()) {
+            IndirectDraw& draws = indirect[SwapChain::currentFrame];
+            vkCmdDrawIndexedIndirectCount(commandBuffer, draws.commands, 0, draws.count, 0, draws.maxDraws, sizeof(VkDrawIndexedIndirectCommand));
+            return;
+        }
+        if (!GPU::multiDrawIndirect) {
+            // The commands rebuild wrote are host-visible, so they are read back and issued one at a time
+            VkDrawIndexedIndirectCommand const* draws = static_cast<VkDrawIndexedIndirectCommand const*>(drawData[SwapChain::currentFrame]);
+            for (uint32_t m = 0; m < drawCount(); m++) {
+                if (draws[m].instanceCount > 0) {
+                    vkCmdDrawIndexed(commandBuffer, draws[m].indexCount, draws[m].instanceCount, draws[m].firstIndex, draws[m].vertexOffset, draws[m].firstInstance);
+                }
+            }
+            return;
+        }
+        vkCmdDrawIndexedIndirect(commandBuffer, drawBuffers[SwapChain::currentFrame]->buffer, 0, drawCount(), sizeof(VkDrawIndexedIndirectCommand));
+    }
+    /* Protected */
+    void InstanceBatch::rebuild(uint32_t frame)
+    {// Counting sort by mesh so each indirect command covers a contiguous firstInstance range
+        std::vector<uint32_t> first(meshes.size() + 1, 0);
+        for (uint32_t mesh : instanceMesh) {
+            first[mesh + 1]++;
+        }
+        std::partial_sum(first.begin(), first.end(), first.begin());
+
+        Instance* instances = static_cast<Instance*>(instanceData[frame]);
+        std::vector<uint32_t> cursor(first.begin(), first.end() - 1);
+        for (uint32_t i = 0; i < transforms.size(); i++) {
+            MeshArena::Range const& mesh = meshes[instanceMesh[i]];
+            glm::mat4 const& model = transforms[i];
+            float scale = std::max(std::max(glm::length(glm::vec3(model[0])), glm::length(glm::vec3(model[1]))), glm::length(glm::vec3(model[2])));
+            instances[cursor[instanceMesh[i]]++] = { model, glm::vec4(glm::vec3(model * glm::vec4(glm::vec3(mesh.bounds), 1.f)), mesh.bounds.w * scale), instanceMesh[i], textures[i] };
+        }
+
+        VkDrawIndexedIndirectCommand* draws = static_cast<VkDrawIndexedIndirectCommand*>(drawData[frame]);
+        for (uint32_t m = 0; m < meshes.size(); m++) {
+            draws[m].indexCount = meshes[m].indexCount;
+            draws[m].instanceCount = first[m + 1] - first[m];
+            draws[m].firstIndex = meshes[m].firstIndex;
+            draws[m].vertexOffset = meshes[m].vertexOffset;
+            draws[m].firstInstance = first[m];
+        }
+        stale[frame] = false;
+    }
+}
@@ -0,0 +1,129 @@
+#pragma once
+#ifndef hBatch
+#define hBatch
+
+#include "vk.buffers.h"
+#include "vk.bindless.h"
+#include "vk.atlas.h"
+#include "vk.pipeline.h"
+
+#include "Mesh.h"
+#include "MeshOptimizer.h"
+
+namespace vk {
+    struct MeshArena
+    {// Shared vertex/index buffers; each added mesh is a sub-range addressed by firstIndex and vertexOffset
+        MeshArena(VkDeviceSize vertexStride, uint32_t vertexCapacity, uint32_t indexCapacity);
+        ~MeshArena();
+    public:
+        struct Range {
+            uint32_t firstIndex;
+            uint32_t indexCount;
+            int32_t vertexOffset;
+            uint32_t vertexCount;
+            glm::vec4 bounds;   // Object-space center (xyz) and radius (w)
+        };
+        Buffer* VBO;
+        Buffer* EBO;
+        VkDeviceSize sourceBytes = 0;   // What the added vertices would take in the type they were added as
+        VkDeviceSize storedBytes = 0;
+        // Stored as P, a PackedPrimitive the arena's stride was made for, or as given without one
+        template<typename P = void, typename T, typename U>
+        inline Range add(std::vector<T> vertices, std::vector<U> indices);
+        void bind(VkCommandBuffer& commandBuffer);
+    private:
+        VkDeviceSize stride;
+        uint32_t vertexCapacity, indexCapacity;
+        uint32_t vertexTop = 0, indexTop = 0;
+    };
+
+    struct InstanceBatch : Drawable
+    {// Per-instance transforms in one SSBO and one indirect command per arena mesh, drawn with a single multi-draw
+        InstanceBatch(MeshArena& arena, uint32_t maxInstances, Bindless& bindless);
+        ~InstanceBatch();
+    public:
+        struct Instance {
+            glm::mat4 model;
+            glm::vec4 bounds;   // World-space center (xyz) and radius (w)
+            uint32_t mesh;      // Slot of the mesh's indirect command
+            TextureAtlas::Handle texture;       // Zero for none, drawn in vertex colors
+            uint32_t padding;
+        };
+        std::vector<IndirectDraw> indirect;     // Per frame in flight, written by an InstanceCuller; empty draws every instance
+        uint32_t sampler = 0;   // Bindless sampler slot textured instances are read with, their atlas's
+
+        uint32_t add(MeshArena::Range const& mesh, glm::mat4 const& model);
+        void move(uint32_t instance, glm::mat4 const& model);
+        void texture(uint32_t instance, TextureAtlas::Handle handle);   // Sampled by batched.frag through atlas.glsl
+        void update(uint32_t frame);
+        void draw(uint32_t instanceCount = 1) override;
+        uint32_t instanceCount() const { return static_cast<uint32_t>(transforms.size()); }
+        uint32_t drawCount() const { return static_cast<uint32_t>(meshes.size()); }
+    protected:
+        friend struct InstanceCuller;
+        MeshArena& arena;
+        Bindless& bindless;
+        uint32_t maxInstances;
+        std::vector<MeshArena::Range> meshes;   // Distinct arena meshes, one indirect command each
+        std::vector<uint32_t> instanceMesh;     // instance -> mesh slot
+        std::vector<glm::mat4> transforms;      // instance -> model matrix
+        std::vector<TextureAtlas::Handle> textures;     // instance -> atlas handle
+        std::vector<bool> stale;                // Frames whose buffers predate the last change
+
+        std::vector<Buffer*> instanceBuffers;
+        std::vector<Buffer*> drawBuffers;
+        std::vector<void*> instanceData;
+        std::vector<void*> drawData;
+        std::vector<uint32_t> instanceHandles;  // Bindless buffer slot of each frame's instance SSBO
+
+        void rebuild(uint32_t frame);
+    };
+
+    template<typename P, typename T, typename U>
+    inline MeshArena::Range MeshArena::add(std::vector<T> vertices, std::vector<U> indices) {
+        using Stored = std::conditional_t<std::is_void_v<P>, T, P>;
+        static_assert(std::is_same_v<U, uint16_t>, "MeshArena draws with VK_INDEX_TYPE_UINT16");
+        if (sizeof(Stored) != stride) {
+            throw std::runtime_error("MeshArena: vertex type does not match the arena stride!");
+        }
+        if (vertexTop + vertices.size() > vertexCapacity or indexTop + indices.size() > indexCapacity) {
+            throw std::runtime_error("MeshArena: out of space!");
+        }
+        Optimizer::optimize(vertices, indices);
+
+        glm::vec3 center(0.f);
+        for (auto const& vertex : vertices) {
+            center += glm::vec3(vertex.position);
+        }
+        center /= static_cast<float>(std::max<size_t>(vertices.size(), 1));
+        float radius = 0.f;
+        for (auto const& vertex : vertices) {
+            radius = std::max(radius, glm::distance(center, glm::vec3(vertex.position)));
+        }
+
+        Range range{ indexTop, static_cast<uint32_t>(indices.size()), static_cast<int32_t>(vertexTop), static_cast<uint32_t>(vertices.size()), glm::vec4(center, radius) };
+
+        std::vector<Stored> stored;
+        if constexpr (std::is_same_v<Stored, T>) {
+            stored = std::move(vertices);
+        }
+        else {
+            // Instances supply the only transform, so there is no mesh matrix to fold a quantization into
+            static_assert(!Stored::quantized, "MeshArena stores positions as floats or half floats");
+            stored = Stored::encode(vertices, Stored::quantize(vertices));
+        }
+        sourceBytes += range.vertexCount * sizeof(T);
+        storedBytes += range.vertexCount * sizeof(Stored);
+
+        StageBuffer stageVBO(stored.data(), stored.size() * sizeof(Stored));
+        StageBuffer stageEBO(indices.data(), indices.size() * sizeof(U));
+        stageVBO.transferData(VBO->buffer, vertexTop * stride);
+        stageEBO.transferData(EBO->buffer, indexTop * sizeof(U));
+
+        vertexTop += range.vertexCount;
+        indexTop += range.indexCount;
+        return range;
+    }
+}
+
+#endif
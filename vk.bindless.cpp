@@ -0,0 +1,121 @@
+#include "vk.bindless.h"
+
+namespace vk {
+    Bindless::Bindless(uint32_t imageCapacity, uint32_t samplerCapacity, uint32_t bufferCapacity) {
+        VkPhysicalDeviceDescriptorIndexingProperties indexing
+        { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES };
+        VkPhysicalDeviceProperties2 properties
+        { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2 };
+        properties.pNext = &indexing;
+        vkGetPhysicalDeviceProperties2(GPU::physicalDevice, &properties);
+
+        capacity[Images] = std::min(imageCapacity, indexing.maxDescriptorSetUpdateAfterBindSampledImages);
+        capacity[Samplers] = std::min(samplerCapacity, indexing.maxDescriptorSetUpdateAfterBindSamplers);
+        capacity[Buffers] = std::min(bufferCapacity, indexing.maxDescriptorSetUpdateAfterBindStorageBuffers);
+
+        std::array<VkDescriptorSetLayoutBinding, BindingCount> layoutBindings{};
+        std::array<VkDescriptorBindingFlags, BindingCount> bindingFlags{};
+        std::array<VkDescriptorPoolSize, BindingCount> poolSizes{};
+        for (uint32_t i = 0; i < BindingCount; i++) {
+            layoutBindings[i].binding = i;
+            layoutBindings[i].descriptorCount = capacity[i];
+            layoutBindings[i].descriptorType = descriptorType(Binding(i));
+            layoutBindings[i].stageFlags = VK_SHADER_STAGE_ALL;
+            // Unused slots stay unwritten; slots a pending frame does not read may be rewritten
+            bindingFlags[i] = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+            poolSizes[i] = { layoutBindings[i].descriptorType, capacity[i] };
+        }
+
+        VkDescriptorSetLayoutBindingFlagsCreateInfo flagsInfo
+        { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO };
+        flagsInfo.bindingCount = BindingCount;
+        flagsInfo.pBindingFlags = bindingFlags.data();
+
+        VkDescriptorSetLayoutCreateInfo layoutInfo
+        { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO };
+        layoutInfo.pNext = &flagsInfo;
+        layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+        layoutInfo.bindingCount = BindingCount;
+        layoutInfo.pBindings = layoutBindings.data();
+        VK_CHECK_RESULT(vkCreateDescriptorSetLayout(GPU::device, &layoutInfo, nullptr, &SetLayout));
+
+        VkDescriptorPoolCreateInfo poolInfo
+        { VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO };
+        poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+        poolInfo.poolSizeCount = BindingCount;
+        poolInfo.pPoolSizes = poolSizes.data();
+        poolInfo.maxSets = 1;
+        VK_CHECK_RESULT(vkCreateDescriptorPool(GPU::device, &poolInfo, nullptr, &Pool));
+
+        VkDescriptorSetAllocateInfo allocInfo
+        { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO };
+        allocInfo.descriptorPool = Pool;
+        allocInfo.descriptorSetCount = 1;
+        allocInfo.pSetLayouts = &SetLayout;
+        VK_CHECK_RESULT(vkAllocateDescriptorSets(GPU::device, &allocInfo, &Set));
+    }
+    Bindless::~Bindless() {
+        vkDestroyDescriptorPool(GPU::device, Pool, nullptr);
+        vkDestroyDescriptorSetLayout(GPU::device, SetLayout, nullptr);
+    }
+    /* Public */
+    uint32_t Bindless::addImage(VkImageView view, VkImageLayout layout) {
+        uint32_t slot = allocate(Images);
+        VkDescriptorImageInfo imageInfo{ VK_NULL_HANDLE, view, layout };
+        write(Images, slot, &imageInfo, nullptr);
+        return slot;
+    }
+    uint32_t Bindless::addSampler(VkSampler sampler) {
+        uint32_t slot = allocate(Samplers);
+        VkDescriptorImageInfo imageInfo{ sampler, VK_NULL_HANDLE, VK_IMAGE_LAYOUT_UNDEFINED };
+        write(Samplers, slot, &imageInfo, nullptr);
+        return slot;
+    }
+    uint32_t Bindless::addBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range) {
+        uint32_t slot = allocate(Buffers);
+        VkDescriptorBufferInfo bufferInfo{ buffer, offset, range };
+        write(Buffers, slot, nullptr, &bufferInfo);
+        return slot;
+    }
+    void Bindless::release(Binding binding, uint32_t handle)
+    {// The caller guarantees no frame in flight still indexes the handle, as with destroying the resource itself
+        freed[binding].push_back(handle);
+    }
+    void Bindless::push(VkCommandBuffer& commandBuffer, VkPipelineLayout layout, Handles const& handles) {
+        vkCmdPushConstants(commandBuffer, layout, pushRange.stageFlags, pushRange.offset, pushRange.size, &handles);
+    }
+    /* Private */
+    uint32_t Bindless::allocate(Binding binding) {
+        if (!freed[binding].empty()) {
+            uint32_t slot = freed[binding].back();
+            freed[binding].pop_back();
+            return slot;
+        }
+        if (top[binding] == capacity[binding]) {
+            throw std::runtime_error("Bindless: descriptor table is full!");
+        }
+        return top[binding]++;
+    }
+    void Bindless::write(Binding binding, uint32_t slot, VkDescriptorImageInfo const* imageInfo, VkDescriptorBufferInfo const* bufferInfo) {
+        VkWriteDescriptorSet descriptorWrite
+        { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET };
+        descriptorWrite.dstSet = Set;
+        descriptorWrite.dstBinding = binding;
+        descriptorWrite.dstArrayElement = slot;
+        descriptorWrite.descriptorCount = 1;
+        descriptorWrite.descriptorType = descriptorType(binding);
+        descriptorWrite.pImageInfo = imageInfo;
+        descriptorWrite.pBufferInfo = bufferInfo;
+        vkUpdateDescriptorSets(GPU::device, 1, &descriptorWrite, 0, nullptr);
+    }
+    VkDescriptorType Bindless::descriptorType(Binding binding) {
+        switch (binding) {
+        case Images:
+            return VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+        case Samplers:
+            return VK_DESCRIPTOR_TYPE_SAMPLER;
+        default:
+            return VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        }
+    }
+}
@@ -0,0 +1,46 @@
+#pragma once
+#ifndef hBindless
+#define hBindless
+
+#include "vk.gpu.h"
+
+#include <array>
+
+namespace vk {
+    struct Bindless
+    {// One update-after-bind set of partially bound resource arrays shared by every pipeline; shaders index it with handles pushed per draw
+        Bindless(uint32_t imageCapacity = 4096, uint32_t samplerCapacity = 64, uint32_t bufferCapacity = 1024);
+        ~Bindless();
+    public:
+        enum Binding : uint32_t {
+            Images,     // VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, textures[]
+            Samplers,   // VK_DESCRIPTOR_TYPE_SAMPLER, samplers[]
+            Buffers,    // VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, buffers[]
+            BindingCount
+        };
+        struct Handles {
+            uint32_t slots[4];  // Meaning is up to the shader; four uints fit every push constant budget
+        };
+        inline static VkPushConstantRange pushRange{ VK_SHADER_STAGE_ALL, 0, sizeof(Handles) };
+
+        VkDescriptorSetLayout SetLayout = VK_NULL_HANDLE;
+        VkDescriptorSet Set = VK_NULL_HANDLE;
+
+        uint32_t addImage(VkImageView view, VkImageLayout layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        uint32_t addSampler(VkSampler sampler);
+        uint32_t addBuffer(VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE);
+        void release(Binding binding, uint32_t handle);
+        static void push(VkCommandBuffer& commandBuffer, VkPipelineLayout layout, Handles const& handles);
+    private:
+        VkDescriptorPool Pool = VK_NULL_HANDLE;
+        std::array<uint32_t, BindingCount> capacity{};
+        std::array<uint32_t, BindingCount> top{};                   // Slots ever handed out
+        std::array<std::vector<uint32_t>, BindingCount> freed;      // Released slots, reused first
+
+        uint32_t allocate(Binding binding);
+        void write(Binding binding, uint32_t slot, VkDescriptorImageInfo const* imageInfo, VkDescriptorBufferInfo const* bufferInfo);
+        static VkDescriptorType descriptorType(Binding binding);
+    };
+}
+
+#endif
@@ -1,4 +1,9 @@
 #include "vk.buffers.h"
+
+#include <bit>
+#include <chrono>
+#include <format>
+
 namespace vk {
     void createBuffer(VkBuffer& buffer, VkDeviceSize& size, VkBufferUsageFlags usage) {
         VkBufferCreateInfo bufferInfo
@@ -55,10 +60,22 @@ namespace vk {
         memcpy(data, content, static_cast<size_t>(size));
         transferData(dstBuffer);
     }
-    void StageBuffer::transferData(VkBuffer& dstBuffer) {
+    void StageBuffer::update(const void* content, VkBuffer& dstBuffer, std::vector<VkBufferCopy> const& regions) {
+        if (regions.empty()) {
+            return;
+        }
+        for (VkBufferCopy const& region : regions) {
+            memcpy(static_cast<char*>(data) + region.srcOffset, static_cast<char const*>(content) + region.srcOffset, static_cast<size_t>(region.size));
+        }
+        beginCommand();
+        vkCmdCopyBuffer(Command::cmdBuffer, buffer, dstBuffer, static_cast<uint32_t>(regions.size()), regions.data());
+        endCommand();
+    }
+    void StageBuffer::transferData(VkBuffer& dstBuffer, VkDeviceSize dstOffset) {
         beginCommand();
 
         VkBufferCopy copyRegion{};
+        copyRegion.dstOffset = dstOffset;
         copyRegion.size = size;
         vkCmdCopyBuffer(Command::cmdBuffer, buffer, dstBuffer, 1, &copyRegion);
 
@@ -83,6 +100,111 @@ namespace vk {
         endCommand();
     }
 
+    /* Staging Ring */
+    StagingRing::StagingRing(VkDeviceSize capacity) : capacity(capacity) {
+        create();
+    }
+    StagingRing::~StagingRing() {
+        vkUnmapMemory(GPU::device, buffer->memory);
+        delete buffer;
+    }
+    /* Public */
+    StagingRing::Allocation StagingRing::allocate(VkDeviceSize size, VkDeviceSize alignment) {
+        VkDeviceSize offset = (head + alignment - 1) / alignment * alignment;
+        if (offset + size > capacity) {
+            offset = 0;
+            if (size > capacity) {
+                vkUnmapMemory(GPU::device, buffer->memory);
+                delete buffer;
+                capacity = std::bit_ceil(size);
+                create();
+            }
+        }
+        head = offset + size;
+        return { buffer->buffer, offset, static_cast<uint8_t*>(data) + offset };
+    }
+    StagingRing::Allocation StagingRing::stage(Archive const& archive, Archive::Entry const& entry, VkDeviceSize alignment) {
+        Allocation allocation = allocate(entry.rawSize, alignment);
+        if (entry.compression == Archive::Compression::None) {
+            archive.read(entry, allocation.data);
+        }
+        else {
+            std::vector<uint8_t> decoded(static_cast<size_t>(entry.rawSize));
+            archive.read(entry, decoded.data());
+            memcpy(allocation.data, decoded.data(), decoded.size());
+        }
+        return allocation;
+    }
+    StagingRing& StagingRing::get() {
+        if (!shared) {
+            shared = new StagingRing(64 << 20);
+        }
+        return *shared;
+    }
+    void StagingRing::destroy() {
+        delete shared;
+        shared = nullptr;
+    }
+    void StagingRing::benchmark(std::filesystem::path const& path)
+    {// Cold is each way's first pass in this process: its page faults and reads, though the OS file cache may be warm already
+        Archive archive(path);
+        std::vector<std::string> names = archive.names();
+        if (names.empty()) {
+            throw std::runtime_error(std::format("No entries to benchmark in {}!", path.string()));
+        }
+        using clock = std::chrono::steady_clock;
+        auto milliseconds = [](clock::time_point start) {
+            return std::chrono::duration<double, std::milli>(clock::now() - start).count(); };
+
+        StagingRing& ring = get();
+        VkDeviceSize bytes = 0;
+        auto packed = [&]() {
+            auto start = clock::now();
+            for (std::string const& name : names) {
+                ring.stage(archive, *archive.find(name));
+            }
+            return milliseconds(start);
+        };
+        // The way shaders and textures were read before: a vector per file, then a StageBuffer per vector
+        size_t looseFiles = 0;
+        auto loose = [&]() {
+            auto start = clock::now();
+            looseFiles = 0;
+            for (std::string const& name : names) {
+                std::ifstream file(name, std::ios::ate | std::ios::binary);
+                if (!file.is_open()) {
+                    continue;
+                }
+                std::vector<char> content(static_cast<size_t>(file.tellg()));
+                file.seekg(0);
+                file.read(content.data(), content.size());
+                if (!content.empty()) {
+                    StageBuffer stage(content.data(), content.size());
+                }
+                looseFiles++;
+            }
+            return milliseconds(start);
+        };
+        for (std::string const& name : names) {
+            bytes += archive.find(name)->rawSize;
+        }
+        double packedCold = packed(), packedWarm = packed();
+        double looseCold = loose(), looseWarm = loose();
+
+        std::cout << std::format("Asset staging, {} entries ({:.1f} MiB) in {}\n", names.size(), bytes / double(1 << 20), path.string());
+        std::cout << "                                  cold         warm\n";
+        std::cout << std::format("  archive to staging ring:  {:9.1f} ms {:9.1f} ms\n", packedCold, packedWarm);
+        if (looseFiles) {
+            std::cout << std::format("  loose files, StageBuffer: {:9.1f} ms {:9.1f} ms  ({} of the files found loose)\n", looseCold, looseWarm, looseFiles);
+        }
+    }
+    /* Private */
+    void StagingRing::create() {
+        buffer = new Buffer(capacity, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        VK_CHECK_RESULT(vkMapMemory(GPU::device, buffer->memory, 0, VK_WHOLE_SIZE, 0, &data));
+        head = 0;
+    }
+
     /* Multi-Buffer */
     Buffer_::Buffer_(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties) {
         this->size = size;
@@ -2,6 +2,8 @@
 #define hBuffers
 
 #include "vk.cpu.h"
+#include "vk.archive.h"
+#include <filesystem>
 #include <utility>
 
 namespace vk {
@@ -25,13 +27,47 @@ namespace vk {
         VkBuffer buffer;
         VkDeviceSize size;
         void update(const void* content, VkBuffer& dstBuffer);
-        void transferData(VkBuffer& dstBuffer);
+        // Only the given byte ranges, at the same offsets in content, staging and dstBuffer, in one copy
+        void update(const void* content, VkBuffer& dstBuffer, std::vector<VkBufferCopy> const& regions);
+        void transferData(VkBuffer& dstBuffer, VkDeviceSize dstOffset = 0);
         void transferImage(VkImage& dstImage, VkExtent3D imageExtent);
     protected:
         void* data;
         VkDeviceMemory memory;
     };
 
+    /* Staging Ring */
+    struct StagingRing
+    {// One persistently mapped upload buffer shared by one-shot transfers, in place of a StageBuffer each
+     // Space is handed out in order and reused on wrap; that is safe while its users end in a blocking endCommand
+        StagingRing(VkDeviceSize capacity);
+        ~StagingRing();
+    public:
+        struct Allocation {
+            VkBuffer buffer;
+            VkDeviceSize offset;
+            void* data;
+        };
+        VkDeviceSize capacity;
+
+        // Grows, and invalidates earlier allocations, if size is more than the whole ring
+        Allocation allocate(VkDeviceSize size, VkDeviceSize alignment = 16);
+        // Stored entries are copied straight from the mapping; compressed ones decode to system memory first,
+        // as LZ4 reads back what it writes and the ring may be write-combined
+        Allocation stage(Archive const& archive, Archive::Entry const& entry, VkDeviceSize alignment = 16);
+        static StagingRing& get();  // Made on first use
+        static void destroy();
+        // Every entry of an archive staged cold then warm, from the mapping and from loose files through StageBuffer
+        static void benchmark(std::filesystem::path const& archive);
+    private:
+        Buffer* buffer = nullptr;
+        void* data = nullptr;
+        VkDeviceSize head = 0;
+        inline static StagingRing* shared = nullptr;
+
+        void create();
+    };
+
     /* Multi-Buffer */
     struct Buffer_ {
         Buffer_(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties);
@@ -1,35 +1,204 @@
 #include "vk.compute.h"
 
+#include <array>
+#include <cstdio>
+#include <format>
+#include <fstream>
+
 namespace vk {
-    ComputePPL::ComputePPL(Shader const& computeShader, std::vector<VkDescriptorSet>& descSets, std::vector<VkDescriptorSetLayout>& setLayouts, Workgroup workgroups)
-        :workgroup(workgroups)
+    /* Compute Variants */
+    VkPipeline ComputeVariants::get(Shader const& shader, VkPipelineLayout layout, Specialization const& constants) {
+        std::vector<uint32_t> ids;
+        for (VkSpecializationMapEntry const& entry : constants.entries) {
+            ids.push_back(entry.constantID);
+        }
+        Key key{ shader.shaderModule, layout, std::move(ids), constants.data };
+        if (auto cached = pipelines.find(key); cached != pipelines.end()) {
+            hits++;
+            return cached->second;
+        }
+        VkSpecializationInfo specializationInfo = constants.info();
+
+        VkPipelineShaderStageCreateInfo stageInfo
+        { VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO };
+        stageInfo.module = shader.shaderModule;
+        stageInfo.stage = shader.shaderStage;
+        stageInfo.pName = "main";
+        stageInfo.pSpecializationInfo = constants.empty() ? nullptr : &specializationInfo;
+
+        VkComputePipelineCreateInfo pipelineInfo
+        { VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO };
+        pipelineInfo.layout = layout;
+        pipelineInfo.stage = stageInfo;
+
+        VkPipeline pipeline;
+        VK_CHECK_RESULT(vkCreateComputePipelines(GPU::device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline));
+        return pipelines[key] = pipeline;
+    }
+    void ComputeVariants::destroy() {
+        for (auto& [key, pipeline] : pipelines) {
+            vkDestroyPipeline(GPU::device, pipeline, nullptr);
+        }
+        pipelines.clear();
+    }
+
+    /* Compute Pipeline */
+    ComputePPL::ComputePPL(Shader const& computeShader, std::vector<VkDescriptorSet>& descSets, std::vector<VkDescriptorSetLayout>& setLayouts, Workgroup workgroups, Specialization const& specialization)
+        : workgroup(workgroups), shader(computeShader), constants(specialization.empty() ? computeShader.specialization : specialization)
     {
         bindPoint = VK_PIPELINE_BIND_POINT_COMPUTE;
         sets = descSets;
+        this->setLayouts = setLayouts;
         vkLoadSetLayout(setLayouts, layout);
-        vkCreatePipeline(computeShader);
+        pipeline = ComputeVariants::get(shader, layout, constants);
+    }
+    ComputePPL::~ComputePPL() {
+        // Owned by ComputeVariants, not by Pipeline
+        pipeline = VK_NULL_HANDLE;
     }
 
+    void ComputePPL::specialize(Workgroup localSize) {
+        constants.set(0, localSize.x);
+        constants.set(1, localSize.y);
+        constants.set(2, localSize.z);
+        pipeline = ComputeVariants::get(shader, layout, constants);
+    }
     void ComputePPL::dispatch() {
         VkCommandBuffer& commandBuffer = EngineCPU::computeCommands[SwapChain::currentFrame];
 
         vkCmdBindPipeline(commandBuffer, bindPoint, pipeline);
-        vkCmdBindDescriptorSets(commandBuffer, bindPoint, layout, 0, static_cast<uint32_t>(sets.size()), sets.data(), 0, nullptr);
+        std::vector<VkDescriptorSet> const& bound = currentSets();
+        vkCmdBindDescriptorSets(commandBuffer, bindPoint, layout, 0, static_cast<uint32_t>(bound.size()), bound.data(), 0, nullptr);
         vkCmdDispatch(commandBuffer, workgroup.x, workgroup.y, workgroup.z);
     }
+    void ComputePPL::tune(Workgroup invocations, std::vector<Workgroup> const& candidates)
+    {// Timed once per device; later runs read the winner from WORKGROUP_LOG
+        std::string key = logKey(shader, invocations);
+        Workgroup best{};
+        if (!readLog(key, best)) {
+            double fastest = std::numeric_limits<double>::max();
+            for (Workgroup const& candidate : candidates) {
+                if (!supported(candidate)) {
+                    continue;
+                }
+                double milliseconds = time(candidate, invocations);
+                std::cout << std::format("{} at {}x{}x{}: {:.3f} ms\n", shader.name, candidate.x, candidate.y, candidate.z, milliseconds);
+                if (milliseconds < fastest) {
+                    fastest = milliseconds;
+                    best = candidate;
+                }
+            }
+            if (fastest == std::numeric_limits<double>::max()) {
+                return;     // Nothing could be timed; the current size stands
+            }
+            writeLog(key, best);
+        }
+        specialize(best);
+        workgroup = {
+            (invocations.x + best.x - 1) / best.x,
+            (invocations.y + best.y - 1) / best.y,
+            (invocations.z + best.z - 1) / best.z
+        };
+    }
+    /* Private */
+    bool ComputePPL::supported(Workgroup localSize) {
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(GPU::physicalDevice, &properties);
+        VkPhysicalDeviceLimits const& limits = properties.limits;
 
-    void ComputePPL::vkCreatePipeline(Shader const& computeShader) {
-        VkPipelineShaderStageCreateInfo stageInfo
-        { VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO };
-        stageInfo.module = computeShader.shaderModule;
-        stageInfo.stage = computeShader.shaderStage;
-        stageInfo.pName = "main";
+        return localSize.x > 0 and localSize.y > 0 and localSize.z > 0
+            and localSize.x <= limits.maxComputeWorkGroupSize[0]
+            and localSize.y <= limits.maxComputeWorkGroupSize[1]
+            and localSize.z <= limits.maxComputeWorkGroupSize[2]
+            and localSize.x * localSize.y * localSize.z <= limits.maxComputeWorkGroupInvocations;
+    }
+    double ComputePPL::time(Workgroup localSize, Workgroup invocations)
+    {// Best of a few dispatches after a warm-up, in milliseconds; the shader really runs on this pipeline's sets
+        struct Timing : Command {
+            VkCommandBuffer& begin() { beginCommand(); return cmdBuffer; }
+        };
+        constexpr uint32_t runs = 4;
 
-        VkComputePipelineCreateInfo pipelineInfo
-        { VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO };
-        pipelineInfo.layout = layout;
-        pipelineInfo.stage = stageInfo;
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(GPU::physicalDevice, &properties);
+        if (!properties.limits.timestampComputeAndGraphics) {
+            return std::numeric_limits<double>::max();
+        }
+        Specialization candidate = constants;
+        candidate.set(0, localSize.x);
+        candidate.set(1, localSize.y);
+        candidate.set(2, localSize.z);
+        VkPipeline candidatePipeline = ComputeVariants::get(shader, layout, candidate);
 
-        VK_CHECK_RESULT(vkCreateComputePipelines(GPU::device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline));
+        VkQueryPoolCreateInfo queryInfo
+        { VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO };
+        queryInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        queryInfo.queryCount = runs * 2;
+        VkQueryPool queries;
+        VK_CHECK_RESULT(vkCreateQueryPool(GPU::device, &queryInfo, nullptr, &queries));
+
+        VkMemoryBarrier barrier
+        { VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+        Timing timing;
+        VkCommandBuffer& commandBuffer = timing.begin();
+        vkCmdResetQueryPool(commandBuffer, queries, 0, runs * 2);
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, candidatePipeline);
+        std::vector<VkDescriptorSet> const& bound = currentSets();
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, layout, 0, static_cast<uint32_t>(bound.size()), bound.data(), 0, nullptr);
+        for (uint32_t run = 0; run <= runs; run++) {
+            // Dispatches are serialized so each timestamp pair brackets one
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+            if (run > 0) {
+                vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queries, (run - 1) * 2);
+            }
+            vkCmdDispatch(commandBuffer,
+                (invocations.x + localSize.x - 1) / localSize.x,
+                (invocations.y + localSize.y - 1) / localSize.y,
+                (invocations.z + localSize.z - 1) / localSize.z);
+            if (run > 0) {
+                vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queries, (run - 1) * 2 + 1);
+            }
+        }
+        timing.endCommand();
+
+        std::array<uint64_t, runs * 2> ticks{};
+        VK_CHECK_RESULT(vkGetQueryPoolResults(GPU::device, queries, 0, runs * 2, sizeof(ticks), ticks.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+        vkDestroyQueryPool(GPU::device, queries, nullptr);
+
+        uint64_t fastest = std::numeric_limits<uint64_t>::max();
+        for (uint32_t run = 0; run < runs; run++) {
+            fastest = std::min(fastest, ticks[run * 2 + 1] - ticks[run * 2]);
+        }
+        return fastest * properties.limits.timestampPeriod / 1e6;
+    }
+    std::string ComputePPL::logKey(Shader const& shader, Workgroup invocations) {
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(GPU::physicalDevice, &properties);
+        return std::format("{} {} {}x{}x{}", properties.deviceName, shader.name, invocations.x, invocations.y, invocations.z);
+    }
+    bool ComputePPL::readLog(std::string const& key, Workgroup& localSize) {
+        std::ifstream log(WORKGROUP_LOG, std::ios::binary);
+        if (!log.is_open()) {
+            return false;
+        }
+        for (std::string line; std::getline(log, line, '\0');) {
+            std::string value;
+            std::getline(log, value, '\0');
+            if (line == key) {
+                return std::sscanf(value.c_str(), "%u %u %u", &localSize.x, &localSize.y, &localSize.z) == 3;
+            }
+        }
+        return false;
+    }
+    void ComputePPL::writeLog(std::string const& key, Workgroup localSize) {
+        std::ofstream log(WORKGROUP_LOG, std::ios::binary | std::ios::app);
+        if (!log.is_open()) {
+            throw std::runtime_error(std::format("Failed to open {}!", WORKGROUP_LOG));
+        }
+        log << key << '\0';
+        log << std::format("{} {} {}", localSize.x, localSize.y, localSize.z) << '\0';
     }
 }
@@ -8,18 +8,59 @@
 #include "vk.pipeline.h"
 #include "vk.shader.h"
 
+#include <algorithm>
+#include <map>
+#include <tuple>
+
 namespace vk {
     struct Workgroup {
         uint32_t x, y, z;
     };
 
+    struct ComputeTask
+    {// Compute work that records its own commands (per-frame sets, buffer resets, barriers) after the ComputePPL dispatches
+        ComputeTask() { tasks.push_back(this); }
+        virtual ~ComputeTask() { std::erase(tasks, this); }
+    public:
+        inline static std::vector<ComputeTask*> tasks;
+        virtual void record(VkCommandBuffer& commandBuffer) = 0;
+        // Its record writes from the host, or reads back, what this slot's last graphics submission used; run waits that submission first
+        virtual bool readsGraphics() const { return false; }
+        static bool waitGraphics() {
+            return std::any_of(tasks.begin(), tasks.end(), [](ComputeTask const* task) { return task->readsGraphics(); });
+        }
+    };
+
+    struct ComputeVariants
+    {// Compute pipelines keyed by shader, layout and specialization; each lives until the device is destroyed
+        static VkPipeline get(Shader const& shader, VkPipelineLayout layout, Specialization const& constants);
+        static void destroy();
+    public:
+        inline static uint32_t hits = 0;    // Requests served without compiling
+    private:
+        using Key = std::tuple<VkShaderModule, VkPipelineLayout, std::vector<uint32_t>, std::vector<uint32_t>>;
+        inline static std::map<Key, VkPipeline> pipelines;
+    };
+
     struct ComputePPL : Pipeline {
-        Workgroup workgroup;
-        ComputePPL(Shader const& computeShader, std::vector<VkDescriptorSet>& descSets, std::vector<VkDescriptorSetLayout>& setLayouts, Workgroup workgroups = { 10, 10, 10 });
+        Workgroup workgroup;    // Workgroups per dispatch
+        ComputePPL(Shader const& computeShader, std::vector<VkDescriptorSet>& descSets, std::vector<VkDescriptorSetLayout>& setLayouts, Workgroup workgroups = { 10, 10, 10 }, Specialization const& constants = {});
+        ~ComputePPL();
     public:
+        // constant_id 0, 1 and 2 are local_size_x_id, _y_id and _z_id by convention
+        void specialize(Workgroup localSize);
         void dispatch();
+        // For shaders indexed by gl_GlobalInvocationID: picks the fastest candidate local size and sizes the dispatch to cover invocations
+        void tune(Workgroup invocations, std::vector<Workgroup> const& candidates);
     private:
-        void vkCreatePipeline(Shader const& computeShader);
+        Shader const& shader;
+        Specialization constants;   // The shader's own, overridden by the constructor's
+
+        static bool supported(Workgroup localSize);
+        double time(Workgroup localSize, Workgroup invocations);
+        static std::string logKey(Shader const& shader, Workgroup invocations);
+        static bool readLog(std::string const& key, Workgroup& localSize);
+        static void writeLog(std::string const& key, Workgroup localSize);
     };
 }
 
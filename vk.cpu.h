@@ -241,7 +241,7 @@ namespace vk {
         }
         void vkSubmitGraphicsQueue() {
             VkSemaphore waitSemaphores[] = { computeFinishedSemaphores[SwapChain::currentFrame], imageAvailable[SwapChain::currentFrame] };
-            VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
+            VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
 
             VkSubmitInfo submitInfo
             { VK_STRUCTURE_TYPE_SUBMIT_INFO };
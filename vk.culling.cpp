@@ -0,0 +1,405 @@
+#include "vk.culling.h"
+
+namespace vk {
+    MeshletCuller::MeshletCuller(test_Mesh& mesh, Descriptor& camera, Descriptor& model, float margin)
+        : Descriptor(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 3),
+        mesh(mesh), camera(camera), model(model),
+        meshletCount(static_cast<uint32_t>(mesh.meshlets.size())),
+        cullSets{ camera.Sets[SwapChain::currentFrame], model.Sets[SwapChain::currentFrame], Sets[SwapChain::currentFrame] },
+        cullLayouts{ camera.SetLayout, model.SetLayout, SetLayout },
+        shader("meshlet.comp", VK_SHADER_STAGE_COMPUTE_BIT),
+        pipeline(shader, cullSets, cullLayouts, { (meshletCount + 63) / 64, 1, 1 })
+    {
+        if (meshletCount == 0) {
+            throw std::runtime_error("MeshletCuller: mesh has no meshlets to cull!");
+        }
+        uploadMeshlets(margin);
+
+        drawBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+        countBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+        counters.resize(MAX_FRAMES_IN_FLIGHT);
+        mesh.indirect.resize(MAX_FRAMES_IN_FLIGHT);
+        for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+            drawBuffers[i] = new Buffer(meshletCount * sizeof(VkDrawIndexedIndirectCommand),
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+            countBuffers[i] = new Buffer(sizeof(Counters),
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+            VK_CHECK_RESULT(vkMapMemory(GPU::device, countBuffers[i]->memory, 0, sizeof(Counters), 0, reinterpret_cast<void**>(&counters[i])));
+            *counters[i] = { 0, 0, 0, meshletCount };
+
+            mesh.indirect[i] = { drawBuffers[i]->buffer, countBuffers[i]->buffer, meshletCount };
+        }
+        writeDescriptorSets(3);
+
+        // One invocation per meshlet of every level; tuning dispatches real culls, so the counters are cleared after
+        pipeline.tune({ meshletCount, 1, 1 }, { { 32, 1, 1 }, { 64, 1, 1 }, { 128, 1, 1 }, { 256, 1, 1 } });
+        for (Counters* counter : counters) {
+            *counter = {};
+        }
+
+        std::cout << "meshlets: " << meshletCount << " clusters over " << mesh.lods.size() << " LODs, " << mesh.lods[0].meshletCount
+            << " for the " << mesh.lods[0].indexCount / 3 << " triangles of LOD 0" << std::endl;
+    }
+    MeshletCuller::~MeshletCuller() {
+        mesh.indirect.clear();
+        for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+            vkUnmapMemory(GPU::device, countBuffers[i]->memory);
+            delete countBuffers[i];
+            delete drawBuffers[i];
+        }
+        delete meshletBuffer;
+    }
+    /* Public */
+    void MeshletCuller::record(VkCommandBuffer& commandBuffer) {
+        // The compute fence for this slot has been waited on, so its counters hold the last completed cull
+        Counters* counter = counters[SwapChain::currentFrame];
+        drawn = counter->drawCount;
+        culled = counter->culledCount;
+        // Selected here, from the same camera the frame is drawn with, so the draws stay within one level
+        lod = mesh.selectLOD();
+        counter->firstMeshlet = mesh.lods[lod].firstMeshlet;
+        counter->meshletCount = mesh.lods[lod].meshletCount;
+
+        // Previous indirect reads of this slot must finish before the counters are reset
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr);
+        vkCmdFillBuffer(commandBuffer, countBuffers[SwapChain::currentFrame]->buffer, 0, offsetof(Counters, firstMeshlet), 0);
+
+        VkMemoryBarrier resetBarrier
+        { VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+        resetBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        resetBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &resetBarrier, 0, nullptr, 0, nullptr);
+
+        VkDescriptorSet sets[] = { camera.Sets[SwapChain::currentFrame], model.Sets[SwapChain::currentFrame], Sets[SwapChain::currentFrame] };
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline.pipeline);
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline.layout, 0, 3, sets, 0, nullptr);
+        vkCmdDispatch(commandBuffer, pipeline.workgroup.x, pipeline.workgroup.y, pipeline.workgroup.z);
+
+        VkMemoryBarrier drawBarrier
+        { VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+        drawBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        drawBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_HOST_READ_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &drawBarrier, 0, nullptr, 0, nullptr);
+    }
+    /* Private */
+    void MeshletCuller::uploadMeshlets(float margin) {
+        std::vector<Optimizer::Meshlet> bounds = mesh.meshlets;
+        for (auto& meshlet : bounds) {
+            meshlet.sphere.w += margin; // Room for vertices displaced after upload
+        }
+        meshletBuffer = new Buffer(bounds.size() * sizeof(Optimizer::Meshlet),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        StageBuffer stage(bounds.data(), meshletBuffer->size);
+        stage.transferData(meshletBuffer->buffer);
+    }
+    void MeshletCuller::writeDescriptorSets(uint32_t bindingCount) {
+        VkWriteDescriptorSet allocWrite
+        { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET };
+        allocWrite.dstArrayElement = 0;
+        allocWrite.descriptorCount = 1;
+        allocWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        std::vector<VkWriteDescriptorSet> descriptorWrites(bindingCount, allocWrite);
+
+        std::vector<VkDescriptorBufferInfo> bufferInfo(bindingCount);
+        for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+            bufferInfo[0] = { meshletBuffer->buffer, 0, meshletBuffer->size };
+            bufferInfo[1] = { drawBuffers[i]->buffer, 0, drawBuffers[i]->size };
+            bufferInfo[2] = { countBuffers[i]->buffer, 0, countBuffers[i]->size };
+
+            for (uint32_t j = 0; j < bindingCount; j++) {
+                descriptorWrites[j].dstSet = Sets[i];
+                descriptorWrites[j].dstBinding = j;
+                descriptorWrites[j].pBufferInfo = &bufferInfo[j];
+            }
+            vkUpdateDescriptorSets(GPU::device, bindingCount, descriptorWrites.data(), 0, nullptr);
+        }
+    }
+
+    /* Depth Pyramid */
+    DepthPyramid::DepthPyramid(SwapChain& swapChain)
+        : SetLayout(createSetLayout({ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER })),
+        depth(swapChain.depth), generation(0),
+        reduceLayout(createSetLayout({ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE })),
+        reduceLayouts{ reduceLayout },
+        // The chain itself is single-sampled whatever the depth is
+        baseShader("depthpyramid.comp", VK_SHADER_STAGE_COMPUTE_BIT),
+        multisampledShader("depthpyramid_ms.comp", VK_SHADER_STAGE_COMPUTE_BIT),
+        reduceShader("depthpyramid.comp", VK_SHADER_STAGE_COMPUTE_BIT),
+        basePPL(baseShader, noSets, reduceLayouts, { 1, 1, 1 }),
+        multisampledPPL(multisampledShader, noSets, reduceLayouts, { 1, 1, 1 }),
+        reducePPL(reduceShader, noSets, reduceLayouts, { 1, 1, 1 })
+    {
+        swapChain.sampleDepth();
+        generation = SwapChain::generation;
+        format = VK_FORMAT_R32_SFLOAT;
+        usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+        createSampler();
+        createResources();
+    }
+    DepthPyramid::~DepthPyramid() {
+        for (VkImageView& view : mipViews) {
+            vkDestroyImageView(GPU::device, view, nullptr);
+        }
+        DescriptorAllocator::persistent->free(allocated);
+        vkDestroySampler(GPU::device, sampler, nullptr);
+    }
+    /* Public */
+    void DepthPyramid::record(VkCommandBuffer& commandBuffer) {
+        if (generation != SwapChain::generation) {
+            // The swapchain waited for the device to idle before replacing the depth
+            destroyResources();
+            createResources();
+            generation = SwapChain::generation;
+            primed = false;     // The new depth holds nothing yet
+        }
+        VkImageSubresourceRange chain{ VK_IMAGE_ASPECT_COLOR_BIT, 0, mipLevels, 0, 1 };
+
+        if (!primed) {
+            // Nothing has been drawn into the depth yet: a far plane chain occludes nothing
+            VkImageMemoryBarrier clearBarrier = createMemoryBarrier(Image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL, mipLevels);
+            clearBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &clearBarrier);
+
+            VkClearColorValue farPlane{ { 1.f, 1.f, 1.f, 1.f } };
+            vkCmdClearColorImage(commandBuffer, Image, VK_IMAGE_LAYOUT_GENERAL, &farPlane, 1, &chain);
+
+            VkMemoryBarrier readBarrier
+            { VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+            readBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            readBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &readBarrier, 0, nullptr, 0, nullptr);
+            primed = true;
+            return;
+        }
+
+        // Last frame's depth writes must land before sampling; last frame's culls must finish reading the chain
+        VkImageMemoryBarrier depthBarrier
+        { VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+        depthBarrier.image = depth.Image;
+        depthBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        depthBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        depthBarrier.oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        depthBarrier.newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+        depthBarrier.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        depthBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        depthBarrier.subresourceRange = { depth.aspect, 0, 1, 0, 1 };
+        if (depth.format == VK_FORMAT_D32_SFLOAT_S8_UINT || depth.format == VK_FORMAT_D24_UNORM_S8_UINT) {
+            depthBarrier.subresourceRange.aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
+        }
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            0, 0, nullptr, 0, nullptr, 1, &depthBarrier);
+
+        VkMemoryBarrier levelBarrier
+        { VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+        levelBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        levelBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+        uint32_t width = extent.width, height = extent.height;
+        for (uint32_t level = 0; level < mipLevels; level++) {
+            ComputePPL& reduce = level > 0 ? reducePPL : depth.samples == VK_SAMPLE_COUNT_1_BIT ? basePPL : multisampledPPL;
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, reduce.pipeline);
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, reduce.layout, 0, 1, &reduceSets[level], 0, nullptr);
+            vkCmdDispatch(commandBuffer, (width + 7) / 8, (height + 7) / 8, 1);
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &levelBarrier, 0, nullptr, 0, nullptr);
+
+            width = std::max(width / 2, 1u);
+            height = std::max(height / 2, 1u);
+        }
+        // This frame's render pass discards the depth; its transition must wait for the reads above
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr);
+    }
+    /* Private */
+    void DepthPyramid::createResources() {
+        extent = depth.extent;
+        mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(extent.width, extent.height)))) + 1;
+        createImage(*this, VK_SAMPLE_COUNT_1_BIT, mipLevels);
+        createImageView(*this, mipLevels);
+
+        mipViews.resize(mipLevels);
+        VkImageViewCreateInfo viewInfo
+        { VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO };
+        viewInfo.image = Image;
+        viewInfo.format = format;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        for (uint32_t level = 0; level < mipLevels; level++) {
+            viewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, level, 1, 0, 1 };
+            VK_CHECK_RESULT(vkCreateImageView(GPU::device, &viewInfo, nullptr, &mipViews[level]));
+        }
+
+        std::vector<VkDescriptorSetLayout> layouts(mipLevels, reduceLayout);
+        layouts.push_back(SetLayout);
+        DescriptorAllocator::persistent->allocate(layouts, allocated);
+
+        reduceSets.assign(allocated.begin(), allocated.end() - 1);
+        Sets.assign(MAX_FRAMES_IN_FLIGHT, allocated.back());
+        writeDescriptorSets();
+        primed = false;
+    }
+    void DepthPyramid::destroyResources() {
+        for (VkImageView& view : mipViews) {
+            vkDestroyImageView(GPU::device, view, nullptr);
+        }
+        mipViews.clear();
+        // Each resize makes a chain of a different depth, so its sets go back rather than pile up
+        DescriptorAllocator::persistent->free(allocated);
+        allocated.clear();
+        destroyResource();
+    }
+    void DepthPyramid::createSampler() {
+        VkSamplerCreateInfo samplerInfo
+        { VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO };
+        samplerInfo.magFilter = VK_FILTER_NEAREST;
+        samplerInfo.minFilter = VK_FILTER_NEAREST;
+        samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+        samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.minLod = 0.f;
+        samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+
+        VK_CHECK_RESULT(vkCreateSampler(GPU::device, &samplerInfo, nullptr, &sampler));
+    }
+    void DepthPyramid::writeDescriptorSets() {
+        std::vector<VkDescriptorImageInfo> sources(mipLevels), targets(mipLevels);
+        std::vector<VkWriteDescriptorSet> descriptorWrites;
+        descriptorWrites.reserve(2 * mipLevels + 1);
+
+        VkWriteDescriptorSet allocWrite
+        { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET };
+        allocWrite.dstArrayElement = 0;
+        allocWrite.descriptorCount = 1;
+
+        for (uint32_t level = 0; level < mipLevels; level++) {
+            sources[level] = level == 0
+                ? VkDescriptorImageInfo{ sampler, depth.ImageView, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL }
+                : VkDescriptorImageInfo{ sampler, mipViews[level - 1], VK_IMAGE_LAYOUT_GENERAL };
+            targets[level] = { VK_NULL_HANDLE, mipViews[level], VK_IMAGE_LAYOUT_GENERAL };
+
+            allocWrite.dstSet = reduceSets[level];
+            allocWrite.dstBinding = 0;
+            allocWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            allocWrite.pImageInfo = &sources[level];
+            descriptorWrites.push_back(allocWrite);
+
+            allocWrite.dstBinding = 1;
+            allocWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+            allocWrite.pImageInfo = &targets[level];
+            descriptorWrites.push_back(allocWrite);
+        }
+        VkDescriptorImageInfo chain{ sampler, ImageView, VK_IMAGE_LAYOUT_GENERAL };
+        allocWrite.dstSet = Sets[0];
+        allocWrite.dstBinding = 0;
+        allocWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        allocWrite.pImageInfo = &chain;
+        descriptorWrites.push_back(allocWrite);
+
+        vkUpdateDescriptorSets(GPU::device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+    }
+    VkDescriptorSetLayout DepthPyramid::createSetLayout(std::vector<VkDescriptorType> const& types) {
+        std::vector<VkDescriptorSetLayoutBinding> layoutBindings(types.size());
+        for (uint32_t i = 0; i < types.size(); i++) {
+            layoutBindings[i].binding = i;
+            layoutBindings[i].descriptorCount = 1;
+            layoutBindings[i].descriptorType = types[i];
+            layoutBindings[i].pImmutableSamplers = nullptr;
+            layoutBindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        }
+        return LayoutCache::setLayout(layoutBindings);
+    }
+
+    /* Instance Culler */
+    InstanceCuller::InstanceCuller(InstanceBatch& batch, Descriptor& camera, DepthPyramid& pyramid)
+        : Descriptor(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 4),
+        batch(batch), camera(camera), pyramid(pyramid),
+        cullSets{ camera.Sets[SwapChain::currentFrame], pyramid.Sets[SwapChain::currentFrame], Sets[SwapChain::currentFrame] },
+        cullLayouts{ camera.SetLayout, pyramid.SetLayout, SetLayout },
+        shader("instance.comp", VK_SHADER_STAGE_COMPUTE_BIT),
+        pipeline(shader, cullSets, cullLayouts, { 1, 1, 1 })
+    {
+        if (!GPU::multiDrawIndirect) {
+            throw std::runtime_error("InstanceCuller needs multiDrawIndirect and drawIndirectFirstInstance!");
+        }
+        drawBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+        countBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+        counters.resize(MAX_FRAMES_IN_FLIGHT);
+        batch.indirect.resize(MAX_FRAMES_IN_FLIGHT);
+        for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+            drawBuffers[i] = new Buffer(batch.maxInstances * sizeof(VkDrawIndexedIndirectCommand),
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+            countBuffers[i] = new Buffer(sizeof(Counters),
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+            VK_CHECK_RESULT(vkMapMemory(GPU::device, countBuffers[i]->memory, 0, sizeof(Counters), 0, reinterpret_cast<void**>(&counters[i])));
+            *counters[i] = {};
+
+            batch.indirect[i] = { drawBuffers[i]->buffer, countBuffers[i]->buffer, batch.maxInstances };
+        }
+        writeDescriptorSets(4);
+    }
+    InstanceCuller::~InstanceCuller() {
+        batch.indirect.clear();
+        for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+            vkUnmapMemory(GPU::device, countBuffers[i]->memory);
+            delete countBuffers[i];
+            delete drawBuffers[i];
+        }
+    }
+    /* Public */
+    void InstanceCuller::record(VkCommandBuffer& commandBuffer) {
+        // The slot's last draw from these buffers has finished, as run waited its fence; the writes are made visible by this submission
+        batch.update(SwapChain::currentFrame);
+
+        Counters* counter = counters[SwapChain::currentFrame];
+        drawn = counter->drawCount;
+        culled = counter->culledCount;
+        occluded = counter->occludedCount;
+        counter->instanceCount = batch.instanceCount();
+
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr);
+        vkCmdFillBuffer(commandBuffer, countBuffers[SwapChain::currentFrame]->buffer, 0, offsetof(Counters, instanceCount), 0);
+
+        VkMemoryBarrier resetBarrier
+        { VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+        resetBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        resetBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &resetBarrier, 0, nullptr, 0, nullptr);
+
+        if (batch.instanceCount() > 0) {
+            VkDescriptorSet sets[] = { camera.Sets[SwapChain::currentFrame], pyramid.Sets[SwapChain::currentFrame], Sets[SwapChain::currentFrame] };
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline.pipeline);
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline.layout, 0, 3, sets, 0, nullptr);
+            vkCmdDispatch(commandBuffer, (batch.instanceCount() + 63) / 64, 1, 1);
+        }
+
+        VkMemoryBarrier drawBarrier
+        { VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+        drawBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        drawBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_HOST_READ_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &drawBarrier, 0, nullptr, 0, nullptr);
+    }
+    /* Private */
+    void InstanceCuller::writeDescriptorSets(uint32_t bindingCount) {
+        VkWriteDescriptorSet allocWrite
+        { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET };
+        allocWrite.dstArrayElement = 0;
+        allocWrite.descriptorCount = 1;
+        allocWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        std::vector<VkWriteDescriptorSet> descriptorWrites(bindingCount, allocWrite);
+
+        std::vector<VkDescriptorBufferInfo> bufferInfo(bindingCount);
+        for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+            bufferInfo[0] = { batch.instanceBuffers[i]->buffer, 0, batch.instanceBuffers[i]->size };
+            bufferInfo[1] = { batch.drawBuffers[i]->buffer, 0, batch.drawBuffers[i]->size };
+            bufferInfo[2] = { drawBuffers[i]->buffer, 0, drawBuffers[i]->size };
+            bufferInfo[3] = { countBuffers[i]->buffer, 0, countBuffers[i]->size };
+
+            for (uint32_t j = 0; j < bindingCount; j++) {
+                descriptorWrites[j].dstSet = Sets[i];
+                descriptorWrites[j].dstBinding = j;
+                descriptorWrites[j].pBufferInfo = &bufferInfo[j];
+            }
+            vkUpdateDescriptorSets(GPU::device, bindingCount, descriptorWrites.data(), 0, nullptr);
+        }
+    }
+}
@@ -0,0 +1,117 @@
+#pragma once
+#ifndef hCulling
+#define hCulling
+
+#include "vk.compute.h"
+#include "vk.buffers.h"
+#include "descriptors.h"
+
+#include "Mesh.h"
+#include "vk.batch.h"
+
+namespace vk {
+    struct MeshletCuller : Descriptor, ComputeTask
+    {// Culls a test_Mesh's meshlets against the view frustum and their normal cones, compacting the survivors into an indirect draw list
+        MeshletCuller(test_Mesh& mesh, Descriptor& camera, Descriptor& model, float margin = 0.f);
+        ~MeshletCuller();
+    public:
+        uint32_t drawn = 0;     // Meshlets drawn by the last completed cull of this frame slot
+        uint32_t culled = 0;    // Meshlets rejected by the last completed cull of this frame slot
+        uint32_t lod = 0;       // Level whose meshlets the last recorded cull reads
+        void record(VkCommandBuffer& commandBuffer) override;
+    private:
+        struct Counters {
+            uint32_t drawCount;
+            uint32_t culledCount;
+            uint32_t firstMeshlet;  // Of the selected LOD, written by the host before submission
+            uint32_t meshletCount;
+        };
+        test_Mesh& mesh;
+        Descriptor& camera;
+        Descriptor& model;
+        uint32_t meshletCount;
+
+        Buffer* meshletBuffer;
+        std::vector<Buffer*> drawBuffers;
+        std::vector<Buffer*> countBuffers;
+        std::vector<Counters*> counters;
+
+        std::vector<VkDescriptorSet> cullSets;
+        std::vector<VkDescriptorSetLayout> cullLayouts;
+        Shader shader;
+        ComputePPL pipeline;
+
+        void uploadMeshlets(float margin);
+        void writeDescriptorSets(uint32_t bindingCount) override;
+    };
+
+    struct DepthPyramid : Image, ComputeTask
+    {// Max-reduced mip chain of the last frame's depth; anything nearer than every texel it covers may be visible
+        DepthPyramid(SwapChain& swapChain);    // Has the swapchain keep its depth for sampling from then on
+        ~DepthPyramid();
+    public:
+        VkDescriptorSetLayout SetLayout;
+        std::vector<VkDescriptorSet> Sets;      // The whole chain behind one sampler, shared by every frame in flight
+        void record(VkCommandBuffer& commandBuffer) override;
+    private:
+        Depth& depth;
+        uint32_t generation;                    // SwapChain::generation the chain was sized for
+        bool primed = false;                    // The depth has been rendered since the chain was created
+
+        VkSampler sampler;
+        std::vector<VkDescriptorSet> allocated;     // reduceSets then the chain's, from the persistent allocator
+        VkDescriptorSetLayout reduceLayout;
+        std::vector<VkDescriptorSet> reduceSets;    // Per mip: reads the level above (the depth for mip 0) and writes this one
+        std::vector<VkImageView> mipViews;
+
+        std::vector<VkDescriptorSet> noSets;
+        std::vector<VkDescriptorSetLayout> reduceLayouts;
+        Shader baseShader;
+        Shader multisampledShader;  // For a multisampled depth, read sample by sample; the sample count may change at runtime
+        Shader reduceShader;
+        ComputePPL basePPL;
+        ComputePPL multisampledPPL;
+        ComputePPL reducePPL;
+
+        void createResources();
+        void destroyResources();
+        void createSampler();
+        void writeDescriptorSets();
+        static VkDescriptorSetLayout createSetLayout(std::vector<VkDescriptorType> const& types);
+    };
+
+    struct InstanceCuller : Descriptor, ComputeTask
+    {// Culls an InstanceBatch against the view frustum and the depth pyramid, compacting one indirect draw per visible instance
+        InstanceCuller(InstanceBatch& batch, Descriptor& camera, DepthPyramid& pyramid);
+        ~InstanceCuller();
+    public:
+        uint32_t drawn = 0;     // Instances drawn by the last completed cull of this frame slot
+        uint32_t culled = 0;    // Instances outside the frustum
+        uint32_t occluded = 0;  // Instances inside the frustum but behind last frame's depth
+        void record(VkCommandBuffer& commandBuffer) override;
+        bool readsGraphics() const override { return true; }    // The slot's instance, draw and count buffers are rewritten from the host
+    private:
+        struct Counters {
+            uint32_t drawCount;
+            uint32_t culledCount;
+            uint32_t occludedCount;
+            uint32_t instanceCount; // Written by the host before submission
+        };
+        InstanceBatch& batch;
+        Descriptor& camera;
+        DepthPyramid& pyramid;
+
+        std::vector<Buffer*> drawBuffers;
+        std::vector<Buffer*> countBuffers;
+        std::vector<Counters*> counters;
+
+        std::vector<VkDescriptorSet> cullSets;
+        std::vector<VkDescriptorSetLayout> cullLayouts;
+        Shader shader;
+        ComputePPL pipeline;
+
+        void writeDescriptorSets(uint32_t bindingCount) override;
+    };
+}
+
+#endif
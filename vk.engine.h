@@ -7,7 +7,11 @@
 
 #include "vk.graphics.h"
 #include "vk.compute.h"
+#include "vk.library.h"
 #include "Scene.h"
+#include "vk.queue.h"
+#include "vk.readback.h"
+#include "vk.profiler.h"
 
 #include "vk.ubo.h"
 #include "vk.ssbo.h"
@@ -17,6 +21,9 @@
 namespace vk {   
     struct Engine : SwapChain, EngineCPU {
         uint32_t imageIndex = 0;
+        VkImage presentImage = VK_NULL_HANDLE;  // Swapchain image the current pass renders or resolves into
+        RenderQueue queue;
+        Readback readback;
         template <int sceneCount, int computeCount>
         void run(Scene(&scene)[sceneCount], ComputePPL(&compute)[computeCount], Pipeline& particlePPL, SSBO& ssbo) {
             std::jthread t1(&Engine::deltaTime, this);
@@ -24,6 +31,15 @@ namespace vk {
             vkAquireImage(imageAvailable[currentFrame], imageIndex);
             // Compute Queue
             vkComputeSync();
+            // Timings, captures, transient sets and tasks that touch what this slot's previous graphics submission used wait for it;
+            // otherwise compute runs ahead of it
+            DescriptorAllocator& transient = *DescriptorAllocator::frames[currentFrame];
+            if (Profiler::recorded(currentFrame) or readback.recorded(currentFrame) or !transient.empty() or ComputeTask::waitGraphics()) {
+                vkWaitForFences(device, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
+            }
+            transient.reset();
+            readback.collect(currentFrame);
+            Profiler::collect(currentFrame);
             runCompute(compute);
             vkSubmitComputeQueue();
 
@@ -37,6 +53,13 @@ namespace vk {
 
             currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
         }
+        // The next frame as presented, handed to done on Readback's worker
+        void captureFrame(Readback::Callback done) {
+            if (!capturable) {
+                throw std::runtime_error("this surface does not allow copying from swapchain images!");
+            }
+            frameCaptures.push_back(std::move(done));
+        }
     protected:
         void updateVtx() {
             /*
@@ -64,7 +87,7 @@ namespace vk {
                     glfwSetWindowShouldClose(window, true);
                     break;
                 case GLFW_KEY_C:
-                    //wireframe = !wireframe;
+                    LinkedPipeline::wireframe = !LinkedPipeline::wireframe;
                     break;
                 case GLFW_KEY_V:
                     //vSync = !vSync;
@@ -77,6 +100,8 @@ namespace vk {
             }
         }
     private:
+        std::vector<Readback::Callback> frameCaptures;
+
         void vkAquireImage(VkSemaphore& waitSemaphore, uint32_t& imageIndex) {
             VkResult result = vkAcquireNextImageKHR(device, swapChainKHR, UINT64_MAX, waitSemaphore, VK_NULL_HANDLE, &imageIndex);
 
@@ -95,8 +120,18 @@ namespace vk {
             { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
 
             VK_CHECK_RESULT(vkBeginCommandBuffer(computeCommands[currentFrame], &beginInfo));
-            for (int i = 0; i < size; i++) {
-                compute[i].dispatch();
+            Profiler::record(computeCommands[currentFrame]);
+            {
+                PROFILE_GPU("compute");
+                for (int i = 0; i < size; i++) {
+                    compute[i].dispatch();
+                }
+            }
+            {
+                PROFILE_GPU("compute tasks");
+                for (ComputeTask* task : ComputeTask::tasks) {
+                    task->record(computeCommands[currentFrame]);
+                }
             }
             VK_CHECK_RESULT(vkEndCommandBuffer(computeCommands[currentFrame]));
         }
@@ -109,7 +144,7 @@ namespace vk {
             VkRenderPassBeginInfo renderPassInfo
             { VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO };
             renderPassInfo.renderPass = renderPass;
-            renderPassInfo.framebuffer = framebuffers[imageIndex];
+            renderPassInfo.framebuffer = dynamicRendering ? VK_NULL_HANDLE : framebuffers[imageIndex];
             renderPassInfo.renderArea.offset = { 0, 0 };
             renderPassInfo.renderArea.extent = Extent;
             renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
@@ -122,28 +157,120 @@ namespace vk {
             { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
 
             VK_CHECK_RESULT(vkBeginCommandBuffer(renderCommands[currentFrame], &beginInfo));
+            RenderState::reset();
+            Profiler::record(renderCommands[currentFrame]);
+            presentImage = swapChainImages[imageIndex];
 
-            vkCmdBeginRenderPass(renderCommands[currentFrame], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+            if (dynamicRendering) {
+                beginRendering(imageIndex, clearValues);
+            }
+            else {
+                vkCmdBeginRenderPass(renderCommands[currentFrame], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+            }
             vkCmdSetViewport(renderCommands[currentFrame], 0, 1, &viewport);
             vkCmdSetScissor(renderCommands[currentFrame], 0, 1, &scissor);
         }
         template <int size>
         void runGraphics(Scene(&scene)[size], Pipeline& particlePipeline, SSBO& ssbo, uint32_t& imageIndex) {
             beginRenderPass(imageIndex);
-
-            particlePipeline.bind();
-            ssbo.draw();
-
-            for (int i = 0; i < size; i++) {
-                scene[i].render();
+            {
+                PROFILE_GPU("particles");
+                particlePipeline.bind();
+                ssbo.draw();
+            }
+            {
+                PROFILE_GPU("scene");
+                for (int i = 0; i < size; i++) {
+                    scene[i].render(queue);
+                }
+                queue.flush();
             }
-
             endRenderPass();
         }
         void endRenderPass() {
-            vkCmdEndRenderPass(renderCommands[currentFrame]);
+            if (dynamicRendering) {
+                endRendering();
+            }
+            else {
+                vkCmdEndRenderPass(renderCommands[currentFrame]);
+            }
+            // Both paths leave the image ready to present
+            for (Readback::Callback& done : frameCaptures) {
+                if (!readback.capture(renderCommands[currentFrame], presentImage, colorFormat, Extent, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+                    VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, std::move(done))) {
+                    std::cerr << "frame capture dropped: the readback region is full\n";
+                }
+            }
+            frameCaptures.clear();
             VK_CHECK_RESULT(vkEndCommandBuffer(renderCommands[currentFrame]));
         }
+        void beginRendering(uint32_t& imageIndex, std::array<VkClearValue, 2>& clearValues)
+        {// The transitions a render pass would have made: attachments start undefined, so their old contents are dropped
+            VkCommandBuffer& commandBuffer = renderCommands[currentFrame];
+            bool resolve = msaaSamples != VK_SAMPLE_COUNT_1_BIT;
+
+            imageBarrier(commandBuffer, presentImage, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT);
+            if (resolve) {
+                imageBarrier(commandBuffer, color.Image, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                    VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT);
+            }
+            // The depth pyramid may still be sampling last frame's depth
+            imageBarrier(commandBuffer, depth.Image, VK_IMAGE_ASPECT_DEPTH_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, 0,
+                VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT);
+
+            VkRenderingAttachmentInfo colorAttachment
+            { VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO };
+            colorAttachment.imageView = resolve ? color.ImageView : swapChainImageViews[imageIndex];
+            colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+            colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+            colorAttachment.storeOp = resolve ? VK_ATTACHMENT_STORE_OP_DONT_CARE : VK_ATTACHMENT_STORE_OP_STORE;
+            colorAttachment.clearValue = clearValues[0];
+            if (resolve) {
+                colorAttachment.resolveMode = VK_RESOLVE_MODE_AVERAGE_BIT;
+                colorAttachment.resolveImageView = swapChainImageViews[imageIndex];
+                colorAttachment.resolveImageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+            }
+
+            VkRenderingAttachmentInfo depthAttachment
+            { VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO };
+            depthAttachment.imageView = depth.ImageView;
+            depthAttachment.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+            depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+            depthAttachment.storeOp = depth.storeOp();
+            depthAttachment.clearValue = clearValues[1];
+
+            VkRenderingInfo renderingInfo
+            { VK_STRUCTURE_TYPE_RENDERING_INFO };
+            renderingInfo.renderArea = { { 0, 0 }, Extent };
+            renderingInfo.layerCount = 1;
+            renderingInfo.colorAttachmentCount = 1;
+            renderingInfo.pColorAttachments = &colorAttachment;
+            renderingInfo.pDepthAttachment = &depthAttachment;
+
+            vkCmdBeginRendering(commandBuffer, &renderingInfo);
+        }
+        void endRendering() {
+            VkCommandBuffer& commandBuffer = renderCommands[currentFrame];
+            vkCmdEndRendering(commandBuffer);
+            imageBarrier(commandBuffer, presentImage, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+                VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0);
+        }
+        static void imageBarrier(VkCommandBuffer& commandBuffer, VkImage image, VkImageAspectFlags aspect, VkImageLayout oldLayout, VkImageLayout newLayout,
+            VkPipelineStageFlags srcStage, VkAccessFlags srcAccess, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess) {
+            VkImageMemoryBarrier barrier
+            { VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+            barrier.srcAccessMask = srcAccess;
+            barrier.dstAccessMask = dstAccess;
+            barrier.oldLayout = oldLayout;
+            barrier.newLayout = newLayout;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.image = image;
+            barrier.subresourceRange = { aspect, 0, 1, 0, 1 };
+            vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+        }
 
         
         void vkPresentImage(VkSemaphore& waitSemaphore, uint32_t& imageIndex) {
@@ -1,4 +1,10 @@
 #include "vk.gpu.h"
+#include "vk.allocator.h"
+#include "vk.library.h"
+#include "vk.compute.h"
+#include "vk.mipmaps.h"
+#include "vk.buffers.h"
+#include "vk.profiler.h"
 
 namespace vk {
     /* Graphics Processing Unit */
@@ -6,9 +12,17 @@ namespace vk {
     {
         pickPhysicalDevice();
         createPhysicalDevice();
+        DescriptorAllocator::create();
     }
     GPU::~GPU()
     {
+        DescriptorAllocator::destroyAll();
+        PipelineLibrary::destroy();
+        MipChain::destroy();
+        StagingRing::destroy();
+        Profiler::destroy();
+        ComputeVariants::destroy();
+        LayoutCache::destroy();
         vkDestroyDevice(device, nullptr);
     }
     //Public:
@@ -25,6 +39,14 @@ namespace vk {
 
         throw std::runtime_error("failed to find suitable memory type!");
     }
+    VkSampleCountFlagBits GPU::sampleCount(VkSampleCountFlagBits wanted) {
+        for (VkSampleCountFlags count = wanted; count > VK_SAMPLE_COUNT_1_BIT; count >>= 1) {
+            if (sampleCounts & count) {
+                return static_cast<VkSampleCountFlagBits>(count);
+            }
+        }
+        return VK_SAMPLE_COUNT_1_BIT;
+    }
     //Private:
     void GPU::pickPhysicalDevice()
     {
@@ -74,14 +96,96 @@ namespace vk {
         deviceFeatures.geometryShader = VK_TRUE;
         deviceFeatures.samplerAnisotropy = VK_TRUE;
         deviceFeatures.sampleRateShading = VK_TRUE; // enable sample shading feature for the device
+        deviceFeatures.shaderStorageImageArrayDynamicIndexing = VK_TRUE; // MipChain walks its levels in a loop
+        deviceFeatures.vertexPipelineStoresAndAtomics = VK_TRUE; // VirtualTexture feedback is written from the vertex shader
+        {// Optional: without it CompressedTexture loads its uncompressed fallback
+            VkPhysicalDeviceFeatures supported;
+            vkGetPhysicalDeviceFeatures(physicalDevice, &supported);
+            // Optional: without them InstanceBatch draws its commands one by one and goes unculled
+            multiDrawIndirect = supported.multiDrawIndirect == VK_TRUE and supported.drawIndirectFirstInstance == VK_TRUE;
+            deviceFeatures.multiDrawIndirect = multiDrawIndirect;
+            deviceFeatures.drawIndirectFirstInstance = multiDrawIndirect;
+            textureCompressionBC = supported.textureCompressionBC == VK_TRUE;
+            deviceFeatures.textureCompressionBC = supported.textureCompressionBC;
+            // Optional: without it Profiler only times its scopes
+            pipelineStatistics = supported.pipelineStatisticsQuery == VK_TRUE;
+            deviceFeatures.pipelineStatisticsQuery = supported.pipelineStatisticsQuery;
+        }
+
+        VkPhysicalDeviceVulkan12Features features12
+        { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES };
+        features12.drawIndirectCount = VK_TRUE; // GPU-compacted draw lists
+        features12.hostQueryReset = VK_TRUE; // Profiler resets a frame slot's queries once its fences have passed
+        // Bindless table: runtime-sized, partially bound arrays written after bind and indexed per draw
+        features12.descriptorIndexing = VK_TRUE;
+        features12.runtimeDescriptorArray = VK_TRUE;
+        features12.descriptorBindingPartiallyBound = VK_TRUE;
+        features12.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+        features12.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+        features12.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+        features12.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+        features12.shaderStorageBufferArrayNonUniformIndexing = VK_TRUE;
+
+        VkPhysicalDeviceVulkan13Features features13
+        { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES };
+        {// Optional: without it SwapChain keeps its render pass
+            VkPhysicalDeviceFeatures2 supported
+            { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2 };
+            supported.pNext = &features13;
+            vkGetPhysicalDeviceFeatures2(physicalDevice, &supported);
+            dynamicRenderingSupported = features13.dynamicRendering == VK_TRUE;
+            features13 = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES };
+            features13.dynamicRendering = dynamicRenderingSupported;
+        }
+        features12.pNext = &features13;
+        void** chain = &features13.pNext;
+
+        // Optional: without it LinkedPipeline falls back to whole-pipeline compiles
+        std::vector<const char*> extensions = deviceExtensions;
+        VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT libraryFeatures
+        { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT };
+        if (extensionSupported(VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME) and extensionSupported(VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME)) {
+            VkPhysicalDeviceFeatures2 supported
+            { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2 };
+            supported.pNext = &libraryFeatures;
+            vkGetPhysicalDeviceFeatures2(physicalDevice, &supported);
+        }
+        pipelineLibrary = libraryFeatures.graphicsPipelineLibrary == VK_TRUE;
+        if (pipelineLibrary) {
+            extensions.push_back(VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME);
+            extensions.push_back(VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME);
+            *chain = &libraryFeatures;
+            chain = &libraryFeatures.pNext;
+        }
+        // Cull mode, topology and depth test/write are dynamic in core 1.3; polygon mode and sample count need extended dynamic state 3
+        VkPhysicalDeviceExtendedDynamicState3FeaturesEXT dynamicState3Features
+        { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_3_FEATURES_EXT };
+        if (extensionSupported(VK_EXT_EXTENDED_DYNAMIC_STATE_3_EXTENSION_NAME)) {
+            VkPhysicalDeviceFeatures2 supported
+            { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2 };
+            supported.pNext = &dynamicState3Features;
+            vkGetPhysicalDeviceFeatures2(physicalDevice, &supported);
+        }
+        dynamicPolygonMode = dynamicState3Features.extendedDynamicState3PolygonMode == VK_TRUE;
+        dynamicSampleCount = dynamicState3Features.extendedDynamicState3RasterizationSamples == VK_TRUE;
+        if (dynamicPolygonMode or dynamicSampleCount) {
+            extensions.push_back(VK_EXT_EXTENDED_DYNAMIC_STATE_3_EXTENSION_NAME);
+            // Only these two features; the others stay off
+            dynamicState3Features = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_3_FEATURES_EXT };
+            dynamicState3Features.extendedDynamicState3PolygonMode = dynamicPolygonMode;
+            dynamicState3Features.extendedDynamicState3RasterizationSamples = dynamicSampleCount;
+            *chain = &dynamicState3Features;
+            chain = &dynamicState3Features.pNext;
+        }
 
         VkDeviceCreateInfo createInfo
         { VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO };
         createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
         createInfo.pQueueCreateInfos = queueCreateInfos.data();
+        createInfo.pNext = &features12;
         createInfo.pEnabledFeatures = &deviceFeatures;
-        createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-        createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+        createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+        createInfo.ppEnabledExtensionNames = extensions.data();
 
         if (enableValidationLayers) {
             createInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
@@ -92,6 +196,12 @@ namespace vk {
         }
 
         VK_CHECK_RESULT(vkCreateDevice(physicalDevice, &createInfo, nullptr, &device));
+        if (dynamicPolygonMode) {
+            vkCmdSetPolygonModeEXT = (PFN_vkCmdSetPolygonModeEXT)vkGetDeviceProcAddr(device, "vkCmdSetPolygonModeEXT");
+        }
+        if (dynamicSampleCount) {
+            vkCmdSetRasterizationSamplesEXT = (PFN_vkCmdSetRasterizationSamplesEXT)vkGetDeviceProcAddr(device, "vkCmdSetRasterizationSamplesEXT");
+        }
 
         vkGetDeviceQueue(device, graphicsFamily.value(), 0, &graphicsQueue);
         vkGetDeviceQueue(device, graphicsFamily.value(), 0, &computeQueue);
@@ -110,9 +220,30 @@ namespace vk {
             swapChainAdequate = !formats.empty() && !presentModes.empty();
         }
 
-        VkPhysicalDeviceFeatures supportedFeatures;
-        vkGetPhysicalDeviceFeatures(device, &supportedFeatures);
-        return queueFamilySupported && extensionsSupported && swapChainAdequate && supportedFeatures.samplerAnisotropy;
+        return queueFamilySupported && extensionsSupported && swapChainAdequate && featuresSupported(device);
+    }
+    bool GPU::featuresSupported(VkPhysicalDevice device)
+    {// Everything createPhysicalDevice enables without a fallback; the optional features are checked where they are enabled
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(device, &properties);
+        if (properties.apiVersion < VK_API_VERSION_1_3) {
+            return false;
+        }
+        VkPhysicalDeviceVulkan12Features features12
+        { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES };
+        VkPhysicalDeviceFeatures2 supported
+        { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2 };
+        supported.pNext = &features12;
+        vkGetPhysicalDeviceFeatures2(device, &supported);
+
+        VkPhysicalDeviceFeatures const& features = supported.features;
+        return features.fillModeNonSolid and features.shaderFloat64 and features.geometryShader and features.samplerAnisotropy
+            and features.sampleRateShading and features.shaderStorageImageArrayDynamicIndexing and features.vertexPipelineStoresAndAtomics
+            and features12.drawIndirectCount and features12.hostQueryReset
+            and features12.descriptorIndexing and features12.runtimeDescriptorArray and features12.descriptorBindingPartiallyBound
+            and features12.descriptorBindingUpdateUnusedWhilePending and features12.descriptorBindingSampledImageUpdateAfterBind
+            and features12.descriptorBindingStorageBufferUpdateAfterBind and features12.shaderSampledImageArrayNonUniformIndexing
+            and features12.shaderStorageBufferArrayNonUniformIndexing;
     }
     bool GPU::findQueueFamilies(VkPhysicalDevice device)
     {
@@ -157,6 +288,16 @@ namespace vk {
 
         return requiredExtensions.empty();
     }
+    bool GPU::extensionSupported(char const* name) {
+        uint32_t extensionCount;
+        vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+
+        std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+        vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, availableExtensions.data());
+
+        return std::any_of(availableExtensions.begin(), availableExtensions.end(),
+            [&](VkExtensionProperties const& extension) { return std::string(extension.extensionName) == name; });
+    }
     void GPU::querySwapChainSupport(VkPhysicalDevice device)
     {
         vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device, surface, &capabilities);
@@ -180,14 +321,8 @@ namespace vk {
         VkPhysicalDeviceProperties physicalDeviceProperties;
         vkGetPhysicalDeviceProperties(physicalDevice, &physicalDeviceProperties);
 
-        VkSampleCountFlags counts = physicalDeviceProperties.limits.framebufferColorSampleCounts & physicalDeviceProperties.limits.framebufferDepthSampleCounts;
-        if (counts & VK_SAMPLE_COUNT_64_BIT) { msaaSamples = VK_SAMPLE_COUNT_64_BIT; }
-        if (counts & VK_SAMPLE_COUNT_32_BIT) { msaaSamples = VK_SAMPLE_COUNT_32_BIT; }
-        if (counts & VK_SAMPLE_COUNT_16_BIT) { msaaSamples = VK_SAMPLE_COUNT_16_BIT; }
-        if (counts & VK_SAMPLE_COUNT_8_BIT) { msaaSamples = VK_SAMPLE_COUNT_8_BIT; }
-        if (counts & VK_SAMPLE_COUNT_4_BIT) { msaaSamples = VK_SAMPLE_COUNT_4_BIT; }
-        if (counts & VK_SAMPLE_COUNT_2_BIT) { msaaSamples = VK_SAMPLE_COUNT_2_BIT; }
-        else { msaaSamples = VK_SAMPLE_COUNT_1_BIT; }
+        sampleCounts = physicalDeviceProperties.limits.framebufferColorSampleCounts & physicalDeviceProperties.limits.framebufferDepthSampleCounts;
+        msaaSamples = sampleCount(requestedSamples);
     }
     void GPU::getSwapExtent()
     {
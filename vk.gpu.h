@@ -19,6 +19,17 @@ namespace vk {
         inline static VkDevice device;
         inline static VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
         inline static VkSampleCountFlagBits msaaSamples = VK_SAMPLE_COUNT_1_BIT;
+        inline static VkSampleCountFlagBits requestedSamples = VK_SAMPLE_COUNT_4_BIT;  // msaaSamples is the most the device has up to this
+        inline static VkSampleCountFlags sampleCounts = VK_SAMPLE_COUNT_1_BIT;         // Both color and depth attachments support
+        inline static bool pipelineLibrary = false;     // VK_EXT_graphics_pipeline_library is enabled
+        inline static bool dynamicPolygonMode = false;  // VK_EXT_extended_dynamic_state3 polygon mode is enabled
+        inline static bool dynamicSampleCount = false;  // VK_EXT_extended_dynamic_state3 rasterization samples are enabled
+        inline static bool textureCompressionBC = false;    // BC1-BC7 images can be sampled
+        inline static bool pipelineStatistics = false;      // Profiler counts shader invocations
+        inline static bool multiDrawIndirect = false;       // Indirect draws take many commands, each with its own firstInstance
+        inline static bool dynamicRenderingSupported = false;   // SwapChain may begin passes without a render pass
+        inline static PFN_vkCmdSetPolygonModeEXT vkCmdSetPolygonModeEXT = nullptr;
+        inline static PFN_vkCmdSetRasterizationSamplesEXT vkCmdSetRasterizationSamplesEXT = nullptr;
 
         inline static std::optional<uint32_t> graphicsFamily;
         inline static VkQueue graphicsQueue;
@@ -33,19 +44,23 @@ namespace vk {
         inline static VkExtent2D Extent;
 
         static uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
+        static VkSampleCountFlagBits sampleCount(VkSampleCountFlagBits wanted);  // The most supported, up to wanted
     protected:
         const std::vector<const char*> deviceExtensions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
+
+        void querySwapChainSupport(VkPhysicalDevice device);
+        void getSwapExtent();
     private:
         void pickPhysicalDevice();
         void createPhysicalDevice();
 
         bool isDeviceSuitable(VkPhysicalDevice device);
+        static bool featuresSupported(VkPhysicalDevice device);
         bool findQueueFamilies(VkPhysicalDevice device);
         bool checkDeviceExtensionSupport(VkPhysicalDevice device);
-        void querySwapChainSupport(VkPhysicalDevice device);
+        bool extensionSupported(char const* name);
 
         void getSampleCount();
-        void getSwapExtent();
     };
 }
 #endif
\ No newline at end of file
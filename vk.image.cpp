@@ -33,7 +33,7 @@ namespace vk {
         memoryBarrier.oldLayout = oldLayout;
         memoryBarrier.newLayout = newLayout;
 
-        memoryBarrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, mipLevels, 0, 1 };
+        memoryBarrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, mipLevels, 0, VK_REMAINING_ARRAY_LAYERS };
 
         std::array<VkAccessFlags, 2> accessFlags = transitionMap[{oldLayout, newLayout}];
         memoryBarrier.srcAccessMask = accessFlags[0];
@@ -72,8 +72,13 @@ namespace vk {
     }
 
     void Image::createImage(vk::Image& image, VkSampleCountFlagBits msaaCount, uint32_t mipLevels) {
+        createHandle(image, msaaCount, mipLevels);
+        allocateMemory(image);
+    }
+    void Image::createHandle(vk::Image& image, VkSampleCountFlagBits msaaCount, uint32_t mipLevels) {
         VkImageCreateInfo imageInfo
         { VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO };
+        imageInfo.flags = image.flags;
         imageInfo.imageType = VK_IMAGE_TYPE_2D;
         imageInfo.format = image.format;
         imageInfo.tiling = image.tiling;
@@ -84,11 +89,10 @@ namespace vk {
         imageInfo.extent = { image.extent.width, image.extent.height, 1 };
         imageInfo.samples = msaaCount;
         imageInfo.mipLevels = mipLevels;
-        imageInfo.arrayLayers = 1;
+        imageInfo.arrayLayers = image.layers;
 
         VK_CHECK_RESULT(vkCreateImage(GPU::device, &imageInfo, nullptr, &image.Image));
-
-        allocateMemory(image);
+        image.samples = msaaCount;
     }
     void Image::allocateMemory(vk::Image& image) {
         VkMemoryRequirements memRequirements;
@@ -108,9 +112,16 @@ namespace vk {
         { VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO };
         viewInfo.image = image.Image;
         viewInfo.format = image.format;
-        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-        viewInfo.subresourceRange = { image.aspect, 0, mipLevels, 0, 1 };
-
+        viewInfo.viewType = image.viewType;
+        viewInfo.subresourceRange = { image.aspect, 0, mipLevels, 0, image.layers };
+
+        VkImageViewUsageCreateInfo usageInfo
+        { VK_STRUCTURE_TYPE_IMAGE_VIEW_USAGE_CREATE_INFO };
+        if (image.flags & VK_IMAGE_CREATE_EXTENDED_USAGE_BIT) {
+            // Usages the image's own format lacks belong to views of another format
+            usageInfo.usage = image.usage & ~VK_IMAGE_USAGE_STORAGE_BIT;
+            viewInfo.pNext = &usageInfo;
+        }
         VK_CHECK_RESULT(vkCreateImageView(GPU::device, &viewInfo, nullptr, &image.ImageView));
     }
 
@@ -43,14 +43,19 @@ namespace vk {
     public:
         VkExtent2D extent;
         uint32_t mipLevels = 1;
+        uint32_t layers = 1;
+        VkImageViewType viewType = VK_IMAGE_VIEW_TYPE_2D;   // 2D_ARRAY to sample layers by index, even just one
 
         VkFormat format;
         VkImageUsageFlags usage;
         VkImageTiling tiling = VK_IMAGE_TILING_OPTIMAL;
+        VkImageCreateFlags flags = 0;
         VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT;
         VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+        VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;  // As last created
 
         static void createImage(vk::Image& image, VkSampleCountFlagBits msaaCount = GPU::msaaSamples, uint32_t mipLevels = 1);
+        static void createHandle(vk::Image& image, VkSampleCountFlagBits msaaCount = GPU::msaaSamples, uint32_t mipLevels = 1);  // No memory bound
         static void allocateMemory(vk::Image& image);
         
         static void createImageView(vk::Image& image, uint32_t mipLevels = 1);
@@ -78,7 +83,7 @@ namespace vk {
             attachment.format = VK_FORMAT_B8G8R8A8_SRGB;
             attachment.samples = GPU::msaaSamples;
             attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-            attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+            attachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;    // Only the resolve is kept, so the samples need never leave tile memory
             attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
             attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
             attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
@@ -105,16 +110,19 @@ namespace vk {
             format = findSupportedFormat(
                 { VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT },
                 VK_IMAGE_TILING_OPTIMAL,
-                VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT
+                VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT
             );
-            usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+            // Dropped after the pass, in lazily allocated memory where there is any, until a reader asks to sample it
+            usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
         }
+        bool sampled() const { return usage & VK_IMAGE_USAGE_SAMPLED_BIT; }
+        VkAttachmentStoreOp storeOp() const { return sampled() ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE; }
         VkAttachmentDescription createAttachment() {
             VkAttachmentDescription attachment{};
             attachment.format = format;
             attachment.samples = GPU::msaaSamples;
             attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-            attachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+            attachment.storeOp = storeOp();
             attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
             attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
             attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
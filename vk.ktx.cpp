@@ -0,0 +1,572 @@
+#include "vk.ktx.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+
+namespace vk::ktx {
+    namespace {
+        constexpr std::array<uint8_t, 12> identifier = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+        struct FormatInfo {
+            VkFormat format;
+            Codec codec;
+            bool srgb;
+            uint32_t blockBytes;    // Per 4x4 block, or per texel when blockSize is 1
+            uint32_t blockSize;
+        };
+        constexpr std::array<FormatInfo, 10> formats{ {
+            { VK_FORMAT_R8G8B8A8_UNORM, Codec::RGBA8, false, 4, 1 },
+            { VK_FORMAT_R8G8B8A8_SRGB, Codec::RGBA8, true, 4, 1 },
+            { VK_FORMAT_BC1_RGB_UNORM_BLOCK, Codec::BC1, false, 8, 4 },
+            { VK_FORMAT_BC1_RGB_SRGB_BLOCK, Codec::BC1, true, 8, 4 },
+            { VK_FORMAT_BC3_UNORM_BLOCK, Codec::BC3, false, 16, 4 },
+            { VK_FORMAT_BC3_SRGB_BLOCK, Codec::BC3, true, 16, 4 },
+            { VK_FORMAT_BC4_UNORM_BLOCK, Codec::BC4, false, 8, 4 },
+            { VK_FORMAT_BC5_UNORM_BLOCK, Codec::BC5, false, 16, 4 },
+            { VK_FORMAT_BC7_UNORM_BLOCK, Codec::BC7, false, 16, 4 },
+            { VK_FORMAT_BC7_SRGB_BLOCK, Codec::BC7, true, 16, 4 }
+        } };
+        constexpr std::array<std::string_view, 6> names = { "rgba8", "bc1", "bc3", "bc4", "bc5", "bc7" };
+
+        FormatInfo const& info(VkFormat format) {
+            for (FormatInfo const& candidate : formats) {
+                if (candidate.format == format and format != VK_FORMAT_UNDEFINED) {
+                    return candidate;
+                }
+            }
+            throw std::runtime_error("unsupported KTX2 format " + std::to_string(format) + "!");
+        }
+        VkDeviceSize levelBytes(FormatInfo const& format, uint32_t width, uint32_t height) {
+            VkDeviceSize blocksX = (width + format.blockSize - 1) / format.blockSize;
+            VkDeviceSize blocksY = (height + format.blockSize - 1) / format.blockSize;
+            return blocksX * blocksY * format.blockBytes;
+        }
+
+        /* Block compression */
+        using Block = std::array<std::array<float, 4>, 16>;
+
+        Block fetch(Level const& rgba, uint32_t blockX, uint32_t blockY) {
+            Block block;
+            for (uint32_t y = 0; y < 4; y++) {
+                for (uint32_t x = 0; x < 4; x++) {
+                    uint32_t px = std::min(blockX * 4 + x, rgba.width - 1), py = std::min(blockY * 4 + y, rgba.height - 1);
+                    uint8_t const* texel = rgba.data.data() + (size_t(py) * rgba.width + px) * 4;
+                    for (uint32_t c = 0; c < 4; c++) {
+                        block[y * 4 + x][c] = texel[c];
+                    }
+                }
+            }
+            return block;
+        }
+        // Mean and dominant direction of the first channels of a block, by power iteration on the covariance
+        template<uint32_t channels>
+        void principalAxis(Block const& block, std::array<float, channels>& mean, std::array<float, channels>& axis) {
+            mean.fill(0.f);
+            for (auto const& texel : block) {
+                for (uint32_t c = 0; c < channels; c++) {
+                    mean[c] += texel[c] / 16.f;
+                }
+            }
+            std::array<std::array<float, channels>, channels> covariance{};
+            for (auto const& texel : block) {
+                for (uint32_t i = 0; i < channels; i++) {
+                    for (uint32_t j = 0; j < channels; j++) {
+                        covariance[i][j] += (texel[i] - mean[i]) * (texel[j] - mean[j]);
+                    }
+                }
+            }
+            axis.fill(1.f);
+            for (int iteration = 0; iteration < 8; iteration++) {
+                std::array<float, channels> next{};
+                for (uint32_t i = 0; i < channels; i++) {
+                    for (uint32_t j = 0; j < channels; j++) {
+                        next[i] += covariance[i][j] * axis[j];
+                    }
+                }
+                float length = 0.f;
+                for (float v : next) {
+                    length += v * v;
+                }
+                if (length < 1e-12f) {
+                    break;  // Flat block: any axis will do
+                }
+                length = std::sqrt(length);
+                for (uint32_t i = 0; i < channels; i++) {
+                    axis[i] = next[i] / length;
+                }
+            }
+        }
+        // Endpoints at the ends of the block's projection on its axis, pulled in slightly to cut the error at the extremes
+        template<uint32_t channels>
+        void endpoints(Block const& block, std::array<float, channels>& low, std::array<float, channels>& high) {
+            std::array<float, channels> mean, axis;
+            principalAxis<channels>(block, mean, axis);
+            float minT = std::numeric_limits<float>::max(), maxT = std::numeric_limits<float>::lowest();
+            for (auto const& texel : block) {
+                float t = 0.f;
+                for (uint32_t c = 0; c < channels; c++) {
+                    t += (texel[c] - mean[c]) * axis[c];
+                }
+                minT = std::min(minT, t);
+                maxT = std::max(maxT, t);
+            }
+            float inset = (maxT - minT) / 32.f;
+            for (uint32_t c = 0; c < channels; c++) {
+                low[c] = std::clamp(mean[c] + axis[c] * (minT + inset), 0.f, 255.f);
+                high[c] = std::clamp(mean[c] + axis[c] * (maxT - inset), 0.f, 255.f);
+            }
+        }
+
+        uint16_t pack565(std::array<float, 3> const& color) {
+            uint32_t r = static_cast<uint32_t>(std::lround(color[0] * 31.f / 255.f));
+            uint32_t g = static_cast<uint32_t>(std::lround(color[1] * 63.f / 255.f));
+            uint32_t b = static_cast<uint32_t>(std::lround(color[2] * 31.f / 255.f));
+            return static_cast<uint16_t>(r << 11 | g << 5 | b);
+        }
+        std::array<float, 3> unpack565(uint16_t color) {
+            uint32_t r = color >> 11 & 31, g = color >> 5 & 63, b = color & 31;
+            return { float(r << 3 | r >> 2), float(g << 2 | g >> 4), float(b << 3 | b >> 2) };
+        }
+        // BC1 color half, always in four-colour mode; returns the squared error
+        float encodeColor(Block const& block, uint8_t* out) {
+            auto quantize = [&](std::array<float, 3> const& high, std::array<float, 3> const& low, uint16_t& c0, uint16_t& c1, uint32_t& indices) {
+                c0 = pack565(high);
+                c1 = pack565(low);
+                if (c0 < c1) {
+                    std::swap(c0, c1);
+                }
+                std::array<std::array<float, 3>, 4> palette;
+                palette[0] = unpack565(c0);
+                palette[1] = unpack565(c1);
+                for (uint32_t c = 0; c < 3; c++) {
+                    palette[2][c] = (2.f * palette[0][c] + palette[1][c]) / 3.f;
+                    palette[3][c] = (palette[0][c] + 2.f * palette[1][c]) / 3.f;
+                }
+                indices = 0;
+                float error = 0.f;
+                for (uint32_t i = 0; i < 16; i++) {
+                    uint32_t best = 0;
+                    float bestError = std::numeric_limits<float>::max();
+                    for (uint32_t p = 0; p < (c0 == c1 ? 1u : 4u); p++) {
+                        float e = 0.f;
+                        for (uint32_t c = 0; c < 3; c++) {
+                            e += (block[i][c] - palette[p][c]) * (block[i][c] - palette[p][c]);
+                        }
+                        if (e < bestError) {
+                            bestError = e;
+                            best = p;
+                        }
+                    }
+                    indices |= best << (2 * i);
+                    error += bestError;
+                }
+                return error;
+            };
+            std::array<float, 3> low, high;
+            endpoints<3>(block, low, high);
+            uint16_t c0, c1;
+            uint32_t indices;
+            float error = quantize(high, low, c0, c1, indices);
+
+            if (c0 != c1) {// One least-squares refit of the endpoints to the chosen indices
+                constexpr std::array<float, 4> weights = { 1.f, 0.f, 2.f / 3.f, 1.f / 3.f };
+                float aa = 0.f, ab = 0.f, bb = 0.f;
+                std::array<float, 3> ax{}, bx{};
+                for (uint32_t i = 0; i < 16; i++) {
+                    float a = weights[indices >> (2 * i) & 3], b = 1.f - a;
+                    aa += a * a;
+                    ab += a * b;
+                    bb += b * b;
+                    for (uint32_t c = 0; c < 3; c++) {
+                        ax[c] += a * block[i][c];
+                        bx[c] += b * block[i][c];
+                    }
+                }
+                float determinant = aa * bb - ab * ab;
+                if (std::abs(determinant) > 1e-6f) {
+                    std::array<float, 3> refitHigh, refitLow;
+                    for (uint32_t c = 0; c < 3; c++) {
+                        refitHigh[c] = std::clamp((ax[c] * bb - bx[c] * ab) / determinant, 0.f, 255.f);
+                        refitLow[c] = std::clamp((bx[c] * aa - ax[c] * ab) / determinant, 0.f, 255.f);
+                    }
+                    uint16_t r0, r1;
+                    uint32_t refitIndices;
+                    float refitError = quantize(refitHigh, refitLow, r0, r1, refitIndices);
+                    if (refitError < error) {
+                        c0 = r0, c1 = r1, indices = refitIndices, error = refitError;
+                    }
+                }
+            }
+            std::memcpy(out, &c0, 2);
+            std::memcpy(out + 2, &c1, 2);
+            std::memcpy(out + 4, &indices, 4);
+            return error;
+        }
+        // BC4 block of one channel, in eight-value mode
+        void encodeChannel(Block const& block, uint32_t channel, uint8_t* out) {
+            float low = 255.f, high = 0.f;
+            for (auto const& texel : block) {
+                low = std::min(low, texel[channel]);
+                high = std::max(high, texel[channel]);
+            }
+            uint8_t a0 = static_cast<uint8_t>(std::lround(high)), a1 = static_cast<uint8_t>(std::lround(low));
+            std::array<float, 8> palette = { float(a0), float(a1) };
+            for (uint32_t k = 2; k < 8; k++) {
+                palette[k] = ((8 - k) * palette[0] + (k - 1) * palette[1]) / 7.f;
+            }
+            uint64_t indices = 0;
+            for (uint32_t i = 0; i < 16 and a0 != a1; i++) {
+                uint64_t best = 0;
+                float bestError = std::numeric_limits<float>::max();
+                for (uint32_t k = 0; k < 8; k++) {
+                    float e = std::abs(block[i][channel] - palette[k]);
+                    if (e < bestError) {
+                        bestError = e;
+                        best = k;
+                    }
+                }
+                indices |= best << (3 * i);
+            }
+            out[0] = a0;
+            out[1] = a1;
+            for (uint32_t i = 0; i < 6; i++) {
+                out[2 + i] = static_cast<uint8_t>(indices >> (8 * i));
+            }
+        }
+        // BC7 mode 6: one subset, 7-bit RGBA endpoints with a p-bit each, 4-bit indices
+        void encodeBC7(Block const& block, uint8_t* out) {
+            constexpr std::array<uint32_t, 16> weights = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+            std::array<float, 4> low, high;
+            endpoints<4>(block, low, high);
+
+            std::array<uint32_t, 4> q0, q1, bestQ0{}, bestQ1{};
+            std::array<uint32_t, 16> indices, bestIndices{};
+            uint32_t bestP0 = 0, bestP1 = 0;
+            float bestError = std::numeric_limits<float>::max();
+            for (uint32_t p0 = 0; p0 < 2; p0++) {
+                for (uint32_t p1 = 0; p1 < 2; p1++) {
+                    std::array<std::array<float, 4>, 16> palette;
+                    for (uint32_t c = 0; c < 4; c++) {
+                        q0[c] = static_cast<uint32_t>(std::clamp(std::lround((low[c] - p0) / 2.f), 0l, 127l));
+                        q1[c] = static_cast<uint32_t>(std::clamp(std::lround((high[c] - p1) / 2.f), 0l, 127l));
+                        uint32_t e0 = q0[c] << 1 | p0, e1 = q1[c] << 1 | p1;
+                        for (uint32_t k = 0; k < 16; k++) {
+                            palette[k][c] = float(((64 - weights[k]) * e0 + weights[k] * e1 + 32) >> 6);
+                        }
+                    }
+                    float error = 0.f;
+                    for (uint32_t i = 0; i < 16; i++) {
+                        float texelError = std::numeric_limits<float>::max();
+                        for (uint32_t k = 0; k < 16; k++) {
+                            float e = 0.f;
+                            for (uint32_t c = 0; c < 4; c++) {
+                                e += (block[i][c] - palette[k][c]) * (block[i][c] - palette[k][c]);
+                            }
+                            if (e < texelError) {
+                                texelError = e;
+                                indices[i] = k;
+                            }
+                        }
+                        error += texelError;
+                    }
+                    if (error < bestError) {
+                        bestError = error;
+                        bestQ0 = q0, bestQ1 = q1, bestP0 = p0, bestP1 = p1, bestIndices = indices;
+                    }
+                }
+            }
+            // The first index is stored with an implicit zero top bit
+            if (bestIndices[0] & 8) {
+                std::swap(bestQ0, bestQ1);
+                std::swap(bestP0, bestP1);
+                for (uint32_t& index : bestIndices) {
+                    index = 15 - index;
+                }
+            }
+            std::memset(out, 0, 16);
+            uint32_t bit = 0;
+            auto put = [&](uint32_t value, uint32_t bits) {
+                for (uint32_t i = 0; i < bits; i++, bit++) {
+                    out[bit / 8] |= static_cast<uint8_t>((value >> i & 1) << (bit % 8));
+                }
+            };
+            put(1 << 6, 7);
+            for (uint32_t c = 0; c < 4; c++) {
+                put(bestQ0[c], 7);
+                put(bestQ1[c], 7);
+            }
+            put(bestP0, 1);
+            put(bestP1, 1);
+            put(bestIndices[0], 3);
+            for (uint32_t i = 1; i < 16; i++) {
+                put(bestIndices[i], 4);
+            }
+        }
+
+        /* Container */
+        template<typename T>
+        void append(std::vector<uint8_t>& bytes, T value) {
+            uint8_t const* begin = reinterpret_cast<uint8_t const*>(&value);
+            bytes.insert(bytes.end(), begin, begin + sizeof(T));
+        }
+        void pad(std::vector<uint8_t>& bytes, size_t alignment) {
+            bytes.resize((bytes.size() + alignment - 1) / alignment * alignment, 0);
+        }
+        template<typename T>
+        T load(std::span<uint8_t const> bytes, size_t offset) {
+            if (offset + sizeof(T) > bytes.size()) {
+                throw std::runtime_error("truncated KTX2 file!");
+            }
+            T value;
+            std::memcpy(&value, bytes.data() + offset, sizeof(T));
+            return value;
+        }
+        // Khronos data format descriptor: one basic block naming the colour model and what each sample holds
+        std::vector<uint8_t> descriptor(FormatInfo const& format) {
+            struct Sample {
+                uint16_t bitOffset;
+                uint8_t bitLength;
+                uint8_t channel;
+            };
+            enum : uint8_t { RGBSDA = 1, BC1A = 128, BC3 = 130, BC4 = 131, BC5 = 132, BC7 = 134 };
+            constexpr uint8_t linear = 0x80, alpha = 15;
+            uint8_t model = RGBSDA;
+            std::vector<Sample> samples;
+            switch (format.codec) {
+            case Codec::RGBA8:
+                samples = { { 0, 8, 0 }, { 8, 8, 1 }, { 16, 8, 2 }, { 24, 8, static_cast<uint8_t>(alpha | (format.srgb ? linear : 0)) } };
+                break;
+            case Codec::BC1: model = BC1A; samples = { { 0, 64, 0 } }; break;
+            case Codec::BC3: model = BC3; samples = { { 0, 64, static_cast<uint8_t>(alpha | (format.srgb ? linear : 0)) }, { 64, 64, 0 } }; break;
+            case Codec::BC4: model = BC4; samples = { { 0, 64, 0 } }; break;
+            case Codec::BC5: model = BC5; samples = { { 0, 64, 0 }, { 64, 64, 1 } }; break;
+            case Codec::BC7: model = BC7; samples = { { 0, 128, 0 } }; break;
+            }
+            std::vector<uint8_t> bytes;
+            uint16_t blockSize = static_cast<uint16_t>(24 + 16 * samples.size());
+            append<uint32_t>(bytes, 4 + blockSize);
+            append<uint32_t>(bytes, 0);             // Khronos vendor, basic descriptor type
+            append<uint16_t>(bytes, 2);             // Version
+            append<uint16_t>(bytes, blockSize);
+            append<uint8_t>(bytes, model);
+            append<uint8_t>(bytes, 1);              // BT.709 primaries
+            append<uint8_t>(bytes, format.srgb ? 2 : 1);
+            append<uint8_t>(bytes, 0);              // Straight alpha
+            uint8_t dimension = static_cast<uint8_t>(format.blockSize - 1);
+            for (uint8_t d : { dimension, dimension, uint8_t(0), uint8_t(0) }) {
+                append<uint8_t>(bytes, d);
+            }
+            append<uint8_t>(bytes, static_cast<uint8_t>(format.blockBytes));
+            bytes.resize(bytes.size() + 7, 0);
+            for (Sample const& sample : samples) {
+                append<uint16_t>(bytes, sample.bitOffset);
+                append<uint8_t>(bytes, sample.bitLength - 1);
+                append<uint8_t>(bytes, sample.channel);
+                append<uint32_t>(bytes, 0);         // Sample position
+                append<uint32_t>(bytes, 0);
+                append<uint32_t>(bytes, format.codec == Codec::RGBA8 ? 255 : std::numeric_limits<uint32_t>::max());
+            }
+            return bytes;
+        }
+    }
+
+    VkDeviceSize File::size() const {
+        VkDeviceSize total = 0;
+        for (Level const& level : levels) {
+            total += level.data.size();
+        }
+        return total;
+    }
+
+    std::vector<Level> mipChain(uint8_t const* rgba, uint32_t width, uint32_t height, bool srgb) {
+        static std::array<float, 256> const linear = [] {
+            std::array<float, 256> table;
+            for (int i = 0; i < 256; i++) {
+                float c = i / 255.f;
+                table[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+            }
+            return table;
+        }();
+        auto encode = [](float c) {
+            c = c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.f / 2.4f) - 0.055f;
+            return static_cast<uint8_t>(std::clamp(c * 255.f + 0.5f, 0.f, 255.f));
+        };
+        uint32_t mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(width, height)))) + 1;
+        std::vector<Level> levels(mipLevels);
+        levels[0] = { width, height, std::vector<uint8_t>(rgba, rgba + size_t(width) * height * 4) };
+
+        for (uint32_t level = 1; level < mipLevels; level++) {
+            Level const& src = levels[level - 1];
+            Level& dst = levels[level];
+            dst.width = std::max(width >> level, 1u);
+            dst.height = std::max(height >> level, 1u);
+            dst.data.resize(size_t(dst.width) * dst.height * 4);
+            for (uint32_t y = 0; y < dst.height; y++) {
+                uint32_t y0 = std::min(2 * y, src.height - 1), y1 = std::min(2 * y + 1, src.height - 1);
+                for (uint32_t x = 0; x < dst.width; x++) {
+                    uint32_t x0 = std::min(2 * x, src.width - 1), x1 = std::min(2 * x + 1, src.width - 1);
+                    uint8_t const* texels[4] = {
+                        src.data.data() + (size_t(y0) * src.width + x0) * 4, src.data.data() + (size_t(y0) * src.width + x1) * 4,
+                        src.data.data() + (size_t(y1) * src.width + x0) * 4, src.data.data() + (size_t(y1) * src.width + x1) * 4
+                    };
+                    uint8_t* out = dst.data.data() + (size_t(y) * dst.width + x) * 4;
+                    for (int c = 0; c < 3; c++) {
+                        out[c] = srgb
+                            ? encode((linear[texels[0][c]] + linear[texels[1][c]] + linear[texels[2][c]] + linear[texels[3][c]]) * 0.25f)
+                            : static_cast<uint8_t>((texels[0][c] + texels[1][c] + texels[2][c] + texels[3][c] + 2) / 4);
+                    }
+                    out[3] = static_cast<uint8_t>((texels[0][3] + texels[1][3] + texels[2][3] + texels[3][3] + 2) / 4);
+                }
+            }
+        }
+        return levels;
+    }
+    Level encode(Level const& rgba, Codec codec) {
+        if (codec == Codec::RGBA8) {
+            return rgba;
+        }
+        FormatInfo const& format = info(ktx::format(codec, false));
+        uint32_t blocksX = (rgba.width + 3) / 4, blocksY = (rgba.height + 3) / 4;
+        Level level{ rgba.width, rgba.height, std::vector<uint8_t>(size_t(blocksX) * blocksY * format.blockBytes) };
+        for (uint32_t by = 0; by < blocksY; by++) {
+            for (uint32_t bx = 0; bx < blocksX; bx++) {
+                Block block = fetch(rgba, bx, by);
+                uint8_t* out = level.data.data() + (size_t(by) * blocksX + bx) * format.blockBytes;
+                switch (codec) {
+                case Codec::BC1: encodeColor(block, out); break;
+                case Codec::BC3: encodeChannel(block, 3, out); encodeColor(block, out + 8); break;
+                case Codec::BC4: encodeChannel(block, 0, out); break;
+                case Codec::BC5: encodeChannel(block, 0, out); encodeChannel(block, 1, out + 8); break;
+                case Codec::BC7: encodeBC7(block, out); break;
+                default: break;
+                }
+            }
+        }
+        return level;
+    }
+    File cook(uint8_t const* rgba, uint32_t width, uint32_t height, Codec codec, bool srgb) {
+        srgb = srgb and codec != Codec::BC4 and codec != Codec::BC5;   // Always data, whatever was asked for
+        File file{ format(codec, srgb) };
+        for (Level const& level : mipChain(rgba, width, height, srgb)) {
+            file.levels.push_back(encode(level, codec));
+        }
+        return file;
+    }
+
+    VkFormat format(Codec codec, bool srgb) {
+        for (FormatInfo const& candidate : formats) {
+            if (candidate.codec == codec and candidate.srgb == srgb) {
+                return candidate.format;
+            }
+        }
+        // BC4 and BC5 hold data, not colour
+        return format(codec, false);
+    }
+    Codec codec(std::string_view name) {
+        for (size_t i = 0; i < names.size(); i++) {
+            if (names[i] == name) {
+                return static_cast<Codec>(i);
+            }
+        }
+        throw std::runtime_error("unknown texture codec " + std::string(name) + "!");
+    }
+    std::string_view name(Codec codec) {
+        return names[static_cast<size_t>(codec)];
+    }
+
+    void write(std::filesystem::path const& path, File const& file) {
+        FormatInfo const& format = info(file.format);
+        uint32_t levelCount = static_cast<uint32_t>(file.levels.size());
+        std::vector<uint8_t> dfd = descriptor(format);
+        std::vector<uint8_t> kvd;
+        {
+            std::string entry = std::string("KTXwriter") + '\0' + "vk.ktx" + '\0';
+            append<uint32_t>(kvd, static_cast<uint32_t>(entry.size()));
+            kvd.insert(kvd.end(), entry.begin(), entry.end());
+            pad(kvd, 4);
+        }
+        size_t levelIndex = identifier.size() + 9 * sizeof(uint32_t) + 4 * sizeof(uint32_t) + 2 * sizeof(uint64_t);
+        size_t dfdOffset = levelIndex + levelCount * 3 * sizeof(uint64_t);
+        size_t kvdOffset = dfdOffset + dfd.size();
+
+        std::vector<uint8_t> bytes(identifier.begin(), identifier.end());
+        for (uint32_t value : { uint32_t(file.format), 1u, file.levels[0].width, file.levels[0].height, 0u, 0u, 1u, levelCount, 0u }) {
+            append<uint32_t>(bytes, value);
+        }
+        append<uint32_t>(bytes, static_cast<uint32_t>(dfdOffset));
+        append<uint32_t>(bytes, static_cast<uint32_t>(dfd.size()));
+        append<uint32_t>(bytes, static_cast<uint32_t>(kvdOffset));
+        append<uint32_t>(bytes, static_cast<uint32_t>(kvd.size()));
+        append<uint64_t>(bytes, 0);     // No supercompression data
+        append<uint64_t>(bytes, 0);
+        bytes.resize(kvdOffset + kvd.size());
+        std::memcpy(bytes.data() + dfdOffset, dfd.data(), dfd.size());
+        std::memcpy(bytes.data() + kvdOffset, kvd.data(), kvd.size());
+
+        // Smallest level first, each aligned to its block size
+        size_t alignment = std::lcm<size_t>(format.blockBytes, 4);
+        for (uint32_t level = levelCount; level-- > 0;) {
+            pad(bytes, alignment);
+            uint64_t offset = bytes.size(), length = file.levels[level].data.size();
+            std::memcpy(bytes.data() + levelIndex + level * 24, &offset, 8);
+            std::memcpy(bytes.data() + levelIndex + level * 24 + 8, &length, 8);
+            std::memcpy(bytes.data() + levelIndex + level * 24 + 16, &length, 8);
+            bytes.insert(bytes.end(), file.levels[level].data.begin(), file.levels[level].data.end());
+        }
+
+        std::ofstream stream(path, std::ios::binary);
+        if (!stream.write(reinterpret_cast<char const*>(bytes.data()), bytes.size())) {
+            throw std::runtime_error("failed to write " + path.string() + "!");
+        }
+    }
+    View parse(std::span<uint8_t const> bytes, std::string const& name) {
+        if (bytes.size() < identifier.size() or !std::equal(identifier.begin(), identifier.end(), bytes.begin())) {
+            throw std::runtime_error(name + " is not a KTX2 file!");
+        }
+        size_t header = identifier.size();
+        VkFormat vkFormat = static_cast<VkFormat>(load<uint32_t>(bytes, header));
+        uint32_t width = load<uint32_t>(bytes, header + 8), height = load<uint32_t>(bytes, header + 12);
+        uint32_t depth = load<uint32_t>(bytes, header + 16), layers = load<uint32_t>(bytes, header + 20);
+        uint32_t faces = load<uint32_t>(bytes, header + 24), levelCount = std::max(load<uint32_t>(bytes, header + 28), 1u);
+        uint32_t supercompression = load<uint32_t>(bytes, header + 32);
+        if (depth > 1 or layers > 1 or faces != 1 or supercompression != 0) {
+            throw std::runtime_error(name + ": only single 2D images without supercompression are supported!");
+        }
+        FormatInfo const& format = info(vkFormat);
+
+        View view{ vkFormat };
+        size_t levelIndex = header + 9 * sizeof(uint32_t) + 4 * sizeof(uint32_t) + 2 * sizeof(uint64_t);
+        for (uint32_t level = 0; level < levelCount; level++) {
+            uint64_t offset = load<uint64_t>(bytes, levelIndex + level * 24), length = load<uint64_t>(bytes, levelIndex + level * 24 + 8);
+            uint32_t levelWidth = std::max(width >> level, 1u), levelHeight = std::max(height >> level, 1u);
+            if (length != levelBytes(format, levelWidth, levelHeight) or offset > bytes.size() or length > bytes.size() - offset) {
+                throw std::runtime_error(name + ": level " + std::to_string(level) + " has the wrong size!");
+            }
+            view.levels.push_back({ levelWidth, levelHeight, bytes.subspan(offset, length) });
+        }
+        return view;
+    }
+    File read(std::filesystem::path const& path) {
+        std::ifstream stream(path, std::ios::binary | std::ios::ate);
+        if (!stream) {
+            throw std::runtime_error("failed to open " + path.string() + "!");
+        }
+        std::vector<uint8_t> bytes(static_cast<size_t>(stream.tellg()));
+        stream.seekg(0);
+        stream.read(reinterpret_cast<char*>(bytes.data()), bytes.size());
+
+        View view = parse(bytes, path.string());
+        File file{ view.format };
+        for (LevelView const& level : view.levels) {
+            file.levels.push_back({ level.width, level.height, std::vector<uint8_t>(level.data.begin(), level.data.end()) });
+        }
+        return file;
+    }
+}
@@ -0,0 +1,61 @@
+#pragma once
+#ifndef hKTX
+#define hKTX
+
+// Needs only the Vulkan headers, not the loader or a device, so offline tools can cook textures too
+#include <vulkan/vulkan_core.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace vk::ktx {
+    enum class Codec {
+        RGBA8,  // Uncompressed, for devices without BC
+        BC1,    // RGB, 4 bits per texel
+        BC3,    // RGBA, 8 bits per texel
+        BC4,    // One channel, 4 bits per texel
+        BC5,    // Two channels (normal maps), 8 bits per texel
+        BC7     // RGBA at BC3 size and near-uncompressed quality
+    };
+    struct Level {
+        uint32_t width;
+        uint32_t height;
+        std::vector<uint8_t> data;  // Tightly packed texels or 4x4 blocks, row by row
+    };
+    struct File {
+        VkFormat format = VK_FORMAT_UNDEFINED;
+        std::vector<Level> levels;  // Finest first
+        VkDeviceSize size() const;  // Of every level
+    };
+    struct LevelView {
+        uint32_t width;
+        uint32_t height;
+        std::span<uint8_t const> data;
+    };
+    struct View
+    {// A File's levels in place, inside bytes someone else owns (e.g. a mapped Archive)
+        VkFormat format = VK_FORMAT_UNDEFINED;
+        std::vector<LevelView> levels;
+    };
+
+    // Full chain from RGBA8, box-filtered in linear space when srgb so coarse levels keep their brightness
+    std::vector<Level> mipChain(uint8_t const* rgba, uint32_t width, uint32_t height, bool srgb);
+    // One RGBA8 level compressed; edge blocks repeat their last row and column
+    Level encode(Level const& rgba, Codec codec);
+    File cook(uint8_t const* rgba, uint32_t width, uint32_t height, Codec codec, bool srgb);
+
+    VkFormat format(Codec codec, bool srgb);
+    Codec codec(std::string_view name);     // "rgba8", "bc1" ... "bc7"
+    std::string_view name(Codec codec);
+
+    // KTX 2.0 without supercompression; read throws std::runtime_error on anything else
+    void write(std::filesystem::path const& path, File const& file);
+    File read(std::filesystem::path const& path);
+    View parse(std::span<uint8_t const> bytes, std::string const& name);     // name for errors only
+}
+
+#endif
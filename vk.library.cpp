@@ -0,0 +1,241 @@
+#include "vk.library.h"
+
+namespace vk {
+    /* Pipeline Library */
+    VkPipeline PipelineLibrary::link(Description const& description, bool optimize) {
+        if (!GPU::pipelineLibrary) {
+            links++;
+            return compile(description);
+        }
+        return link(libraries(description), description.layout, optimize);
+    }
+    PipelineLibrary::Libraries PipelineLibrary::libraries(Description const& description) {
+        return { vertexInput(description), preRasterization(description), fragmentShader(description), fragmentOutput() };
+    }
+    VkPipeline PipelineLibrary::link(Libraries const& libraries, VkPipelineLayout layout, bool optimize) {
+        links++;
+        VkPipelineLibraryCreateInfoKHR libraryInfo
+        { VK_STRUCTURE_TYPE_PIPELINE_LIBRARY_CREATE_INFO_KHR };
+        libraryInfo.libraryCount = static_cast<uint32_t>(libraries.size());
+        libraryInfo.pLibraries = libraries.data();
+
+        VkGraphicsPipelineCreateInfo pipelineInfo
+        { VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO };
+        pipelineInfo.pNext = &libraryInfo;
+        pipelineInfo.flags = optimize ? VK_PIPELINE_CREATE_LINK_TIME_OPTIMIZATION_BIT_EXT : 0;
+        pipelineInfo.layout = layout;
+
+        VkPipeline pipeline;
+        VK_CHECK_RESULT(vkCreateGraphicsPipelines(GPU::device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline));
+        return pipeline;
+    }
+    void PipelineLibrary::destroy() {
+        for (auto& [key, library] : vertexInputs) {
+            vkDestroyPipeline(GPU::device, library, nullptr);
+        }
+        for (auto& [key, library] : preRasterizations) {
+            vkDestroyPipeline(GPU::device, library, nullptr);
+        }
+        for (auto& [key, library] : fragmentShaders) {
+            vkDestroyPipeline(GPU::device, library, nullptr);
+        }
+        for (auto& [key, library] : fragmentOutputs) {
+            vkDestroyPipeline(GPU::device, library, nullptr);
+        }
+        vertexInputs.clear();
+        preRasterizations.clear();
+        fragmentShaders.clear();
+        fragmentOutputs.clear();
+    }
+    /* Private */
+    VkPipeline PipelineLibrary::vertexInput(Description const& description) {
+        auto key = std::make_pair(description.vertexInput.pVertexBindingDescriptions, description.inputAssembly.topology);
+        if (auto cached = vertexInputs.find(key); cached != vertexInputs.end()) {
+            return cached->second;
+        }
+        std::vector<VkDynamicState> dynamicStates = Pipeline::drawStates();
+        VkPipelineDynamicStateCreateInfo dynamicStateInfo = Pipeline::dynamicState(dynamicStates);
+
+        VkGraphicsPipelineCreateInfo pipelineInfo
+        { VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO };
+        pipelineInfo.pVertexInputState = &description.vertexInput;
+        pipelineInfo.pInputAssemblyState = &description.inputAssembly;
+        pipelineInfo.pDynamicState = &dynamicStateInfo;
+
+        return vertexInputs[key] = createPart(pipelineInfo, VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT);
+    }
+    VkPipeline PipelineLibrary::preRasterization(Description const& description) {
+        // A dynamic polygon mode leaves one part for every mode
+        VkPolygonMode polygonMode = GPU::dynamicPolygonMode ? VK_POLYGON_MODE_FILL : description.polygonMode;
+        auto key = std::make_tuple(description.layout, description.vertexShader->shaderModule, polygonMode);
+        if (auto cached = preRasterizations.find(key); cached != preRasterizations.end()) {
+            return cached->second;
+        }
+        VkPipelineShaderStageCreateInfo stageInfo
+        { VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO };
+        stageInfo.stage = description.vertexShader->shaderStage;
+        stageInfo.module = description.vertexShader->shaderModule;
+        stageInfo.pName = "main";
+        stageInfo.pSpecializationInfo = description.vertexShader->constants();
+
+        std::vector<VkDynamicState> dynamicStates = Pipeline::drawStates();
+        VkPipelineDynamicStateCreateInfo dynamicStateInfo = Pipeline::dynamicState(dynamicStates);
+        VkPipelineViewportStateCreateInfo viewportInfo = Pipeline::viewportState(1, 1);
+        VkPipelineRasterizationStateCreateInfo rasterInfo = Pipeline::rasterState(polygonMode);
+        VkPipelineRenderingCreateInfo renderingInfo = Pipeline::renderingState();
+
+        VkGraphicsPipelineCreateInfo pipelineInfo
+        { VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO };
+        pipelineInfo.pNext = SwapChain::dynamicRendering ? &renderingInfo : nullptr;
+        pipelineInfo.layout = description.layout;
+        pipelineInfo.renderPass = SwapChain::renderPass;
+        pipelineInfo.stageCount = 1;
+        pipelineInfo.pStages = &stageInfo;
+        pipelineInfo.pDynamicState = &dynamicStateInfo;
+        pipelineInfo.pViewportState = &viewportInfo;
+        pipelineInfo.pRasterizationState = &rasterInfo;
+
+        return preRasterizations[key] = createPart(pipelineInfo, VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT);
+    }
+    VkPipeline PipelineLibrary::fragmentShader(Description const& description) {
+        auto key = std::make_pair(description.layout, description.fragmentShader->shaderModule);
+        if (auto cached = fragmentShaders.find(key); cached != fragmentShaders.end()) {
+            return cached->second;
+        }
+        VkPipelineShaderStageCreateInfo stageInfo
+        { VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO };
+        stageInfo.stage = description.fragmentShader->shaderStage;
+        stageInfo.module = description.fragmentShader->shaderModule;
+        stageInfo.pName = "main";
+        stageInfo.pSpecializationInfo = description.fragmentShader->constants();
+
+        std::vector<VkDynamicState> dynamicStates = Pipeline::drawStates();
+        VkPipelineDynamicStateCreateInfo dynamicStateInfo = Pipeline::dynamicState(dynamicStates);
+        VkPipelineMultisampleStateCreateInfo msaaInfo = Pipeline::msaaState(VK_TRUE, 0.2f);
+        VkPipelineDepthStencilStateCreateInfo depthStencilInfo = Pipeline::depthStencilState();
+        VkPipelineRenderingCreateInfo renderingInfo = Pipeline::renderingState();
+
+        VkGraphicsPipelineCreateInfo pipelineInfo
+        { VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO };
+        pipelineInfo.pNext = SwapChain::dynamicRendering ? &renderingInfo : nullptr;
+        pipelineInfo.layout = description.layout;
+        pipelineInfo.renderPass = SwapChain::renderPass;
+        pipelineInfo.stageCount = 1;
+        pipelineInfo.pStages = &stageInfo;
+        pipelineInfo.pDynamicState = &dynamicStateInfo;
+        pipelineInfo.pMultisampleState = &msaaInfo;
+        pipelineInfo.pDepthStencilState = &depthStencilInfo;
+
+        return fragmentShaders[key] = createPart(pipelineInfo, VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT);
+    }
+    VkPipeline PipelineLibrary::fragmentOutput() {
+        // A dynamic sample count leaves one part for every count
+        auto key = std::make_pair(SwapChain::colorFormat, GPU::dynamicSampleCount ? VK_SAMPLE_COUNT_1_BIT : GPU::msaaSamples);
+        if (auto cached = fragmentOutputs.find(key); cached != fragmentOutputs.end()) {
+            return cached->second;
+        }
+        VkPipelineColorBlendAttachmentState colorBlendAttachment{};
+        colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+        colorBlendAttachment.blendEnable = VK_FALSE;
+
+        VkPipelineColorBlendStateCreateInfo colorBlendInfo = Pipeline::colorBlendState(colorBlendAttachment, VK_FALSE);
+        VkPipelineMultisampleStateCreateInfo msaaInfo = Pipeline::msaaState(VK_TRUE, 0.2f);
+        VkPipelineRenderingCreateInfo renderingInfo = Pipeline::renderingState();
+        std::vector<VkDynamicState> dynamicStates = Pipeline::drawStates();
+        VkPipelineDynamicStateCreateInfo dynamicStateInfo = Pipeline::dynamicState(dynamicStates);
+
+        VkGraphicsPipelineCreateInfo pipelineInfo
+        { VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO };
+        pipelineInfo.pNext = SwapChain::dynamicRendering ? &renderingInfo : nullptr;
+        pipelineInfo.renderPass = SwapChain::renderPass;
+        pipelineInfo.pDynamicState = &dynamicStateInfo;
+        pipelineInfo.pColorBlendState = &colorBlendInfo;
+        pipelineInfo.pMultisampleState = &msaaInfo;
+
+        return fragmentOutputs[key] = createPart(pipelineInfo, VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT);
+    }
+    VkPipeline PipelineLibrary::createPart(VkGraphicsPipelineCreateInfo& pipelineInfo, VkGraphicsPipelineLibraryFlagsEXT part) {
+        VkGraphicsPipelineLibraryCreateInfoEXT libraryInfo
+        { VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_LIBRARY_CREATE_INFO_EXT };
+        libraryInfo.pNext = pipelineInfo.pNext;
+        libraryInfo.flags = part;
+        pipelineInfo.pNext = &libraryInfo;
+        // Retained so the background link can optimize across parts
+        pipelineInfo.flags |= VK_PIPELINE_CREATE_LIBRARY_BIT_KHR | VK_PIPELINE_CREATE_RETAIN_LINK_TIME_OPTIMIZATION_INFO_BIT_EXT;
+
+        VkPipeline library;
+        VK_CHECK_RESULT(vkCreateGraphicsPipelines(GPU::device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &library));
+        parts++;
+        return library;
+    }
+    VkPipeline PipelineLibrary::compile(Description const& description)
+    {// Everything in one pipeline, through the builder GraphicsPPL uses
+        std::vector<VkPipelineShaderStageCreateInfo> stages(2);
+        for (uint32_t i = 0; Shader const* shader : { description.vertexShader, description.fragmentShader }) {
+            stages[i].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+            stages[i].stage = shader->shaderStage;
+            stages[i].module = shader->shaderModule;
+            stages[i].pSpecializationInfo = shader->constants();
+            stages[i++].pName = "main";
+        }
+        return Pipeline::vkCreateGraphicsPipeline(description.layout, stages, description.vertexInput, description.inputAssembly, description.polygonMode);
+    }
+
+    /* Linked Pipeline */
+    LinkedPipeline::LinkedPipeline(PipelineLibrary::Description const& pipelineDescription, std::vector<VkDescriptorSet> const& descSets, std::vector<VkDescriptorSetLayout>& SetLayout, std::vector<VkPushConstantRange> const& pushConstants)
+        : description(pipelineDescription)
+    {
+        bindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+        sets = descSets;
+        setLayouts = SetLayout;
+        pushRanges = pushConstants;
+        state.polygonMode = description.polygonMode;
+        state.topology = description.inputAssembly.topology;
+        vkLoadSetLayout(SetLayout, layout, pushConstants);
+        description.layout = layout;
+        pipeline = variant(description.polygonMode).fast;
+    }
+    LinkedPipeline::~LinkedPipeline() {
+        for (auto& [mode, variant] : variants) {
+            if (variant->compile.joinable()) {
+                variant->compile.join();
+            }
+            vkDestroyPipeline(GPU::device, variant->fast, nullptr);
+            vkDestroyPipeline(GPU::device, variant->optimized.load(), nullptr);
+        }
+        // Every handle above is owned here, not by Pipeline
+        pipeline = VK_NULL_HANDLE;
+    }
+    void LinkedPipeline::bind() {
+        VkPolygonMode polygonMode = description.polygonMode;
+        if (wireframe) {
+            polygonMode = polygonMode == VK_POLYGON_MODE_FILL ? VK_POLYGON_MODE_LINE : VK_POLYGON_MODE_FILL;
+        }
+        // With a dynamic polygon mode one variant draws both
+        state.polygonMode = polygonMode;
+        Variant& current = variant(GPU::dynamicPolygonMode ? description.polygonMode : polygonMode);
+        VkPipeline optimized = current.optimized.load(std::memory_order_acquire);
+        pipeline = optimized != VK_NULL_HANDLE ? optimized : current.fast;
+        Pipeline::bind();
+    }
+    /* Private */
+    LinkedPipeline::Variant& LinkedPipeline::variant(VkPolygonMode polygonMode) {
+        auto& slot = variants[polygonMode];
+        if (slot) {
+            return *slot;
+        }
+        slot = std::make_unique<Variant>();
+        PipelineLibrary::Description variantDescription = description;
+        variantDescription.polygonMode = polygonMode;
+        slot->fast = PipelineLibrary::link(variantDescription);
+        if (GPU::pipelineLibrary) {
+            // The parts are looked up here, beside every other pipeline build; the worker only links them
+            PipelineLibrary::Libraries libraries = PipelineLibrary::libraries(variantDescription);
+            Variant* target = slot.get();
+            target->compile = std::jthread([target, libraries, layout = variantDescription.layout] {
+                target->optimized.store(PipelineLibrary::link(libraries, layout, true), std::memory_order_release);
+            });
+        }
+        return *slot;
+    }
+}
@@ -0,0 +1,81 @@
+#pragma once
+#ifndef hLibrary
+#define hLibrary
+
+#include "vk.pipeline.h"
+#include "vk.shader.h"
+
+#include <array>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <thread>
+#include <tuple>
+
+namespace vk {
+    struct PipelineLibrary
+    {// Graphics pipeline library parts cached by what they were built from; whole pipelines are linked from four of them
+        struct Description {
+            VkPipelineVertexInputStateCreateInfo vertexInput;
+            VkPipelineInputAssemblyStateCreateInfo inputAssembly;
+            VkPipelineLayout layout;
+            Shader const* vertexShader;
+            Shader const* fragmentShader;
+            VkPolygonMode polygonMode;
+        };
+        using Libraries = std::array<VkPipeline, 4>;    // Vertex input, pre-rasterization, fragment shader, fragment output
+        inline static std::atomic<uint32_t> parts = 0;  // Library parts compiled so far
+        inline static std::atomic<uint32_t> links = 0;  // Pipelines linked (or, without library support, compiled) so far
+
+        // Fast link, or with optimize a link-time-optimized one; a monolithic compile without VK_EXT_graphics_pipeline_library
+        static VkPipeline link(Description const& description, bool optimize = false);
+        // The four cached parts, compiled where missing; only on the thread that builds pipelines, as the caches are unguarded
+        static Libraries libraries(Description const& description);
+        static VkPipeline link(Libraries const& libraries, VkPipelineLayout layout, bool optimize);  // Safe on any thread
+        static void destroy();
+    private:
+        inline static std::map<std::pair<VkVertexInputBindingDescription const*, VkPrimitiveTopology>, VkPipeline> vertexInputs;
+        inline static std::map<std::tuple<VkPipelineLayout, VkShaderModule, VkPolygonMode>, VkPipeline> preRasterizations;
+        inline static std::map<std::pair<VkPipelineLayout, VkShaderModule>, VkPipeline> fragmentShaders;
+        inline static std::map<std::pair<VkFormat, VkSampleCountFlagBits>, VkPipeline> fragmentOutputs;
+
+        static VkPipeline vertexInput(Description const& description);
+        static VkPipeline preRasterization(Description const& description);
+        static VkPipeline fragmentShader(Description const& description);
+        static VkPipeline fragmentOutput();
+        static VkPipeline createPart(VkGraphicsPipelineCreateInfo& pipelineInfo, VkGraphicsPipelineLibraryFlagsEXT part);
+        static VkPipeline compile(Description const& description);
+    };
+
+    struct LinkedPipeline : Pipeline
+    {// A graphics pipeline whose polygon mode is chosen at bind time; without a dynamic polygon mode a new mode costs a link, and an optimized link replaces it once ready
+        LinkedPipeline(PipelineLibrary::Description const& description, std::vector<VkDescriptorSet> const& descSets, std::vector<VkDescriptorSetLayout>& SetLayout, std::vector<VkPushConstantRange> const& pushConstants);
+        ~LinkedPipeline();
+    public:
+        inline static bool wireframe = false;   // Swaps FILL and LINE on every linked pipeline
+        void bind() override;
+    private:
+        struct Variant {
+            VkPipeline fast = VK_NULL_HANDLE;
+            std::atomic<VkPipeline> optimized{ VK_NULL_HANDLE };
+            std::jthread compile;
+        };
+        PipelineLibrary::Description description;
+        std::map<VkPolygonMode, std::unique_ptr<Variant>> variants;
+
+        Variant& variant(VkPolygonMode polygonMode);
+    };
+
+    template<typename primitiveType, VkPolygonMode polygonMode = VK_POLYGON_MODE_FILL>
+    struct LibraryPPL : LinkedPipeline {
+        template<uint32_t size>
+        LibraryPPL(Shader(&shaders)[size], std::vector<VkDescriptorSet> const& descSets, std::vector<VkDescriptorSetLayout>& SetLayout, std::vector<VkPushConstantRange> const& pushConstants = {})
+            : LinkedPipeline({ primitiveType::vertexInput(), primitiveType::inputAssembly(), VK_NULL_HANDLE, &shaders[0], &shaders[size - 1], polygonMode },
+                descSets, SetLayout, pushConstants)
+        {
+            static_assert(size == 2, "LibraryPPL links one vertex and one fragment shader");
+        }
+    };
+}
+
+#endif
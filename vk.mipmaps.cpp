@@ -0,0 +1,196 @@
+#include "vk.mipmaps.h"
+
+#include <array>
+#include <bit>
+#include <cmath>
+#include <numbers>
+
+namespace vk {
+    MipChain::MipChain(Image& image, MipFilter filter) : image(image), filter(filter),
+        srgb(image.format == VK_FORMAT_R8G8B8A8_SRGB)
+    {
+        if (image.format != VK_FORMAT_R8G8B8A8_UNORM and !srgb) {
+            throw std::runtime_error("MipChain only builds RGBA8 images!");
+        }
+        if (!(image.usage & VK_IMAGE_USAGE_STORAGE_BIT) or (srgb and !(image.flags & VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT))) {
+            throw std::runtime_error("MipChain needs an image made with MipChain::prepare!");
+        }
+        create();
+
+        views.resize(image.mipLevels);
+        VkImageViewUsageCreateInfo usageInfo
+        { VK_STRUCTURE_TYPE_IMAGE_VIEW_USAGE_CREATE_INFO };
+        usageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT;
+        VkImageViewCreateInfo viewInfo
+        { VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO };
+        viewInfo.pNext = &usageInfo;
+        viewInfo.image = image.Image;
+        viewInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        for (uint32_t level = 0; level < image.mipLevels; level++) {
+            viewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, level, 1, 0, 1 };
+            VK_CHECK_RESULT(vkCreateImageView(GPU::device, &viewInfo, nullptr, &views[level]));
+        }
+
+        // A box pass can only hand over to its last workgroup once a level fits one 64x64 tile
+        for (uint32_t base = 0; base + 1 < image.mipLevels;) {
+            bases.push_back(base);
+            if (filter == MipFilter::Kaiser) {
+                base++;
+                continue;
+            }
+            uint32_t handover = std::min(base + 6, image.mipLevels - 1);
+            bool fits = std::max(image.extent.width >> handover, image.extent.height >> handover) <= 64;
+            base = std::min(base + (fits ? maxLevels : 6), image.mipLevels - 1);
+        }
+        std::vector<VkDescriptorSetLayout> layouts(bases.size(), setLayout);
+        DescriptorAllocator::persistent->allocate(layouts, sets);
+        writeDescriptorSets();
+    }
+    MipChain::~MipChain() {
+        DescriptorAllocator::persistent->free(sets);
+        for (VkImageView view : views) {
+            vkDestroyImageView(GPU::device, view, nullptr);
+        }
+    }
+    /* Public */
+    void MipChain::prepare(Image& image) {
+        image.usage |= VK_IMAGE_USAGE_STORAGE_BIT;
+        if (image.format == VK_FORMAT_R8G8B8A8_SRGB) {
+            // sRGB is never a storage format; the sampled views keep the usage they support
+            image.flags |= VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT | VK_IMAGE_CREATE_EXTENDED_USAGE_BIT;
+        }
+    }
+    void MipChain::record(VkCommandBuffer& commandBuffer, VkImageLayout oldLayout, VkImageLayout newLayout, VkPipelineStageFlags dstStage) {
+        std::array<VkImageMemoryBarrier, 2> barriers{};
+        for (VkImageMemoryBarrier& barrier : barriers) {
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.image = image.Image;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        }
+        // Level 0 keeps its contents; the rest are rewritten whole
+        barriers[0].oldLayout = oldLayout;
+        barriers[0].srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+        barriers[0].subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+        barriers[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barriers[1].subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 1, image.mipLevels - 1, 0, 1 };
+        uint32_t barrierCount = image.mipLevels > 1 ? 2 : 1;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+            0, nullptr, 0, nullptr, barrierCount, barriers.data());
+
+        if (!sets.empty()) {
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline());
+        }
+        VkMemoryBarrier passBarrier
+        { VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+        passBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        passBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        for (size_t i = 0; i < sets.size(); i++) {
+            uint32_t next = i + 1 < bases.size() ? bases[i + 1] : image.mipLevels - 1;
+            uint32_t width = std::max(image.extent.width >> (bases[i] + 1), 1u);
+            uint32_t height = std::max(image.extent.height >> (bases[i] + 1), 1u);
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, layout, 0, 1, &sets[i], 0, nullptr);
+            if (filter == MipFilter::Box) {
+                // One workgroup per 32x32 tile of the first level written
+                Pass pass{ static_cast<int32_t>(next - bases[i]), ((width + 31) / 32) * ((height + 31) / 32) };
+                vkCmdPushConstants(commandBuffer, layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(Pass), &pass);
+                vkCmdDispatch(commandBuffer, (width + 31) / 32, (height + 31) / 32, 1);
+            }
+            else {
+                vkCmdDispatch(commandBuffer, (width + 7) / 8, (height + 7) / 8, 1);
+            }
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+                1, &passBarrier, 0, nullptr, 0, nullptr);
+        }
+
+        VkImageMemoryBarrier finalBarrier = barriers[0];
+        finalBarrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+        finalBarrier.newLayout = newLayout;
+        finalBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        finalBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        finalBarrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, image.mipLevels, 0, 1 };
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, dstStage, 0,
+            0, nullptr, 0, nullptr, 1, &finalBarrier);
+    }
+    void MipChain::destroy() {
+        // The pipelines belong to ComputeVariants and the layouts to LayoutCache
+        delete boxShader;
+        delete kaiserShader;
+        delete counter;
+        boxShader = kaiserShader = nullptr;
+        counter = nullptr;
+    }
+    /* Private */
+    void MipChain::create() {
+        if (counter) {
+            return;
+        }
+        setLayout = LayoutCache::setLayout({
+            { 0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, maxLevels + 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr },
+            { 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr }
+        });
+        std::vector<VkDescriptorSetLayout> setLayouts{ setLayout };
+        layout = LayoutCache::pipelineLayout(setLayouts, { { VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(Pass) } });
+        boxShader = new Shader("mipmap.comp", VK_SHADER_STAGE_COMPUTE_BIT);
+        kaiserShader = new Shader("mipmap_kaiser.comp", VK_SHADER_STAGE_COMPUTE_BIT);
+
+        // Zeroed once; each box pass's last workgroup puts it back
+        counter = new Buffer(sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        struct Fill : Command {
+            Fill(VkBuffer buffer) {
+                beginCommand();
+                vkCmdFillBuffer(cmdBuffer, buffer, 0, VK_WHOLE_SIZE, 0);
+                endCommand();
+            }
+        } fill(counter->buffer);
+    }
+    VkPipeline MipChain::pipeline() const {
+        Specialization constants;
+        constants.set(0, srgb);
+        if (filter == MipFilter::Box) {
+            return ComputeVariants::get(*boxShader, layout, constants);
+        }
+        // Halves of a 6-tap sinc for a 2:1 reduction, windowed by Kaiser and normalized to sum to one
+        std::array<float, 3> weights;
+        float sum = 0.f;
+        for (uint32_t i = 0; i < weights.size(); i++) {
+            float distance = i + 0.5f;
+            float x = std::numbers::pi_v<float> * distance / 2.f;
+            float t = distance / 3.f;
+            weights[i] = std::sin(x) / x * std::cyl_bessel_i(0.f, kaiserBeta * std::sqrt(1.f - t * t)) / std::cyl_bessel_i(0.f, kaiserBeta);
+            sum += 2.f * weights[i];
+        }
+        for (uint32_t i = 0; i < weights.size(); i++) {
+            constants.set(1 + i, std::bit_cast<uint32_t>(weights[i] / sum));
+        }
+        return ComputeVariants::get(*kaiserShader, layout, constants);
+    }
+    void MipChain::writeDescriptorSets() {
+        for (size_t i = 0; i < sets.size(); i++) {
+            // Levels past the end of the chain repeat the last; the shader never reaches them
+            std::array<VkDescriptorImageInfo, maxLevels + 1> imageInfo;
+            for (uint32_t j = 0; j < imageInfo.size(); j++) {
+                imageInfo[j] = { VK_NULL_HANDLE, views[std::min(bases[i] + j, image.mipLevels - 1)], VK_IMAGE_LAYOUT_GENERAL };
+            }
+            VkDescriptorBufferInfo bufferInfo{ counter->buffer, 0, counter->size };
+
+            std::array<VkWriteDescriptorSet, 2> descriptorWrites{};
+            for (VkWriteDescriptorSet& descriptorWrite : descriptorWrites) {
+                descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                descriptorWrite.dstSet = sets[i];
+            }
+            descriptorWrites[0].dstBinding = 0;
+            descriptorWrites[0].descriptorCount = static_cast<uint32_t>(imageInfo.size());
+            descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+            descriptorWrites[0].pImageInfo = imageInfo.data();
+            descriptorWrites[1].dstBinding = 1;
+            descriptorWrites[1].descriptorCount = 1;
+            descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            descriptorWrites[1].pBufferInfo = &bufferInfo;
+            vkUpdateDescriptorSets(GPU::device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+        }
+    }
+}
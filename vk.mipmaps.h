@@ -0,0 +1,53 @@
+#pragma once
+#ifndef hMipmaps
+#define hMipmaps
+
+#include "vk.compute.h"
+#include "vk.image.h"
+#include "vk.buffers.h"
+#include "vk.allocator.h"
+
+namespace vk {
+    enum class MipFilter {
+        Box,    // 2x2 average; up to twelve levels per dispatch (all of them up to 4096x4096)
+        Kaiser  // 6x6 Kaiser-windowed sinc; sharper, one dispatch per level
+    };
+
+    struct MipChain
+    {// Levels 1.. of an RGBA8 image built from level 0 in compute, in place of a barrier and a blit per level
+     // sRGB images are written through UNORM views and encoded in the shader, so prepare() them before createImage
+        MipChain(Image& image, MipFilter filter = MipFilter::Box);
+        ~MipChain();
+    public:
+        inline static float kaiserBeta = 4.f;   // Window shape; higher is smoother and less sharp
+
+        static void prepare(Image& image);
+        // Level 0 is read in oldLayout's place once earlier writes land; every level ends in newLayout for dstStage
+        void record(VkCommandBuffer& commandBuffer, VkImageLayout oldLayout, VkImageLayout newLayout, VkPipelineStageFlags dstStage);
+        static void destroy();
+    private:
+        inline static constexpr uint32_t maxLevels = 12;    // Written by one box pass
+        struct Pass {
+            int32_t levels;
+            uint32_t workgroups;
+        };
+        Image& image;
+        MipFilter filter;
+        bool srgb;
+        std::vector<VkImageView> views;         // Single-level UNORM storage views
+        std::vector<VkDescriptorSet> sets;      // Per box pass, or per level for Kaiser
+        std::vector<uint32_t> bases;            // Level each set starts from
+
+        inline static VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+        inline static VkPipelineLayout layout = VK_NULL_HANDLE;
+        inline static Shader* boxShader = nullptr;
+        inline static Shader* kaiserShader = nullptr;
+        inline static Buffer* counter = nullptr;    // Workgroups finished in the current box pass; zero between passes
+
+        static void create();
+        VkPipeline pipeline() const;
+        void writeDescriptorSets();
+    };
+}
+
+#endif
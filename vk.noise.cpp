@@ -0,0 +1,202 @@
+#include "vk.noise.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <format>
+#include <iostream>
+#include <vector>
+
+#if defined(__SSE2__) or defined(_M_X64) or (defined(_M_IX86_FP) and _M_IX86_FP >= 2)
+#define VK_NOISE_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace vk {
+    namespace noise {
+        namespace {
+            // plane.comp's constants and operations, in its order, so float rounding follows the shader's
+            constexpr float Cx = 0.211324865405187f;    // (3.0-sqrt(3.0))/6.0
+            constexpr float Cy = 0.366025403784439f;    // 0.5*(sqrt(3.0)-1.0)
+            constexpr float Cz = -0.577350269189626f;   // -1.0 + 2.0 * C.x
+            constexpr float Cw = 0.024390243902439f;    // 1.0 / 41.0
+
+            float mod289(float x) {
+                return x - std::floor(x * (1.f / 289.f)) * 289.f;
+            }
+            float permute(float x) {
+                return mod289(((x * 34.f) + 10.f) * x);
+            }
+            float fract(float x) {
+                return x - std::floor(x);
+            }
+            int32_t texel(int32_t page, uint32_t pageSize, uint32_t local, uint32_t level) {
+                return (page * static_cast<int32_t>(pageSize) + static_cast<int32_t>(local)) << level;
+            }
+#ifdef VK_NOISE_SSE2
+            // SSE2 has no floor; truncation is one too high for negative non-integers
+            __m128 floor4(__m128 x) {
+                __m128 truncated = _mm_cvtepi32_ps(_mm_cvttps_epi32(x));
+                return _mm_sub_ps(truncated, _mm_and_ps(_mm_cmpgt_ps(truncated, x), _mm_set1_ps(1.f)));
+            }
+            __m128 mod289(__m128 x) {
+                return _mm_sub_ps(x, _mm_mul_ps(floor4(_mm_mul_ps(x, _mm_set1_ps(1.f / 289.f))), _mm_set1_ps(289.f)));
+            }
+            __m128 permute(__m128 x) {
+                return mod289(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(34.f)), _mm_set1_ps(10.f)), x));
+            }
+            __m128 simplex4(__m128 vx, __m128 vy) {
+                __m128 s = _mm_mul_ps(_mm_add_ps(vx, vy), _mm_set1_ps(Cy));
+                __m128 ix = floor4(_mm_add_ps(vx, s));
+                __m128 iy = floor4(_mm_add_ps(vy, s));
+                __m128 t = _mm_mul_ps(_mm_add_ps(ix, iy), _mm_set1_ps(Cx));
+                __m128 x0 = _mm_add_ps(_mm_sub_ps(vx, ix), t);
+                __m128 y0 = _mm_add_ps(_mm_sub_ps(vy, iy), t);
+                // Lower or upper triangle of the skewed cell
+                __m128 i1x = _mm_and_ps(_mm_cmpgt_ps(x0, y0), _mm_set1_ps(1.f));
+                __m128 i1y = _mm_sub_ps(_mm_set1_ps(1.f), i1x);
+                __m128 x1 = _mm_sub_ps(_mm_add_ps(x0, _mm_set1_ps(Cx)), i1x);
+                __m128 y1 = _mm_sub_ps(_mm_add_ps(y0, _mm_set1_ps(Cx)), i1y);
+                __m128 x2 = _mm_add_ps(x0, _mm_set1_ps(Cz));
+                __m128 y2 = _mm_add_ps(y0, _mm_set1_ps(Cz));
+
+                ix = mod289(ix);
+                iy = mod289(iy);
+                __m128 one = _mm_set1_ps(1.f);
+                __m128 p[3] = {
+                    permute(_mm_add_ps(permute(iy), ix)),
+                    permute(_mm_add_ps(_mm_add_ps(permute(_mm_add_ps(iy, i1y)), ix), i1x)),
+                    permute(_mm_add_ps(_mm_add_ps(permute(_mm_add_ps(iy, one)), ix), one))
+                };
+                __m128 cx[3] = { x0, x1, x2 };
+                __m128 cy[3] = { y0, y1, y2 };
+
+                __m128 sign = _mm_set1_ps(-0.f);
+                __m128 sum = _mm_setzero_ps();
+                for (int i = 0; i < 3; i++) {
+                    __m128 m = _mm_max_ps(_mm_sub_ps(_mm_set1_ps(0.5f), _mm_add_ps(_mm_mul_ps(cx[i], cx[i]), _mm_mul_ps(cy[i], cy[i]))), _mm_setzero_ps());
+                    m = _mm_mul_ps(m, m);
+                    m = _mm_mul_ps(m, m);
+                    // Gradients: 41 points uniformly over a line, mapped onto a diamond
+                    __m128 scaled = _mm_mul_ps(p[i], _mm_set1_ps(Cw));
+                    __m128 x = _mm_sub_ps(_mm_mul_ps(_mm_set1_ps(2.f), _mm_sub_ps(scaled, floor4(scaled))), one);
+                    __m128 h = _mm_sub_ps(_mm_andnot_ps(sign, x), _mm_set1_ps(0.5f));
+                    __m128 a0 = _mm_sub_ps(x, floor4(_mm_add_ps(x, _mm_set1_ps(0.5f))));
+                    m = _mm_mul_ps(m, _mm_sub_ps(_mm_set1_ps(1.79284291400159f),
+                        _mm_mul_ps(_mm_set1_ps(0.85373472095314f), _mm_add_ps(_mm_mul_ps(a0, a0), _mm_mul_ps(h, h)))));
+                    __m128 g = _mm_add_ps(_mm_mul_ps(a0, cx[i]), _mm_mul_ps(h, cy[i]));
+                    sum = _mm_add_ps(sum, _mm_mul_ps(m, g));
+                }
+                return _mm_mul_ps(_mm_set1_ps(130.f), sum);
+            }
+#endif
+        }
+
+        float simplex(float vx, float vy) {
+            // First corner
+            float s = (vx + vy) * Cy;
+            float ix = std::floor(vx + s);
+            float iy = std::floor(vy + s);
+            float t = (ix + iy) * Cx;
+            float x0 = vx - ix + t;
+            float y0 = vy - iy + t;
+            // Other corners
+            float i1x = x0 > y0 ? 1.f : 0.f;
+            float i1y = 1.f - i1x;
+            float cx[3] = { x0, x0 + Cx - i1x, x0 + Cz };
+            float cy[3] = { y0, y0 + Cx - i1y, y0 + Cz };
+            // Permutations
+            ix = mod289(ix);
+            iy = mod289(iy);
+            float p[3] = {
+                permute(permute(iy) + ix),
+                permute(permute(iy + i1y) + ix + i1x),
+                permute(permute(iy + 1.f) + ix + 1.f)
+            };
+
+            float sum = 0.f;
+            for (int i = 0; i < 3; i++) {
+                float m = std::max(0.5f - (cx[i] * cx[i] + cy[i] * cy[i]), 0.f);
+                m = m * m;
+                m = m * m;
+                float x = 2.f * fract(p[i] * Cw) - 1.f;
+                float h = std::abs(x) - 0.5f;
+                float a0 = x - std::floor(x + 0.5f);
+                // Normalise gradients implicitly by scaling m
+                m *= 1.79284291400159f - 0.85373472095314f * (a0 * a0 + h * h);
+                sum += m * (a0 * cx[i] + h * cy[i]);
+            }
+            return 130.f * sum;
+        }
+        float height(int32_t x, int32_t y, Terrain const& terrain) {
+            float frequency = terrain.frequency;
+            float amplitude = terrain.amplitude;
+            float value = 0.f;
+            for (int32_t i = 0; i < terrain.octaves; i++) {
+                value += simplex(static_cast<float>(x) * frequency, static_cast<float>(y) * frequency) * amplitude;
+                value = (value + 1.f) * 0.1f;
+                frequency *= 2.f;
+                amplitude *= terrain.gain;
+            }
+            return value;
+        }
+        void page(int32_t x, int32_t y, uint32_t level, uint32_t pageSize, Terrain const& terrain, float* heights, bool simd) {
+            uint32_t side = pageSize + 1;
+            for (uint32_t row = 0; row < side; row++) {
+                float* out = heights + static_cast<size_t>(row) * side;
+                int32_t texelY = texel(y, pageSize, row, level);
+                uint32_t column = 0;
+#ifdef VK_NOISE_SSE2
+                if (simd) {
+                    __m128 vy = _mm_set1_ps(static_cast<float>(texelY));
+                    for (; column + 4 <= side; column += 4) {
+                        __m128 vx = _mm_setr_ps(
+                            static_cast<float>(texel(x, pageSize, column, level)), static_cast<float>(texel(x, pageSize, column + 1, level)),
+                            static_cast<float>(texel(x, pageSize, column + 2, level)), static_cast<float>(texel(x, pageSize, column + 3, level)));
+                        __m128 frequency = _mm_set1_ps(terrain.frequency);
+                        float amplitude = terrain.amplitude;
+                        __m128 value = _mm_setzero_ps();
+                        for (int32_t i = 0; i < terrain.octaves; i++) {
+                            __m128 noise = simplex4(_mm_mul_ps(vx, frequency), _mm_mul_ps(vy, frequency));
+                            value = _mm_add_ps(value, _mm_mul_ps(noise, _mm_set1_ps(amplitude)));
+                            value = _mm_mul_ps(_mm_add_ps(value, _mm_set1_ps(1.f)), _mm_set1_ps(0.1f));
+                            frequency = _mm_add_ps(frequency, frequency);
+                            amplitude *= terrain.gain;
+                        }
+                        _mm_storeu_ps(out + column, value);
+                    }
+                }
+#endif
+                for (; column < side; column++) {
+                    out[column] = height(texel(x, pageSize, column, level), texelY, terrain);
+                }
+            }
+        }
+        void benchmark(Terrain const& terrain, uint32_t pageSize, uint32_t pages)
+        {// Pages walk outwards along a row at level 0, as a viewer crossing the terrain would ask for them
+            using clock = std::chrono::steady_clock;
+            size_t texels = static_cast<size_t>(pageSize + 1) * (pageSize + 1);
+            std::vector<float> scalar(texels), simd(texels);
+            auto run = [&](bool vectorized, std::vector<float>& heights) {
+                auto start = clock::now();
+                for (uint32_t i = 0; i < pages; i++) {
+                    page(static_cast<int32_t>(i), 0, 0, pageSize, terrain, heights.data(), vectorized);
+                }
+                return std::chrono::duration<double>(clock::now() - start).count();
+            };
+            double scalarSeconds = run(false, scalar);
+            double simdSeconds = run(true, simd);
+            float difference = 0.f;
+            for (size_t i = 0; i < texels; i++) {
+                difference = std::max(difference, std::abs(scalar[i] - simd[i]));
+            }
+            std::cout << std::format("CPU terrain, {} pages of {}x{} texels, {} octaves, one thread\n", pages, pageSize + 1, pageSize + 1, terrain.octaves);
+            std::cout << std::format("  scalar:  {:9.1f} pages/s\n", pages / scalarSeconds);
+#ifdef VK_NOISE_SSE2
+            std::cout << std::format("  SSE2:    {:9.1f} pages/s  (largest difference from scalar {:.2g})\n", pages / simdSeconds, difference);
+#else
+            std::cout << std::format("  no SIMD on this target, scalar again: {:9.1f} pages/s\n", pages / simdSeconds);
+#endif
+        }
+    }
+}
@@ -0,0 +1,33 @@
+#pragma once
+#ifndef hNoise
+#define hNoise
+
+// Needs no Vulkan at all, so servers and tools can know the terrain without a GPU
+#include <cstdint>
+
+namespace vk {
+    namespace noise {
+        // plane.comp's push constants past pageSize; heights here match its pages to float rounding
+        struct Terrain {
+            float frequency = 0.0025f;  // Of the first octave, per level-0 texel; each octave doubles it
+            float amplitude = 5.f;      // Of the first octave
+            int32_t octaves = 5;
+            float gain = 0.5f;          // Amplitude kept from one octave to the next
+
+            bool operator==(Terrain const&) const = default;
+        };
+
+        // 2D simplex noise as plane.comp computes it (Ashima Arts / Gustavson), in about [-1, 1]
+        float simplex(float x, float y);
+        // Fractal noise at level-0 texel (x, y)
+        float height(int32_t x, int32_t y, Terrain const& terrain);
+        // A VirtualTexture page and its border, as the generator writes it: (pageSize + 1)^2 heights row by row.
+        // Four texels at a time with SSE2 where the target has it, unless simd is false
+        void page(int32_t x, int32_t y, uint32_t level, uint32_t pageSize, Terrain const& terrain, float* heights, bool simd = true);
+
+        // Pages per second on one thread, scalar and SIMD, and the largest difference between the two
+        void benchmark(Terrain const& terrain = {}, uint32_t pageSize = 128, uint32_t pages = 64);
+    }
+}
+
+#endif
@@ -1,23 +1,41 @@
 #include "vk.pipeline.h"
+#include "vk.allocator.h"
 
 namespace vk {
     Pipeline::~Pipeline() {
-        std::jthread t0([&] { vkDestroyPipeline(GPU::device, pipeline, nullptr); });
-        std::jthread t1([&] { vkDestroyPipelineLayout(GPU::device, layout, nullptr); });
+        // The layout is shared through LayoutCache and outlives the pipeline
+        vkDestroyPipeline(GPU::device, pipeline, nullptr);
     }
     void Pipeline::bind() {
         VkCommandBuffer& commandBuffer = EngineCPU::renderCommands[SwapChain::currentFrame];
 
-        vkCmdBindDescriptorSets(commandBuffer, bindPoint, layout, 0, static_cast<uint32_t>(sets.size()), sets.data(), 0, nullptr);
-        vkCmdBindPipeline(commandBuffer, bindPoint, pipeline);
+        RenderState::bindPipeline(commandBuffer, pipeline, layout, setLayouts, pushRanges);
+        std::vector<VkDescriptorSet> const& bound = currentSets();
+        RenderState::bindDescriptorSets(commandBuffer, 0, static_cast<uint32_t>(bound.size()), bound.data());
+        RenderState::setDrawState(commandBuffer, state);
+    }
+    void Pipeline::perFrame(uint32_t set, std::vector<VkDescriptorSet> const& ownerSets) {
+        if (set >= sets.size() or ownerSets.size() < MAX_FRAMES_IN_FLIGHT) {
+            throw std::runtime_error("per-frame sets need a bound set index and one set per frame in flight!");
+        }
+        frameSets.resize(sets.size(), nullptr);
+        frameSets[set] = &ownerSets;
+    }
+    std::vector<VkDescriptorSet> const& Pipeline::currentSets() {
+        if (frameSets.empty()) {
+            return sets;
+        }
+        resolved = sets;
+        for (size_t i = 0; i < frameSets.size(); i++) {
+            if (frameSets[i]) {
+                resolved[i] = (*frameSets[i])[SwapChain::currentFrame];
+            }
+        }
+        return resolved;
     }
 
-    void Pipeline::vkLoadSetLayout(std::vector<VkDescriptorSetLayout>& SetLayout, VkPipelineLayout& layout) {
-        VkPipelineLayoutCreateInfo pipelineLayoutInfo
-        { VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO };
-        pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(SetLayout.size());
-        pipelineLayoutInfo.pSetLayouts = SetLayout.data();
-        VK_CHECK_RESULT(vkCreatePipelineLayout(GPU::device, &pipelineLayoutInfo, nullptr, &layout));
+    void Pipeline::vkLoadSetLayout(std::vector<VkDescriptorSetLayout>& SetLayout, VkPipelineLayout& layout, std::vector<VkPushConstantRange> const& pushConstants) {
+        layout = LayoutCache::pipelineLayout(SetLayout, pushConstants);
     }
 
     std::vector<VkPipelineShaderStageCreateInfo> Pipeline::stageInfo(std::vector<Shader>& shaders) {
@@ -101,6 +119,71 @@ namespace vk {
         dynamic_state.pDynamicStates = dynamicStates.data();
         return dynamic_state;
     }
+    VkPipelineRenderingCreateInfo Pipeline::renderingState()
+    {// Attachment formats a dynamic-rendering pipeline is compiled against, in place of a render pass
+        VkPipelineRenderingCreateInfo rendering
+        { VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO };
+        rendering.colorAttachmentCount = 1;
+        rendering.pColorAttachmentFormats = &SwapChain::colorFormat;
+        rendering.depthAttachmentFormat = SwapChain::depthFormat;
+        return rendering;
+    }
+    std::vector<VkDynamicState> Pipeline::drawStates()
+    {// Viewport and scissor, and everything DrawState covers
+        std::vector<VkDynamicState> dynamicStates = {
+            VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR,
+            VK_DYNAMIC_STATE_CULL_MODE, VK_DYNAMIC_STATE_PRIMITIVE_TOPOLOGY,
+            VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE, VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE
+        };
+        if (GPU::dynamicPolygonMode) {
+            dynamicStates.push_back(VK_DYNAMIC_STATE_POLYGON_MODE_EXT);
+        }
+        if (GPU::dynamicSampleCount) {
+            dynamicStates.push_back(VK_DYNAMIC_STATE_RASTERIZATION_SAMPLES_EXT);
+        }
+        return dynamicStates;
+    }
+
+    VkPipeline Pipeline::vkCreateGraphicsPipeline(VkPipelineLayout layout, std::vector<VkPipelineShaderStageCreateInfo> const& shaderStages,
+        VkPipelineVertexInputStateCreateInfo const& vertexInput, VkPipelineInputAssemblyStateCreateInfo const& inputAssembly, VkPolygonMode polygonMode)
+    {// The one graphics pipeline builder; polygonMode is baked only when it cannot be dynamic
+        std::vector<VkDynamicState> dynamicStates = drawStates();
+        VkPipelineDynamicStateCreateInfo dynamicStateInfo = dynamicState(dynamicStates);
+        VkPipelineViewportStateCreateInfo viewportInfo = viewportState(1, 1);
+
+        VkPipelineColorBlendAttachmentState colorBlendAttachment{};
+        colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+        colorBlendAttachment.blendEnable = VK_FALSE;
+
+        VkPipelineRasterizationStateCreateInfo rasterInfo = rasterState(polygonMode);
+        VkPipelineMultisampleStateCreateInfo msaaInfo = msaaState(VK_TRUE, 0.2f);
+        VkPipelineColorBlendStateCreateInfo colorBlendInfo = colorBlendState(colorBlendAttachment, VK_FALSE);
+        VkPipelineDepthStencilStateCreateInfo depthStencilInfo = depthStencilState();
+        VkPipelineRenderingCreateInfo renderingInfo = renderingState();
+
+        VkGraphicsPipelineCreateInfo pipelineInfo
+        { VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO };
+        pipelineInfo.pNext = SwapChain::dynamicRendering ? &renderingInfo : nullptr;
+        pipelineInfo.layout = layout;
+        pipelineInfo.renderPass = SwapChain::renderPass;
+        pipelineInfo.subpass = 0;
+
+        pipelineInfo.stageCount = static_cast<uint32_t>(shaderStages.size());
+        pipelineInfo.pStages = shaderStages.data();
+
+        pipelineInfo.pVertexInputState = &vertexInput;
+        pipelineInfo.pInputAssemblyState = &inputAssembly;
+        pipelineInfo.pDynamicState = &dynamicStateInfo;
+        pipelineInfo.pViewportState = &viewportInfo;
+        pipelineInfo.pRasterizationState = &rasterInfo;
+        pipelineInfo.pMultisampleState = &msaaInfo;
+        pipelineInfo.pColorBlendState = &colorBlendInfo;
+        pipelineInfo.pDepthStencilState = &depthStencilInfo;
+
+        VkPipeline pipeline;
+        VK_CHECK_RESULT(vkCreateGraphicsPipelines(GPU::device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline));
+        return pipeline;
+    }
 
 
 }
\ No newline at end of file
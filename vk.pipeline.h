@@ -4,6 +4,7 @@
 #include "vk.swapchain.h"
 #include "vk.shader.h"
 #include "vk.cpu.h"
+#include "vk.queue.h"
 
 namespace vk {
     struct Pipeline {
@@ -13,9 +14,20 @@ namespace vk {
         VkPipeline pipeline = VK_NULL_HANDLE;
         VkPipelineLayout layout = VK_NULL_HANDLE;
         std::vector<VkDescriptorSet> sets;
+        std::vector<VkDescriptorSetLayout> setLayouts;
+        // Set index taken from an owner's per-frame Sets at bind time, for descriptors that differ by frame slot
+        void perFrame(uint32_t set, std::vector<VkDescriptorSet> const& ownerSets);
+        std::vector<VkDescriptorSet> const& currentSets();     // sets, with the per-frame ones of SwapChain::currentFrame
+        std::vector<VkPushConstantRange> pushRanges;
+        DrawState state;        // Set on bind, so one pipeline draws filled, wireframe, culled or not
+        inline static uint32_t count = 0;
+        uint32_t id = count++;  // Creation order, used by RenderQueue sort keys
     protected:
+        friend struct PipelineLibrary;
         VkPipelineBindPoint bindPoint{};
-        static void vkLoadSetLayout(std::vector<VkDescriptorSetLayout>& SetLayout, VkPipelineLayout& layout);
+        std::vector<std::vector<VkDescriptorSet> const*> frameSets;    // Per set index; null keeps sets[i]
+        std::vector<VkDescriptorSet> resolved;
+        static void vkLoadSetLayout(std::vector<VkDescriptorSetLayout>& SetLayout, VkPipelineLayout& layout, std::vector<VkPushConstantRange> const& pushConstants = {});
 
         virtual std::vector<VkPipelineShaderStageCreateInfo> stageInfo(std::vector<Shader>& shaders);
 
@@ -25,6 +37,11 @@ namespace vk {
         static VkPipelineDepthStencilStateCreateInfo depthStencilState();
         static VkPipelineColorBlendStateCreateInfo colorBlendState(VkPipelineColorBlendAttachmentState& colorBlendAttachment, VkBool32 logicOpEnable, VkLogicOp logicOp = VK_LOGIC_OP_COPY);
         static VkPipelineDynamicStateCreateInfo dynamicState(std::vector<VkDynamicState>& dynamicStates);
+        static VkPipelineRenderingCreateInfo renderingState();
+        static std::vector<VkDynamicState> drawStates();
+
+        static VkPipeline vkCreateGraphicsPipeline(VkPipelineLayout layout, std::vector<VkPipelineShaderStageCreateInfo> const& shaderStages,
+            VkPipelineVertexInputStateCreateInfo const& vertexInput, VkPipelineInputAssemblyStateCreateInfo const& inputAssembly, VkPolygonMode polygonMode);
     };
 }
 #endif
\ No newline at end of file
@@ -4,6 +4,13 @@
 #define hPrimitives
 
 #include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+#include <glm/gtc/type_precision.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <limits>
+#include <algorithm>
+#include <type_traits>
 
 struct Vertex {
     glm::vec4 position;
@@ -98,6 +105,7 @@ struct Particle {
 
 template<VkPrimitiveTopology topology>
 struct Primitive {
+    static constexpr VkPrimitiveTopology primitiveTopology = topology;
     glm::vec4 position;
     glm::vec4 normal;
     glm::vec4 color;
@@ -141,7 +149,129 @@ struct Primitive {
     }
 };
 
+struct Quantization {
+    // Per-mesh decode for normalized positions: position = bias + scale * stored
+    glm::vec3 scale{ 1.f };
+    glm::vec3 bias{ 0.f };
+    glm::mat4 matrix() const {
+        return glm::scale(glm::translate(glm::mat4(1.f), bias), scale);
+    }
+};
+
+inline glm::vec2 octEncode(glm::vec3 n)
+{// Maps a unit normal onto the octahedron, then unfolds the lower hemisphere into the square
+    n /= (glm::abs(n.x) + glm::abs(n.y) + glm::abs(n.z));
+    glm::vec2 oct = glm::vec2(n);
+    if (n.z < 0.f) {
+        glm::vec2 signs = { n.x >= 0.f ? 1.f : -1.f, n.y >= 0.f ? 1.f : -1.f };
+        oct = (1.f - glm::abs(glm::vec2(n.y, n.x))) * signs;
+    }
+    return oct;
+}
+
+template<VkPrimitiveTopology topology, VkFormat positionFormat = VK_FORMAT_R16G16B16A16_SFLOAT, VkFormat normalFormat = VK_FORMAT_R16G16_SNORM>
+struct PackedPrimitive {
+    // Compact variant of Primitive<topology>:
+    //  position: R16G16B16A16_SFLOAT, or R16G16B16A16_SNORM decoded by test_Mesh::decode (Quantization)
+    //  normal:   R16G16_SNORM octahedral (decode with octDecode in packed.glsl), or R16G16B16A16_SNORM
+    //  color:    R8G8B8A8_UNORM
+    //  texCoord: R16G16_SFLOAT
+    static_assert(positionFormat == VK_FORMAT_R16G16B16A16_SFLOAT or positionFormat == VK_FORMAT_R16G16B16A16_SNORM,
+        "unsupported packed position format");
+    static_assert(normalFormat == VK_FORMAT_R16G16_SNORM or normalFormat == VK_FORMAT_R16G16B16A16_SNORM,
+        "unsupported packed normal format");
+    static constexpr VkPrimitiveTopology primitiveTopology = topology;
+    inline static constexpr bool octahedral = (normalFormat == VK_FORMAT_R16G16_SNORM);
+    inline static constexpr bool quantized = (positionFormat == VK_FORMAT_R16G16B16A16_SNORM);  // Needs its Quantization's matrix to draw
+
+    glm::u16vec4 position;
+    std::conditional_t<octahedral, uint32_t, glm::u16vec4> normal;
+    uint32_t color;
+    uint32_t texCoord;
+
+    static Quantization quantize(std::vector<Primitive<topology>> const& vertices) {
+        Quantization quantization;
+        if constexpr (positionFormat == VK_FORMAT_R16G16B16A16_SNORM) {
+            glm::vec3 lower(std::numeric_limits<float>::max());
+            glm::vec3 upper(std::numeric_limits<float>::lowest());
+            for (auto const& vertex : vertices) {
+                lower = glm::min(lower, glm::vec3(vertex.position));
+                upper = glm::max(upper, glm::vec3(vertex.position));
+            }
+            quantization.bias = 0.5f * (upper + lower);
+            quantization.scale = glm::max(0.5f * (upper - lower), glm::vec3(1e-6f));
+        }
+        return quantization;
+    }
+    static PackedPrimitive encode(Primitive<topology> const& vertex, Quantization const& quantization) {
+        PackedPrimitive packed{};
+        if constexpr (positionFormat == VK_FORMAT_R16G16B16A16_SNORM) {
+            glm::vec3 local = (glm::vec3(vertex.position) - quantization.bias) / quantization.scale;
+            packed.position = glm::u16vec4(glm::unpackUint4x16(glm::packSnorm4x16(glm::vec4(local, 1.f))));
+        }
+        else {
+            packed.position = glm::u16vec4(glm::unpackUint4x16(glm::packHalf4x16(glm::vec4(glm::vec3(vertex.position), 1.f))));
+        }
+        glm::vec3 normal = glm::normalize(glm::vec3(vertex.normal));
+        if constexpr (octahedral) {
+            packed.normal = glm::packSnorm2x16(octEncode(normal));
+        }
+        else {
+            packed.normal = glm::u16vec4(glm::unpackUint4x16(glm::packSnorm4x16(glm::vec4(normal, 1.f))));
+        }
+        packed.color = glm::packUnorm4x8(glm::clamp(vertex.color, 0.f, 1.f));
+        packed.texCoord = glm::packHalf2x16(vertex.texCoord);
+        return packed;
+    }
+    static std::vector<PackedPrimitive> encode(std::vector<Primitive<topology>> const& vertices, Quantization const& quantization) {
+        std::vector<PackedPrimitive> packed(vertices.size());
+        std::transform(vertices.begin(), vertices.end(), packed.begin(),
+            [&](Primitive<topology> const& vertex) { return encode(vertex, quantization); });
+        return packed;
+    }
+
+    static VkVertexInputBindingDescription bindings() {
+        VkVertexInputBindingDescription bindingDescription{};
+        bindingDescription.binding = 0;
+        bindingDescription.stride = sizeof(PackedPrimitive);
+        bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+        return bindingDescription;
+    }
+    static std::vector<VkVertexInputAttributeDescription> attributes() {
+        std::vector<VkVertexInputAttributeDescription> Attributes{
+            { 0, 0, positionFormat, offsetof(PackedPrimitive, position) },                 // Position
+            { 1, 0, normalFormat, offsetof(PackedPrimitive, normal) },                     // Normal
+            { 2, 0, VK_FORMAT_R8G8B8A8_UNORM, offsetof(PackedPrimitive, color) },          // Color
+            { 3, 0, VK_FORMAT_R16G16_SFLOAT, offsetof(PackedPrimitive, texCoord) }         // Texture Coordinate
+        };
+        return Attributes;
+    }
+    static VkPipelineVertexInputStateCreateInfo vertexInput() {
+        static auto bindingDescription = bindings();
+        static auto attributeDescriptions = attributes();
+
+        VkPipelineVertexInputStateCreateInfo vertexInputInfo
+        { VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO };
+        vertexInputInfo.vertexBindingDescriptionCount = 1;
+        vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
+        vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
+        vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
+        return vertexInputInfo;
+    }
+    static VkPipelineInputAssemblyStateCreateInfo inputAssembly() {
+        VkPipelineInputAssemblyStateCreateInfo inputAssembly
+        { VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO };
+        inputAssembly.topology = topology;
+        inputAssembly.primitiveRestartEnable = VK_FALSE;
+        return inputAssembly;
+    }
+};
+
 typedef Primitive<VK_PRIMITIVE_TOPOLOGY_LINE_LIST> lineList;
 typedef Primitive<VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST> triangleList;
 
+typedef PackedPrimitive<VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST> packedTriangleList;
+typedef PackedPrimitive<VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, VK_FORMAT_R16G16B16A16_SNORM> quantizedTriangleList;
+
 #endif
\ No newline at end of file
@@ -0,0 +1,217 @@
+#include "vk.profiler.h"
+#include "vk.swapchain.h"
+
+#include <algorithm>
+#include <format>
+#include <fstream>
+#include <string_view>
+
+namespace vk {
+    namespace {
+        // Counted in this order, the order of their bits
+        constexpr VkQueryPipelineStatisticFlags statisticFlags =
+            VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+            VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+            VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT |
+            VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+        constexpr uint32_t statisticCount = 4;
+        constexpr size_t maxEvents = 1 << 20;
+    }
+
+    /* Scope */
+    Profiler::Scope::Scope(char const* name)
+        : marker(Profiler::begin(name)) {}
+    Profiler::Scope::~Scope() {
+        Profiler::end(marker);
+    }
+
+    /* Profiler */
+    void Profiler::record(VkCommandBuffer recording) {
+        commandBuffer = recording;
+        depth = 0;
+        statisticsOpen = false;
+    }
+    void Profiler::collect(uint32_t slot) {
+        if (timestamps[slot] == VK_NULL_HANDLE) {
+            return;
+        }
+        std::vector<Marker>& frame = markers[slot];
+        if (!frame.empty()) {
+            uint32_t count = static_cast<uint32_t>(frame.size());
+            std::vector<uint64_t> ticks(size_t(count) * 2);
+            std::vector<uint64_t> counts(size_t(statisticsUsed[slot]) * statisticCount);
+            VkResult result = vkGetQueryPoolResults(GPU::device, timestamps[slot], 0, count * 2, ticks.size() * sizeof(uint64_t),
+                ticks.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+            if (result == VK_SUCCESS and statisticsUsed[slot] > 0) {
+                result = vkGetQueryPoolResults(GPU::device, statistics[slot], 0, statisticsUsed[slot], counts.size() * sizeof(uint64_t),
+                    counts.data(), statisticCount * sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+            }
+            // Not ready only where a frame was recorded but never submitted
+            if (result == VK_SUCCESS) {
+                passes.clear();
+                for (uint32_t i = 0; i < count; i++) {
+                    Marker const& marker = frame[i];
+                    Pass pass{ marker.name, marker.depth };
+                    pass.milliseconds = static_cast<double>((ticks[2 * i + 1] - ticks[2 * i]) & mask) * period * 1e-6;
+
+                    auto average = averages.find(std::string_view(marker.name));
+                    if (average == averages.end()) {
+                        average = averages.emplace(marker.name, pass.milliseconds).first;
+                    }
+                    average->second += (pass.milliseconds - average->second) / 32.;
+                    pass.average = average->second;
+
+                    if (marker.statistics >= 0) {
+                        uint64_t const* counted = counts.data() + size_t(marker.statistics) * statisticCount;
+                        pass.statistics = true;
+                        pass.vertices = counted[0];
+                        pass.primitives = counted[1];
+                        pass.fragments = counted[2];
+                        pass.computes = counted[3];
+                    }
+                    passes.push_back(pass);
+                    if (tracing and events.size() < maxEvents) {
+                        events.push_back({ pass, ticks[2 * i] & mask });
+                    }
+                }
+            }
+        }
+        frame.clear();
+        statisticsUsed[slot] = 0;
+        vkResetQueryPool(GPU::device, timestamps[slot], 0, maxScopes * 2);
+        if (statistics[slot] != VK_NULL_HANDLE) {
+            vkResetQueryPool(GPU::device, statistics[slot], 0, maxScopes);
+        }
+    }
+    std::string Profiler::report() {
+        std::string text;
+        for (Pass const& pass : passes) {
+            std::string name = std::string(size_t(pass.depth) * 2, ' ') + pass.name;
+            text += std::format("  {:<24} {:8.3f} ms  (average {:8.3f} ms)", name, pass.milliseconds, pass.average);
+            if (pass.statistics) {
+                text += std::format("  vertices {:>10}  primitives {:>10}  fragments {:>12}  compute {:>10}",
+                    pass.vertices, pass.primitives, pass.fragments, pass.computes);
+            }
+            text += '\n';
+        }
+        return text;
+    }
+    void Profiler::trace(bool on) {
+        tracing = on;
+        if (!on) {
+            events.clear();
+        }
+    }
+    void Profiler::writeTrace(std::filesystem::path const& path)
+    {// Complete events in microseconds from the first, all on the one queue this engine submits to
+        std::ofstream file(path);
+        if (!file) {
+            throw std::runtime_error("failed to open " + path.string() + " for writing!");
+        }
+        auto escape = [](std::string_view name) {
+            std::string escaped;
+            for (char c : name) {
+                if (c == '"' or c == '\\') {
+                    escaped += '\\';
+                }
+                escaped += c;
+            }
+            return escaped;
+        };
+        uint64_t origin = events.empty() ? 0 : std::min_element(events.begin(), events.end(),
+            [](Event const& a, Event const& b) { return a.begin < b.begin; })->begin;
+
+        file << "{\"traceEvents\":[\n";
+        file << R"({"name":"thread_name","ph":"M","pid":1,"tid":1,"args":{"name":"GPU queue"}})";
+        for (Event const& event : events) {
+            Pass const& pass = event.pass;
+            file << std::format(",\n{{\"name\":\"{}\",\"cat\":\"gpu\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":{:.3f},\"dur\":{:.3f}",
+                escape(pass.name), static_cast<double>(event.begin - origin) * period * 1e-3, pass.milliseconds * 1e3);
+            if (pass.statistics) {
+                file << std::format(",\"args\":{{\"vertices\":{},\"primitives\":{},\"fragments\":{},\"compute\":{}}}",
+                    pass.vertices, pass.primitives, pass.fragments, pass.computes);
+            }
+            file << '}';
+        }
+        file << "\n],\"displayTimeUnit\":\"ms\"}\n";
+    }
+    void Profiler::destroy() {
+        for (uint32_t slot = 0; slot < MAX_FRAMES_IN_FLIGHT; slot++) {
+            vkDestroyQueryPool(GPU::device, timestamps[slot], nullptr);
+            vkDestroyQueryPool(GPU::device, statistics[slot], nullptr);
+            timestamps[slot] = VK_NULL_HANDLE;
+            statistics[slot] = VK_NULL_HANDLE;
+            markers[slot].clear();
+        }
+    }
+    /* Private */
+    bool Profiler::create()
+    {// On first use; off for good where the graphics queue has no timestamps
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(GPU::physicalDevice, &properties);
+        uint32_t familyCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(GPU::physicalDevice, &familyCount, nullptr);
+        std::vector<VkQueueFamilyProperties> families(familyCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(GPU::physicalDevice, &familyCount, families.data());
+
+        uint32_t validBits = families[GPU::graphicsFamily.value()].timestampValidBits;
+        if (validBits == 0) {
+            enabled = false;
+            return false;
+        }
+        mask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+        period = properties.limits.timestampPeriod;
+
+        VkQueryPoolCreateInfo timestampInfo
+        { VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO };
+        timestampInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        timestampInfo.queryCount = maxScopes * 2;
+
+        VkQueryPoolCreateInfo statisticsInfo
+        { VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO };
+        statisticsInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+        statisticsInfo.queryCount = maxScopes;
+        statisticsInfo.pipelineStatistics = statisticFlags;
+
+        for (uint32_t slot = 0; slot < MAX_FRAMES_IN_FLIGHT; slot++) {
+            VK_CHECK_RESULT(vkCreateQueryPool(GPU::device, &timestampInfo, nullptr, &timestamps[slot]));
+            vkResetQueryPool(GPU::device, timestamps[slot], 0, timestampInfo.queryCount);
+            if (GPU::pipelineStatistics) {
+                VK_CHECK_RESULT(vkCreateQueryPool(GPU::device, &statisticsInfo, nullptr, &statistics[slot]));
+                vkResetQueryPool(GPU::device, statistics[slot], 0, statisticsInfo.queryCount);
+            }
+        }
+        return true;
+    }
+    uint32_t Profiler::begin(char const* name) {
+        uint32_t slot = SwapChain::currentFrame;
+        if (!enabled or commandBuffer == VK_NULL_HANDLE or markers[slot].size() >= maxScopes) {
+            return UINT32_MAX;
+        }
+        if (timestamps[slot] == VK_NULL_HANDLE and !create()) {
+            return UINT32_MAX;
+        }
+        uint32_t marker = static_cast<uint32_t>(markers[slot].size());
+        int32_t query = -1;
+        if (statistics[slot] != VK_NULL_HANDLE and !statisticsOpen) {
+            query = static_cast<int32_t>(statisticsUsed[slot]++);
+            vkCmdBeginQuery(commandBuffer, statistics[slot], static_cast<uint32_t>(query), 0);
+            statisticsOpen = true;
+        }
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestamps[slot], marker * 2);
+        markers[slot].push_back({ name, depth++, query });
+        return marker;
+    }
+    void Profiler::end(uint32_t marker) {
+        if (marker == UINT32_MAX) {
+            return;
+        }
+        uint32_t slot = SwapChain::currentFrame;
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestamps[slot], marker * 2 + 1);
+        if (markers[slot][marker].statistics >= 0) {
+            vkCmdEndQuery(commandBuffer, statistics[slot], static_cast<uint32_t>(markers[slot][marker].statistics));
+            statisticsOpen = false;
+        }
+        depth--;
+    }
+}
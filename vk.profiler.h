@@ -0,0 +1,87 @@
+#pragma once
+#ifndef hProfiler
+#define hProfiler
+
+#include "vk.gpu.h"
+
+#include <array>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+// Times the rest of the enclosing block on the GPU, in the command buffer last given to Profiler::record
+#define PROFILE_GPU_JOIN(a, b) a##b
+#define PROFILE_GPU_SCOPE(line) PROFILE_GPU_JOIN(profileScope, line)
+#define PROFILE_GPU(name) vk::Profiler::Scope PROFILE_GPU_SCOPE(__LINE__)(name)
+
+namespace vk {
+    struct Profiler
+    {// Timestamps around marked scopes, and pipeline statistics for the outermost ones, in query pools per frame in flight;
+     // a slot's results are read once its fences have passed, which Engine::run waits for only while scopes were recorded
+    public:
+        struct Pass {
+            char const* name;
+            uint32_t depth;                 // Scopes open around it
+            double milliseconds = 0.;
+            double average = 0.;            // Exponential, over about the last 32 frames
+            bool statistics = false;        // The counts are valid: an outermost scope, on a device with the queries
+            uint64_t vertices = 0;          // Vertex shader invocations
+            uint64_t primitives = 0;        // Out of clipping
+            uint64_t fragments = 0;         // Fragment shader invocations
+            uint64_t computes = 0;          // Compute shader invocations
+        };
+        struct Scope {
+            Scope(char const* name);        // A literal, or anything else that outlives the frame's results
+            ~Scope();
+            Scope(Scope const&) = delete;
+            Scope& operator=(Scope const&) = delete;
+        private:
+            uint32_t marker;
+        };
+        inline static bool enabled = false;     // While on, each frame waits for its slot's last graphics submission before compute
+        inline static constexpr uint32_t maxScopes = 64;    // A frame's; later ones go unmeasured
+
+        static void record(VkCommandBuffer commandBuffer);  // Scopes from here on are written into this command buffer
+        // Once the fences of this frame slot have been waited on: its results replace results(), and its queries are reset
+        static void collect(uint32_t slot);
+        static bool recorded(uint32_t slot) { return !markers[slot].empty(); }    // collect has results to wait for
+        static std::vector<Pass> const& results() { return passes; }
+        static std::string report();        // results() as a table
+        // While on, every frame's passes are kept for writeTrace; turning it off drops them
+        static void trace(bool on);
+        static void writeTrace(std::filesystem::path const& path);  // Chrome trace event JSON, for chrome://tracing or Perfetto
+        static void destroy();
+    private:
+        struct Marker {
+            char const* name;
+            uint32_t depth;
+            int32_t statistics;             // Query index, or -1 without one
+        };
+        struct Event {
+            Pass pass;
+            uint64_t begin;                 // Ticks
+        };
+        inline static std::array<VkQueryPool, MAX_FRAMES_IN_FLIGHT> timestamps{};
+        inline static std::array<VkQueryPool, MAX_FRAMES_IN_FLIGHT> statistics{};
+        inline static std::array<std::vector<Marker>, MAX_FRAMES_IN_FLIGHT> markers;
+        inline static std::array<uint32_t, MAX_FRAMES_IN_FLIGHT> statisticsUsed{};
+        inline static VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+        inline static uint32_t depth = 0;
+        inline static bool statisticsOpen = false;  // Statistics queries cannot nest
+        inline static double period = 1.;           // Nanoseconds per tick
+        inline static uint64_t mask = ~0ull;        // Of the bits timestamps count in
+
+        inline static std::vector<Pass> passes;
+        inline static std::map<std::string, double, std::less<>> averages;
+        inline static bool tracing = false;
+        inline static std::vector<Event> events;
+
+        static bool create();
+        static uint32_t begin(char const* name);
+        static void end(uint32_t marker);
+    };
+}
+
+#endif
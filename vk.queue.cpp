@@ -0,0 +1,193 @@
+#include "vk.queue.h"
+#include "vk.pipeline.h"
+#include "Mesh.h"
+
+#include <array>
+#include <numeric>
+
+namespace vk {
+    /* Render State */
+    void RenderState::reset()
+    {// A new command buffer starts with nothing bound
+        lastFrame = binds;
+        binds = {};
+        layout = VK_NULL_HANDLE;
+        pipeline = VK_NULL_HANDLE;
+        setLayouts.clear();
+        pushRanges.clear();
+        boundLayouts.clear();
+        boundSets.clear();
+        vertexBuffers.clear();
+        vertexOffsets.clear();
+        indexBuffer = VK_NULL_HANDLE;
+        drawStateSet = false;
+    }
+    void RenderState::bindPipeline(VkCommandBuffer& commandBuffer, VkPipeline newPipeline, VkPipelineLayout pipelineLayout, std::vector<VkDescriptorSetLayout> const& pipelineSetLayouts, std::vector<VkPushConstantRange> const& pipelinePushRanges) {
+        if (newPipeline == pipeline) {
+            binds.skipped++;
+            return;
+        }
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, newPipeline);
+        pipeline = newPipeline;
+        layout = pipelineLayout;
+        setLayouts = pipelineSetLayouts;
+        // Layouts with different push constant ranges share no set bindings
+        if (!std::equal(pipelinePushRanges.begin(), pipelinePushRanges.end(), pushRanges.begin(), pushRanges.end(), [](VkPushConstantRange const& a, VkPushConstantRange const& b) {
+            return a.stageFlags == b.stageFlags and a.offset == b.offset and a.size == b.size; })) {
+            pushRanges = pipelinePushRanges;
+            boundSets.clear();
+            boundLayouts.clear();
+        }
+        binds.pipelines++;
+    }
+    void RenderState::bindDescriptorSets(VkCommandBuffer& commandBuffer, uint32_t firstSet, uint32_t setCount, VkDescriptorSet const* sets) {
+        uint32_t end = firstSet + setCount;
+        if (boundSets.size() < end) {
+            boundSets.resize(end, VK_NULL_HANDLE);
+            boundLayouts.resize(end, VK_NULL_HANDLE);
+        }
+        // A bound set survives a layout change only while every set layout up to it is identical
+        uint32_t first = 0;
+        while (first < end and first < setLayouts.size() and boundLayouts[first] == setLayouts[first]
+            and (first < firstSet or boundSets[first] == sets[first - firstSet])) {
+            first++;
+        }
+        first = std::max(first, firstSet);
+        binds.skipped += first - firstSet;
+        if (first == end) {
+            return;
+        }
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, first, end - first, sets + (first - firstSet), 0, nullptr);
+        binds.descriptorSets += end - first;
+
+        for (uint32_t i = first; i < end; i++) {
+            boundSets[i] = sets[i - firstSet];
+            boundLayouts[i] = i < setLayouts.size() ? setLayouts[i] : VK_NULL_HANDLE;
+        }
+        // Sets above were bound against the old prefix and can no longer be trusted
+        boundSets.resize(end);
+        boundLayouts.resize(end);
+    }
+    void RenderState::bindVertexBuffers(VkCommandBuffer& commandBuffer, uint32_t bufferCount, VkBuffer const* buffers, VkDeviceSize const* offsets) {
+        if (vertexBuffers.size() == bufferCount
+            and std::equal(buffers, buffers + bufferCount, vertexBuffers.begin())
+            and std::equal(offsets, offsets + bufferCount, vertexOffsets.begin())) {
+            binds.skipped++;
+            return;
+        }
+        vkCmdBindVertexBuffers(commandBuffer, 0, bufferCount, buffers, offsets);
+        vertexBuffers.assign(buffers, buffers + bufferCount);
+        vertexOffsets.assign(offsets, offsets + bufferCount);
+        binds.vertexBuffers++;
+    }
+    void RenderState::bindIndexBuffer(VkCommandBuffer& commandBuffer, VkBuffer buffer, VkIndexType type) {
+        if (buffer == indexBuffer and type == indexType) {
+            binds.skipped++;
+            return;
+        }
+        vkCmdBindIndexBuffer(commandBuffer, buffer, 0, type);
+        indexBuffer = buffer;
+        indexType = type;
+        binds.indexBuffers++;
+    }
+    bool RenderState::pushConstants(VkCommandBuffer& commandBuffer, VkPushConstantRange const& range, void const* data)
+    {// Only when the bound layout declares the range; a pipeline without it reads its data elsewhere
+        bool declared = std::any_of(pushRanges.begin(), pushRanges.end(), [&](VkPushConstantRange const& bound) {
+            return bound.stageFlags == range.stageFlags and bound.offset <= range.offset and range.offset + range.size <= bound.offset + bound.size; });
+        if (!declared) {
+            return false;
+        }
+        vkCmdPushConstants(commandBuffer, layout, range.stageFlags, range.offset, range.size, data);
+        binds.pushConstants++;
+        return true;
+    }
+    void RenderState::setDrawState(VkCommandBuffer& commandBuffer, DrawState const& state)
+    {// Every graphics pipeline declares this state dynamic, so what was set carries across pipeline binds
+        uint32_t before = binds.states;
+        if (GPU::dynamicSampleCount and !drawStateSet) {
+            // Not per draw: the same for every pass of the frame
+            GPU::vkCmdSetRasterizationSamplesEXT(commandBuffer, GPU::msaaSamples);
+            binds.states++;
+        }
+        if (GPU::dynamicPolygonMode and (!drawStateSet or state.polygonMode != drawState.polygonMode)) {
+            GPU::vkCmdSetPolygonModeEXT(commandBuffer, state.polygonMode);
+            binds.states++;
+        }
+        if (!drawStateSet or state.cullMode != drawState.cullMode) {
+            vkCmdSetCullMode(commandBuffer, state.cullMode);
+            binds.states++;
+        }
+        if (!drawStateSet or state.topology != drawState.topology) {
+            vkCmdSetPrimitiveTopology(commandBuffer, state.topology);
+            binds.states++;
+        }
+        if (!drawStateSet or state.depthTest != drawState.depthTest) {
+            vkCmdSetDepthTestEnable(commandBuffer, state.depthTest);
+            binds.states++;
+        }
+        if (!drawStateSet or state.depthWrite != drawState.depthWrite) {
+            vkCmdSetDepthWriteEnable(commandBuffer, state.depthWrite);
+            binds.states++;
+        }
+        if (binds.states == before) {
+            binds.skipped++;
+        }
+        drawState = state;
+        drawStateSet = true;
+    }
+
+    /* Render Queue */
+    void RenderQueue::submit(Pipeline& pipeline, Drawable& drawable, Pass pass) {
+        std::vector<VkDescriptorSet> const& sets = pipeline.currentSets();
+        VkDescriptorSet material = sets.empty() ? VK_NULL_HANDLE : sets.back();
+        uint32_t materialId = materials.try_emplace(material, static_cast<uint32_t>(materials.size())).first->second;
+        uint32_t meshId = meshes.try_emplace(&drawable, static_cast<uint32_t>(meshes.size())).first->second;
+
+        items.push_back({ sortKey(pass, pipeline.id, materialId, meshId, quantizeDepth(drawable)), &pipeline, &drawable });
+    }
+    void RenderQueue::flush() {
+        sort();
+        for (Item& item : items) {
+            item.pipeline->bind();
+            item.drawable->draw();
+            RenderState::binds.draws++;
+        }
+        items.clear();
+    }
+    uint64_t RenderQueue::sortKey(Pass pass, uint32_t pipeline, uint32_t material, uint32_t mesh, uint16_t depth)
+    {// [pass:4][pipeline:12][material:16][mesh:16][depth:16]; transparent draws move depth, inverted, ahead of state
+        uint64_t state = (uint64_t(pipeline & 0xFFF) << 32) | (uint64_t(material & 0xFFFF) << 16) | uint64_t(mesh & 0xFFFF);
+        if (pass == Transparent) {
+            return (uint64_t(pass) << 60) | (uint64_t(uint16_t(~depth)) << 44) | state;
+        }
+        return (uint64_t(pass) << 60) | (state << 16) | depth;
+    }
+    /* Private */
+    uint16_t RenderQueue::quantizeDepth(Drawable const& drawable) const
+    {// Log-scaled distance to the nearest point of the drawable's bounds; 2^20 units saturate
+        glm::vec4 sphere = drawable.sphere();
+        if (viewer == nullptr or sphere.w <= 0.f) {
+            return 0;
+        }
+        float distance = std::max(glm::distance(glm::vec3(sphere), viewer->position) - sphere.w, 0.f);
+        return static_cast<uint16_t>(std::min(std::log2(distance + 1.f) / 20.f, 1.f) * 65535.f);
+    }
+    void RenderQueue::sort()
+    {// LSD radix sort on 8-bit digits; digits every key shares are skipped
+        scratch.resize(items.size());
+        for (uint32_t shift = 0; shift < 64; shift += 8) {
+            std::array<uint32_t, 257> offsets{};
+            for (Item const& item : items) {
+                offsets[((item.key >> shift) & 0xFF) + 1]++;
+            }
+            if (std::find(offsets.begin(), offsets.end(), static_cast<uint32_t>(items.size())) != offsets.end()) {
+                continue;
+            }
+            std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+            for (Item const& item : items) {
+                scratch[offsets[(item.key >> shift) & 0xFF]++] = item;
+            }
+            items.swap(scratch);
+        }
+    }
+}
@@ -0,0 +1,88 @@
+#pragma once
+#ifndef hQueue
+#define hQueue
+
+#include "vk.cpu.h"
+
+#include <unordered_map>
+
+namespace vk {
+    struct Camera;
+    struct Pipeline;
+    struct Drawable;
+
+    struct DrawState
+    {// Rasterization and depth state set while recording instead of baked into the pipeline
+        VkPolygonMode polygonMode = VK_POLYGON_MODE_FILL;   // Baked instead without VK_EXT_extended_dynamic_state3
+        VkCullModeFlags cullMode = VK_CULL_MODE_BACK_BIT;
+        VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;   // Within the class the pipeline was built with
+        VkBool32 depthTest = VK_TRUE;
+        VkBool32 depthWrite = VK_TRUE;
+    };
+
+    struct RenderState
+    {// What this frame's render commands have bound; redundant binds are skipped and the rest are counted
+        struct Counters {
+            uint32_t pipelines = 0;
+            uint32_t descriptorSets = 0;
+            uint32_t vertexBuffers = 0;
+            uint32_t indexBuffers = 0;
+            uint32_t pushConstants = 0;
+            uint32_t states = 0;    // Dynamic state commands
+            uint32_t skipped = 0;   // Binds that matched what was already bound
+            uint32_t draws = 0;
+        };
+        inline static Counters binds;           // This frame so far
+        inline static Counters lastFrame;       // Totals of the previous frame
+        inline static VkPipelineLayout layout = VK_NULL_HANDLE;
+
+        static void reset();
+        static void bindPipeline(VkCommandBuffer& commandBuffer, VkPipeline pipeline, VkPipelineLayout pipelineLayout, std::vector<VkDescriptorSetLayout> const& pipelineSetLayouts, std::vector<VkPushConstantRange> const& pipelinePushRanges = {});
+        static void bindDescriptorSets(VkCommandBuffer& commandBuffer, uint32_t firstSet, uint32_t setCount, VkDescriptorSet const* sets);
+        static void bindVertexBuffers(VkCommandBuffer& commandBuffer, uint32_t bufferCount, VkBuffer const* buffers, VkDeviceSize const* offsets);
+        static void bindIndexBuffer(VkCommandBuffer& commandBuffer, VkBuffer buffer, VkIndexType indexType);
+        static bool pushConstants(VkCommandBuffer& commandBuffer, VkPushConstantRange const& range, void const* data);
+        static void setDrawState(VkCommandBuffer& commandBuffer, DrawState const& state);
+    private:
+        inline static VkPipeline pipeline = VK_NULL_HANDLE;
+        inline static std::vector<VkDescriptorSetLayout> setLayouts;    // Set layouts of the bound pipeline's layout
+        inline static std::vector<VkPushConstantRange> pushRanges;      // Push constant ranges of the bound pipeline's layout
+        inline static std::vector<VkDescriptorSetLayout> boundLayouts;  // Set layout each bound set was bound against
+        inline static std::vector<VkDescriptorSet> boundSets;
+        inline static std::vector<VkBuffer> vertexBuffers;
+        inline static std::vector<VkDeviceSize> vertexOffsets;
+        inline static VkBuffer indexBuffer = VK_NULL_HANDLE;
+        inline static VkIndexType indexType = VK_INDEX_TYPE_UINT16;
+        inline static DrawState drawState;
+        inline static bool drawStateSet = false;    // Dynamic state is undefined in a new command buffer
+    };
+
+    struct RenderQueue
+    {// Draws gathered under 64-bit sort keys, radix-sorted each frame and recorded with redundant binds skipped
+        enum Pass : uint64_t {
+            Opaque,         // Grouped by state, then front to back
+            Transparent,    // Back to front, then grouped by state
+            Overlay
+        };
+        inline static Camera const* viewer = nullptr;   // Without one every draw sorts at depth 0
+
+        void submit(Pipeline& pipeline, Drawable& drawable, Pass pass = Opaque);
+        void flush();
+        static uint64_t sortKey(Pass pass, uint32_t pipeline, uint32_t material, uint32_t mesh, uint16_t depth);
+    private:
+        struct Item {
+            uint64_t key;
+            Pipeline* pipeline;
+            Drawable* drawable;
+        };
+        std::vector<Item> items;
+        std::vector<Item> scratch;
+        std::unordered_map<VkDescriptorSet, uint32_t> materials;    // Stable ids for descriptor sets, in first-seen order
+        std::unordered_map<Drawable const*, uint32_t> meshes;       // Stable ids for drawables, in first-seen order
+
+        uint16_t quantizeDepth(Drawable const& drawable) const;
+        void sort();
+    };
+}
+
+#endif
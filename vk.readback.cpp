@@ -0,0 +1,354 @@
+#include "vk.readback.h"
+#include "vk.textures.h"
+
+#include <stb_image.h>
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <format>
+#include <fstream>
+#include <limits>
+#include <memory>
+
+namespace vk {
+    Readback::Readback(VkDeviceSize slotSize) : slotSize(slotSize) {
+        worker = std::jthread([this](std::stop_token stop) {
+            while (true) {
+                std::function<void()> job;
+                {
+                    std::unique_lock lock(mutex);
+                    if (!wake.wait(lock, stop, [this] { return !jobs.empty(); })) {
+                        return;
+                    }
+                    job = std::move(jobs.front());
+                    jobs.pop_front();
+                    running++;
+                }
+                job();
+                {
+                    std::lock_guard lock(mutex);
+                    running--;
+                }
+                wake.notify_all();
+            }
+        });
+    }
+    Readback::~Readback() {
+        // The worker finishes the capture it is on; the rest are dropped with the queue
+        worker.request_stop();
+        worker.join();
+        for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+            if (buffers[i]) {
+                vkUnmapMemory(GPU::device, buffers[i]->memory);
+                delete buffers[i];
+            }
+        }
+    }
+    /* Public */
+    bool Readback::capture(VkCommandBuffer& commandBuffer, VkImage image, VkFormat format, VkExtent2D extent, VkImageLayout layout,
+        VkPipelineStageFlags stage, VkAccessFlags access, Callback done)
+    {
+        uint32_t slot = SwapChain::currentFrame;
+        VkDeviceSize size = VkDeviceSize(extent.width) * extent.height * texelSize(format);
+        VkDeviceSize offset = (heads[slot] + 15) / 16 * 16;
+        if (size > slotSize or offset + size > slotSize) {
+            return false;
+        }
+        if (!buffers[slot]) {
+            // Cached where the device has it, as the host reads every byte back
+            try {
+                buffers[slot] = new Buffer(slotSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+            }
+            catch (std::runtime_error const&) {
+                buffers[slot] = new Buffer(slotSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+            }
+            void* data;
+            VK_CHECK_RESULT(vkMapMemory(GPU::device, buffers[slot]->memory, 0, slotSize, 0, &data));
+            mapped[slot] = static_cast<uint8_t*>(data);
+        }
+        heads[slot] = offset + size;
+
+        VkImageMemoryBarrier barrier
+        { VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+        barrier.srcAccessMask = access;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        barrier.oldLayout = layout;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = image;
+        barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+        vkCmdPipelineBarrier(commandBuffer, stage, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+        VkBufferImageCopy region{};
+        region.bufferOffset = offset;
+        region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+        region.imageExtent = { extent.width, extent.height, 1 };
+        vkCmdCopyImageToBuffer(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, buffers[slot]->buffer, 1, &region);
+
+        // Back as it was, for whatever the image was headed to; the copy is visible to the host once the fence signals
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        barrier.dstAccessMask = access;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        barrier.newLayout = layout;
+        VkMemoryBarrier hostBarrier
+        { VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+        hostBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        hostBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, stage | VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &hostBarrier, 0, nullptr, 1, &barrier);
+
+        pending[slot].push_back({ offset, { format, extent, {} }, std::move(done) });
+        return true;
+    }
+    void Readback::collect(uint32_t slot) {
+        if (pending[slot].empty()) {
+            heads[slot] = 0;
+            return;
+        }
+        // Copied out here so the region is free for this frame's captures; the worker gets the rest
+        std::vector<Pending> ready = std::move(pending[slot]);
+        pending[slot].clear();
+        heads[slot] = 0;
+        for (Pending& capture : ready) {
+            VkDeviceSize size = VkDeviceSize(capture.capture.extent.width) * capture.capture.extent.height * texelSize(capture.capture.format);
+            capture.capture.texels.assign(mapped[slot] + capture.offset, mapped[slot] + capture.offset + size);
+        }
+        {
+            std::lock_guard lock(mutex);
+            for (Pending& capture : ready) {
+                jobs.push_back([capture = std::make_shared<Pending>(std::move(capture))] { capture->done(capture->capture); });
+            }
+        }
+        wake.notify_all();
+    }
+    void Readback::flush() {
+        vkDeviceWaitIdle(GPU::device);
+        for (uint32_t slot = 0; slot < MAX_FRAMES_IN_FLIGHT; slot++) {
+            collect(slot);
+        }
+        std::unique_lock lock(mutex);
+        wake.wait(lock, [this] { return jobs.empty() and running == 0; });
+    }
+    void Readback::writePNG(std::filesystem::path const& path, Capture const& capture) {
+        std::vector<uint8_t> rgba = capture.rgba8();
+        if (!stbi_write_png(path.string().c_str(), static_cast<int>(capture.extent.width), static_cast<int>(capture.extent.height), 4,
+            rgba.data(), static_cast<int>(capture.extent.width * 4))) {
+            throw std::runtime_error("failed to write " + path.string() + "!");
+        }
+    }
+    void Readback::writeEXR(std::filesystem::path const& path, Capture const& capture)
+    {// Scanline file, one line per block, channels in the alphabetical order the format asks for
+        std::vector<float> rgba = capture.rgba32f();
+        int32_t width = static_cast<int32_t>(capture.extent.width);
+        int32_t height = static_cast<int32_t>(capture.extent.height);
+
+        std::vector<uint8_t> header;
+        auto put = [&header](void const* data, size_t size) {
+            header.insert(header.end(), static_cast<uint8_t const*>(data), static_cast<uint8_t const*>(data) + size); };
+        auto text = [&put](char const* string) { put(string, strlen(string) + 1); };
+        auto i32 = [&put](int32_t value) { put(&value, sizeof(value)); };
+        auto f32 = [&put](float value) { put(&value, sizeof(value)); };
+        auto attribute = [&](char const* name, char const* type, int32_t size) { text(name); text(type); i32(size); };
+
+        i32(20000630);      // Magic
+        i32(2);             // Version 2, single-part scanline
+        attribute("channels", "chlist", 4 * 18 + 1);
+        for (char const* channel : { "A", "B", "G", "R" }) {
+            text(channel);
+            i32(2);         // FLOAT
+            i32(0);         // pLinear and reserved
+            i32(1);         // x and y sampling
+            i32(1);
+        }
+        header.push_back(0);
+        attribute("compression", "compression", 1);
+        header.push_back(0);    // NO_COMPRESSION
+        for (char const* window : { "dataWindow", "displayWindow" }) {
+            attribute(window, "box2i", 16);
+            i32(0);
+            i32(0);
+            i32(width - 1);
+            i32(height - 1);
+        }
+        attribute("lineOrder", "lineOrder", 1);
+        header.push_back(0);    // INCREASING_Y
+        attribute("pixelAspectRatio", "float", 4);
+        f32(1.f);
+        attribute("screenWindowCenter", "v2f", 8);
+        f32(0.f);
+        f32(0.f);
+        attribute("screenWindowWidth", "float", 4);
+        f32(1.f);
+        header.push_back(0);
+
+        int32_t lineBytes = width * 4 * static_cast<int32_t>(sizeof(float));
+        uint64_t offset = header.size() + uint64_t(height) * sizeof(uint64_t);
+        for (int32_t y = 0; y < height; y++) {
+            put(&offset, sizeof(offset));
+            offset += 8 + lineBytes;
+        }
+        std::ofstream file(path, std::ios::binary);
+        if (!file) {
+            throw std::runtime_error("failed to write " + path.string() + "!");
+        }
+        file.write(reinterpret_cast<char const*>(header.data()), header.size());
+        std::vector<float> line(size_t(width) * 4);
+        for (int32_t y = 0; y < height; y++) {
+            float const* row = rgba.data() + size_t(y) * width * 4;
+            for (int32_t channel = 0; channel < 4; channel++) {
+                for (int32_t x = 0; x < width; x++) {
+                    line[size_t(channel) * width + x] = row[size_t(x) * 4 + (3 - channel)];
+                }
+            }
+            file.write(reinterpret_cast<char const*>(&y), sizeof(y));
+            file.write(reinterpret_cast<char const*>(&lineBytes), sizeof(lineBytes));
+            file.write(reinterpret_cast<char const*>(line.data()), lineBytes);
+        }
+        if (!file) {
+            throw std::runtime_error("failed to write " + path.string() + "!");
+        }
+    }
+    Readback::Comparison Readback::compare(std::vector<uint8_t> const& rgba, std::vector<uint8_t> const& golden, uint32_t width, uint32_t height, std::vector<uint8_t>* diff) {
+        static std::array<double, 256> const linear = [] {
+            std::array<double, 256> table{};
+            for (uint32_t i = 0; i < 256; i++) {
+                double c = i / 255.;
+                table[i] = c <= 0.04045 ? c / 12.92 : std::pow((c + 0.055) / 1.055, 2.4);
+            }
+            return table;
+        }();
+        auto lab = [](uint8_t const* texel, double out[3]) {
+            double r = linear[texel[0]], g = linear[texel[1]], b = linear[texel[2]];
+            // sRGB primaries to XYZ, relative to the D65 white point
+            double xyz[3] = {
+                (0.4124564 * r + 0.3575761 * g + 0.1804375 * b) / 0.95047,
+                (0.2126729 * r + 0.7151522 * g + 0.0721750 * b),
+                (0.0193339 * r + 0.1191920 * g + 0.9503041 * b) / 1.08883
+            };
+            for (double& t : xyz) {
+                t = t > 216. / 24389. ? std::cbrt(t) : (24389. / 27. * t + 16.) / 116.;
+            }
+            out[0] = 116. * xyz[1] - 16.;
+            out[1] = 500. * (xyz[0] - xyz[1]);
+            out[2] = 200. * (xyz[1] - xyz[2]);
+        };
+        size_t pixels = size_t(width) * height;
+        if (rgba.size() != pixels * 4 or golden.size() != pixels * 4 or pixels == 0) {
+            throw std::runtime_error("compared images differ in size!");
+        }
+        if (diff) {
+            diff->resize(pixels * 4);
+        }
+        double squared = 0., deltaSum = 0.;
+        size_t perceptible = 0;
+        for (size_t i = 0; i < pixels; i++) {
+            uint8_t const* a = rgba.data() + i * 4;
+            uint8_t const* b = golden.data() + i * 4;
+            for (int c = 0; c < 3; c++) {
+                double d = double(a[c]) - double(b[c]);
+                squared += d * d;
+            }
+            double labA[3], labB[3];
+            lab(a, labA);
+            lab(b, labB);
+            double deltaE = std::sqrt((labA[0] - labB[0]) * (labA[0] - labB[0]) + (labA[1] - labB[1]) * (labA[1] - labB[1]) + (labA[2] - labB[2]) * (labA[2] - labB[2]));
+            deltaSum += deltaE;
+            perceptible += deltaE > 2.3;
+            if (diff) {
+                // The golden image dimmed to grey, with differences in red by how visible they are
+                uint8_t grey = static_cast<uint8_t>(labB[0] * 0.3 * 2.55);
+                uint8_t* out = diff->data() + i * 4;
+                out[0] = static_cast<uint8_t>(std::min(255., grey + deltaE * 25.));
+                out[1] = grey;
+                out[2] = grey;
+                out[3] = 255;
+            }
+        }
+        Comparison comparison;
+        double mse = squared / (pixels * 3.);
+        comparison.psnr = mse == 0. ? std::numeric_limits<double>::infinity() : 10. * std::log10(255. * 255. / mse);
+        comparison.meanDeltaE = deltaSum / pixels;
+        comparison.perceptible = double(perceptible) / pixels;
+        return comparison;
+    }
+    Readback::Comparison Readback::compare(Capture const& capture, std::filesystem::path const& golden, std::filesystem::path const& diff) {
+        int width, height, channels;
+        uint8_t* pixels = loadPixels(golden.string(), width, height, channels);
+        if (!pixels) {
+            throw std::runtime_error("failed to load golden image " + golden.string() + "!");
+        }
+        std::vector<uint8_t> reference(pixels, pixels + size_t(width) * height * 4);
+        stbi_image_free(pixels);
+        if (uint32_t(width) != capture.extent.width or uint32_t(height) != capture.extent.height) {
+            throw std::runtime_error(std::format("golden image {} is {}x{}, the capture {}x{}!", golden.string(), width, height, capture.extent.width, capture.extent.height));
+        }
+        std::vector<uint8_t> picture;
+        Comparison comparison = compare(capture.rgba8(), reference, capture.extent.width, capture.extent.height, diff.empty() ? nullptr : &picture);
+        if (!diff.empty() and !stbi_write_png(diff.string().c_str(), width, height, 4, picture.data(), width * 4)) {
+            throw std::runtime_error("failed to write " + diff.string() + "!");
+        }
+        return comparison;
+    }
+    uint32_t Readback::texelSize(VkFormat format) {
+        switch (format) {
+        case VK_FORMAT_R8G8B8A8_UNORM:
+        case VK_FORMAT_R8G8B8A8_SRGB:
+        case VK_FORMAT_B8G8R8A8_UNORM:
+        case VK_FORMAT_B8G8R8A8_SRGB:
+        case VK_FORMAT_R32_SFLOAT:
+            return 4;
+        case VK_FORMAT_R32G32B32A32_SFLOAT:
+            return 16;
+        default:
+            throw std::runtime_error(std::format("Readback cannot convert format {}!", static_cast<int>(format)));
+        }
+    }
+    /* Capture */
+    std::vector<uint8_t> Readback::Capture::rgba8() const {
+        size_t pixels = size_t(extent.width) * extent.height;
+        std::vector<uint8_t> rgba(pixels * 4);
+        if (format == VK_FORMAT_R32_SFLOAT or format == VK_FORMAT_R32G32B32A32_SFLOAT) {
+            std::vector<float> values = rgba32f();
+            for (size_t i = 0; i < values.size(); i++) {
+                rgba[i] = static_cast<uint8_t>(std::lround(std::clamp(values[i], 0.f, 1.f) * 255.f));
+            }
+            return rgba;
+        }
+        texelSize(format);
+        bool bgra = format == VK_FORMAT_B8G8R8A8_UNORM or format == VK_FORMAT_B8G8R8A8_SRGB;
+        for (size_t i = 0; i < pixels; i++) {
+            uint8_t const* in = texels.data() + i * 4;
+            uint8_t* out = rgba.data() + i * 4;
+            out[0] = in[bgra ? 2 : 0];
+            out[1] = in[1];
+            out[2] = in[bgra ? 0 : 2];
+            out[3] = in[3];
+        }
+        return rgba;
+    }
+    std::vector<float> Readback::Capture::rgba32f() const {
+        size_t pixels = size_t(extent.width) * extent.height;
+        std::vector<float> rgba(pixels * 4);
+        if (format == VK_FORMAT_R32G32B32A32_SFLOAT) {
+            memcpy(rgba.data(), texels.data(), rgba.size() * sizeof(float));
+        }
+        else if (format == VK_FORMAT_R32_SFLOAT) {
+            float const* values = reinterpret_cast<float const*>(texels.data());
+            for (size_t i = 0; i < pixels; i++) {
+                rgba[i * 4] = rgba[i * 4 + 1] = rgba[i * 4 + 2] = values[i];
+                rgba[i * 4 + 3] = 1.f;
+            }
+        }
+        else {
+            std::vector<uint8_t> bytes = rgba8();
+            for (size_t i = 0; i < bytes.size(); i++) {
+                rgba[i] = bytes[i] / 255.f;
+            }
+        }
+        return rgba;
+    }
+}
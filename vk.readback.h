@@ -0,0 +1,78 @@
+#pragma once
+#ifndef hReadback
+#define hReadback
+
+#include "vk.buffers.h"
+
+#include <array>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace vk {
+    struct Readback
+    {// Images copied into host-visible memory, a region per frame in flight, and handed to a worker thread once that frame's
+     // fence has passed, so capturing never waits on the GPU; encoding and comparing happen on the worker as well
+        Readback(VkDeviceSize slotSize = 64 << 20);
+        ~Readback();
+        Readback(Readback const&) = delete;
+        Readback& operator=(Readback const&) = delete;
+    public:
+        struct Capture {
+            VkFormat format;
+            VkExtent2D extent;
+            std::vector<uint8_t> texels;    // As copied, rows packed tight
+
+            std::vector<uint8_t> rgba8() const;     // BGRA swizzled; float formats clamped to [0, 1]
+            std::vector<float> rgba32f() const;     // 8-bit formats read as UNORM
+        };
+        struct Comparison {
+            double psnr = 0.;           // dB over RGB; infinite when identical
+            double meanDeltaE = 0.;     // CIE76 in L*a*b*, reading both as sRGB
+            double perceptible = 0.;    // Share of pixels over a deltaE of 2.3, about one just-noticeable difference
+
+            bool pass(double minPsnr = 40., double maxPerceptible = 0.001) const { return psnr >= minPsnr and perceptible <= maxPerceptible; }
+        };
+        using Callback = std::function<void(Capture&)>;     // Runs on the worker
+
+        // Records a copy of the image, which is in layout after stage and access and is left there; false when this
+        // frame's region has no room left, as the copy is dropped rather than waited for
+        bool capture(VkCommandBuffer& commandBuffer, VkImage image, VkFormat format, VkExtent2D extent, VkImageLayout layout,
+            VkPipelineStageFlags stage, VkAccessFlags access, Callback done);
+        // Once the fence of this frame slot has been waited on: its copies go to the worker
+        void collect(uint32_t slot);
+        bool recorded(uint32_t slot) const { return !pending[slot].empty(); }   // collect has copies to wait for
+        // Waits for the device and the worker, until every capture recorded so far has been handled
+        void flush();
+
+        static void writePNG(std::filesystem::path const& path, Capture const& capture);
+        static void writeEXR(std::filesystem::path const& path, Capture const& capture);    // Uncompressed 32-bit float RGBA
+        // Both RGBA8 of width x height; diff, if given, gets a picture of where they differ
+        static Comparison compare(std::vector<uint8_t> const& rgba, std::vector<uint8_t> const& golden, uint32_t width, uint32_t height, std::vector<uint8_t>* diff = nullptr);
+        // Against an image file of the same size; a diff PNG is written if a path is given
+        static Comparison compare(Capture const& capture, std::filesystem::path const& golden, std::filesystem::path const& diff = {});
+        static uint32_t texelSize(VkFormat format);     // Of the formats Capture converts; throws for others
+    private:
+        struct Pending {
+            VkDeviceSize offset;
+            Capture capture;
+            Callback done;
+        };
+        VkDeviceSize slotSize;
+        std::array<Buffer*, MAX_FRAMES_IN_FLIGHT> buffers{};    // Made on first capture
+        std::array<uint8_t*, MAX_FRAMES_IN_FLIGHT> mapped{};
+        std::array<VkDeviceSize, MAX_FRAMES_IN_FLIGHT> heads{};
+        std::array<std::vector<Pending>, MAX_FRAMES_IN_FLIGHT> pending;
+
+        std::mutex mutex;
+        std::condition_variable_any wake;
+        std::deque<std::function<void()>> jobs;
+        uint32_t running = 0;
+        std::jthread worker;    // Last, so it stops before the queue goes
+    };
+}
+
+#endif
@@ -1,10 +1,51 @@
 #include "vk.shader.h"
 
 namespace vk {
-    Shader::Shader(std::string const& filename, VkShaderStageFlagBits stage) : shaderStage(stage) {
-        checkLog(filename);
-        auto code = readFile(".\\shaders\\" + filename + ".spv");
-        createModule(code, shaderModule);
+    void Specialization::set(uint32_t constantId, uint32_t value) {
+        for (VkSpecializationMapEntry const& entry : entries) {
+            if (entry.constantID == constantId) {
+                data[entry.offset / sizeof(uint32_t)] = value;
+                return;
+            }
+        }
+        entries.push_back({ constantId, static_cast<uint32_t>(data.size() * sizeof(uint32_t)), sizeof(uint32_t) });
+        data.push_back(value);
+    }
+    bool Specialization::get(uint32_t constantId, uint32_t& value) const {
+        for (VkSpecializationMapEntry const& entry : entries) {
+            if (entry.constantID == constantId) {
+                value = data[entry.offset / sizeof(uint32_t)];
+                return true;
+            }
+        }
+        return false;
+    }
+    VkSpecializationInfo Specialization::info() const {
+        VkSpecializationInfo specializationInfo{};
+        specializationInfo.mapEntryCount = static_cast<uint32_t>(entries.size());
+        specializationInfo.pMapEntries = entries.data();
+        specializationInfo.dataSize = data.size() * sizeof(uint32_t);
+        specializationInfo.pData = data.data();
+        return specializationInfo;
+    }
+
+    Shader::Shader(std::string const& filename, VkShaderStageFlagBits stage, Specialization const& constants)
+        : shaderStage(stage), name(filename), specialization(constants)
+    {
+        // Packed shaders were compiled when packed; stored ones become modules straight from the mapping
+        Archive const* assets = Archive::mounted();
+        Archive::Entry const* packed = assets ? assets->find("shaders/" + filename + ".spv") : nullptr;
+        if (packed) {
+            std::vector<uint8_t> scratch;
+            std::span<uint8_t const> code = assets->contents(*packed, scratch);
+            createModule(code.data(), code.size(), shaderModule);
+        }
+        else {
+            checkLog(filename);
+            auto code = readFile(".\\shaders\\" + filename + ".spv");
+            createModule(code.data(), code.size(), shaderModule);
+        }
+        specializationInfo = specialization.info();
     }
     Shader::~Shader() {
         if (shaderModule != VK_NULL_HANDLE) {
@@ -12,11 +53,11 @@ namespace vk {
         }
     }
     /* Private */
-    void Shader::createModule(const std::vector<char>& code, VkShaderModule& shaderModule) {
+    void Shader::createModule(void const* code, size_t size, VkShaderModule& shaderModule) {
         VkShaderModuleCreateInfo createInfo
         { VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO };
-        createInfo.codeSize = code.size();
-        createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+        createInfo.codeSize = size;
+        createInfo.pCode = static_cast<const uint32_t*>(code);
         VK_CHECK_RESULT(vkCreateShaderModule(GPU::device, &createInfo, nullptr, &shaderModule));
     }
 
@@ -1,17 +1,47 @@
 #pragma once
 
 #include "vk.gpu.h"
+#include "vk.archive.h"
 #include <string>
+#include <cstring>
+#include <type_traits>
 
 namespace vk {
+    struct Specialization
+    {// Constants patched into a shader when its pipeline is created; each 32-bit member of a block takes the next constant_id
+        Specialization() = default;
+        template<typename Block>
+        Specialization(Block const& block, uint32_t firstId = 0) {
+            static_assert(sizeof(Block) % sizeof(uint32_t) == 0 and std::is_trivially_copyable_v<Block>, "Specialization blocks are made of 32-bit scalars");
+            data.resize(sizeof(Block) / sizeof(uint32_t));
+            std::memcpy(data.data(), &block, sizeof(Block));
+            for (uint32_t i = 0; i < data.size(); i++) {
+                entries.push_back({ firstId + i, i * static_cast<uint32_t>(sizeof(uint32_t)), sizeof(uint32_t) });
+            }
+        }
+    public:
+        std::vector<VkSpecializationMapEntry> entries;
+        std::vector<uint32_t> data;
+
+        bool empty() const { return data.empty(); }
+        void set(uint32_t constantId, uint32_t value);
+        bool get(uint32_t constantId, uint32_t& value) const;
+        VkSpecializationInfo info() const;  // Points into this block
+    };
+
     struct Shader {
         VkShaderModule shaderModule;
         VkShaderStageFlagBits shaderStage;
-        Shader(std::string const& filename, VkShaderStageFlagBits stage);
+        std::string name;
+        Specialization specialization;
+        VkSpecializationInfo specializationInfo{};
+        Shader(std::string const& filename, VkShaderStageFlagBits stage, Specialization const& constants = {});
         ~Shader();
+    public:
+        VkSpecializationInfo const* constants() const { return specialization.empty() ? nullptr : &specializationInfo; }
     private:
         static std::vector<char> readFile(const std::string& filename);
-        static void createModule(const std::vector<char>& code, VkShaderModule& shaderModule);
+        static void createModule(void const* code, size_t size, VkShaderModule& shaderModule);
     };
     struct Shader_ {
         VkShaderModule shaderModule;
@@ -28,6 +58,7 @@ namespace vk {
 #define LOG_FILE(log) "bin\\"#log"_log.bin"
 
 #define SHADER_LOG LOG_FILE(shader)
+#define WORKGROUP_LOG LOG_FILE(workgroup)
 #endif
 
 #define NOMINMAX
@@ -32,6 +32,7 @@ struct pop {
 #include "vk.gpu.h"
 #include "vk.buffers.h"
 #include "descriptors.h"
+#include "vk.queue.h"
 
 namespace vk {
     struct SSBO : DataBuffer, Descriptor {
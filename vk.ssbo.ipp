@@ -18,7 +18,7 @@ namespace vk {
         VkCommandBuffer& commandBuffer = EngineCPU::renderCommands[SwapChain::currentFrame];
 
         VkDeviceSize offsets[] = { 0, 0 };
-        vkCmdBindVertexBuffers(commandBuffer, 0, 2, buffers.data(), offsets); // &SSBO.mBuffer
+        RenderState::bindVertexBuffers(commandBuffer, 2, buffers.data(), offsets); // &SSBO.mBuffer
         vkCmdDraw(commandBuffer, 1, vertexCount, 0, 0);
     }
     /* Private */
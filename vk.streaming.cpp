@@ -0,0 +1,359 @@
+#include "vk.streaming.h"
+#include "vk.textures.h"
+
+#include <stb_image.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <format>
+#include <iostream>
+#include <limits>
+#include <map>
+
+namespace vk {
+    /* Texture Streamer */
+    TextureStreamer::TextureStreamer(uint32_t workerCount, VkDeviceSize frameBudget) : frameBudget(frameBudget) {
+        for (uint32_t i = 0; i < workerCount; i++) {
+            workers.emplace_back([this](std::stop_token stop) {
+                while (true) {
+                    std::function<void()> job;
+                    {
+                        std::unique_lock lock(mutex);
+                        if (!wake.wait(lock, stop, [this] { return !jobs.empty(); })) {
+                            return;
+                        }
+                        job = std::move(jobs.front());
+                        jobs.pop_front();
+                    }
+                    job();
+                }
+            });
+        }
+    }
+    TextureStreamer::~TextureStreamer() {
+        // Workers finish the decode they are in; the rest are dropped with the queue
+        for (std::jthread& worker : workers) {
+            worker.request_stop();
+        }
+        workers.clear();
+        for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+            if (staging[i]) {
+                vkUnmapMemory(GPU::device, staging[i]->memory);
+                delete staging[i];
+            }
+        }
+    }
+    /* Public */
+    void TextureStreamer::record(VkCommandBuffer& commandBuffer) {
+        // Run waited this slot's graphics fence for any set readsGraphics found out of date, so those are free to rewrite;
+        // levels this upload makes resident reach each slot's set the next time it comes around
+        for (StreamedTexture* texture : textures) {
+            if (texture->setLevels[SwapChain::currentFrame] != texture->publishedLevel()) {
+                texture->writeDescriptorSet(SwapChain::currentFrame);
+            }
+        }
+        upload(commandBuffer, SwapChain::currentFrame, frameBudget);
+    }
+    bool TextureStreamer::readsGraphics() const {
+        return std::any_of(textures.begin(), textures.end(), [](StreamedTexture const* texture) {
+            return texture->setLevels[SwapChain::currentFrame] != texture->publishedLevel(); });
+    }
+    void TextureStreamer::flush() {
+        struct Transfer : Command {
+            VkCommandBuffer& begin() { beginCommand(); return cmdBuffer; }
+        };
+        // Nothing in flight may still read the staging buffers or the sets
+        vkDeviceWaitIdle(GPU::device);
+        while (!idle()) {
+            bool decoding = std::any_of(textures.begin(), textures.end(), [](StreamedTexture* texture) {
+                return texture->decoded and !texture->decoded->ready.load(std::memory_order_acquire); });
+            if (decoding) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            Transfer transfer;
+            upload(transfer.begin(), 0, std::numeric_limits<VkDeviceSize>::max());
+            transfer.endCommand();
+        }
+        for (StreamedTexture* texture : textures) {
+            for (uint32_t frame = 0; frame < MAX_FRAMES_IN_FLIGHT; frame++) {
+                texture->writeDescriptorSet(frame);
+            }
+        }
+    }
+    bool TextureStreamer::idle() const {
+        return std::all_of(textures.begin(), textures.end(), [](StreamedTexture const* texture) {
+            return texture->initialized and !texture->decoded; });
+    }
+    void TextureStreamer::benchmark(std::filesystem::path const& directory)
+    {// Every image in directory loaded three ways: synchronous Texture, streamed to placeholders, and streamed to full residency
+        std::vector<std::string> files;
+        for (std::filesystem::directory_entry const& entry : std::filesystem::directory_iterator(directory)) {
+            std::string extension = entry.path().extension().string();
+            std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return static_cast<char>(std::tolower(c)); });
+            if (extension == ".png" or extension == ".jpg" or extension == ".jpeg" or extension == ".tga" or extension == ".bmp") {
+                files.push_back(entry.path().string());
+            }
+        }
+        if (files.empty()) {
+            throw std::runtime_error(std::format("No images to benchmark in {}!", directory.string()));
+        }
+        using clock = std::chrono::steady_clock;
+        auto milliseconds = [](clock::time_point start) {
+            return std::chrono::duration<double, std::milli>(clock::now() - start).count(); };
+
+        auto start = clock::now();
+        {
+            std::vector<std::unique_ptr<Texture>> loaded;
+            for (std::string const& file : files) {
+                loaded.push_back(std::make_unique<Texture>(file.c_str()));
+            }
+        }
+        double synchronous = milliseconds(start);
+
+        start = clock::now();
+        TextureStreamer streamer;
+        std::vector<std::unique_ptr<StreamedTexture>> streamed;
+        for (std::string const& file : files) {
+            streamed.push_back(std::make_unique<StreamedTexture>(streamer, file.c_str()));
+        }
+        double placeholders = milliseconds(start);
+        streamer.flush();
+        double resident = milliseconds(start);
+
+        std::cout << std::format("Texture loading, {} images in {}\n", files.size(), directory.string());
+        std::cout << std::format("  synchronous:               {:9.1f} ms\n", synchronous);
+        std::cout << std::format("  streamed, placeholders:    {:9.1f} ms\n", placeholders);
+        std::cout << std::format("  streamed, fully resident:  {:9.1f} ms  ({} levels, {:.1f} MiB on {} workers)\n",
+            resident, streamer.uploaded.levels, streamer.uploaded.bytes / double(1 << 20), streamer.workers.size());
+    }
+    /* Private */
+    void TextureStreamer::enqueue(std::function<void()> job) {
+        {
+            std::lock_guard lock(mutex);
+            jobs.push_back(std::move(job));
+        }
+        wake.notify_one();
+    }
+    void TextureStreamer::upload(VkCommandBuffer& commandBuffer, uint32_t slot, VkDeviceSize budget)
+    {// Round-robin over decoded textures, one level each per pass, so every texture's coarse levels land before anyone's fine ones
+        std::vector<VkImageMemoryBarrier> before, after;
+        auto barrier = [](StreamedTexture const* texture, uint32_t baseLevel, uint32_t levelCount, VkImageLayout oldLayout, VkImageLayout newLayout,
+            VkAccessFlags srcAccess, VkAccessFlags dstAccess) {
+                VkImageMemoryBarrier memoryBarrier
+                { VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+                memoryBarrier.oldLayout = oldLayout;
+                memoryBarrier.newLayout = newLayout;
+                memoryBarrier.srcAccessMask = srcAccess;
+                memoryBarrier.dstAccessMask = dstAccess;
+                memoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                memoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                memoryBarrier.image = texture->Image;
+                memoryBarrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, baseLevel, levelCount, 0, 1 };
+                return memoryBarrier;
+            };
+
+        // New textures: every level cleared to the placeholder so any view of them is readable
+        std::vector<StreamedTexture*> fresh;
+        for (StreamedTexture* texture : textures) {
+            if (!texture->initialized) {
+                fresh.push_back(texture);
+                before.push_back(barrier(texture, 0, texture->mipLevels, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0, VK_ACCESS_TRANSFER_WRITE_BIT));
+            }
+        }
+        if (!fresh.empty()) {
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr,
+                static_cast<uint32_t>(before.size()), before.data());
+            VkClearColorValue grey = { { 0.5f, 0.5f, 0.5f, 1.0f } };
+            for (StreamedTexture* texture : fresh) {
+                VkImageSubresourceRange range{ VK_IMAGE_ASPECT_COLOR_BIT, 0, texture->mipLevels, 0, 1 };
+                vkCmdClearColorImage(commandBuffer, texture->Image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &grey, 1, &range);
+                after.push_back(barrier(texture, 0, texture->mipLevels, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                    VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT));
+                texture->initialized = true;
+            }
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr,
+                static_cast<uint32_t>(after.size()), after.data());
+            before.clear();
+            after.clear();
+        }
+
+        // Plan within the budget first, so the staging buffer is only resized before anything is copied from it
+        struct Level {
+            StreamedTexture* texture;
+            uint32_t level;
+            VkDeviceSize size;
+        };
+        for (StreamedTexture* texture : textures) {
+            if (texture->decoded and texture->decoded->ready.load(std::memory_order_acquire) and texture->decoded->failed) {
+                texture->decoded.reset();   // Stays the placeholder
+            }
+        }
+        std::vector<Level> plan;
+        std::map<StreamedTexture*, uint32_t> next;  // Level each texture would upload next, counting what is planned
+        VkDeviceSize planned = 0;
+        for (bool progress = true; progress;) {
+            progress = false;
+            for (StreamedTexture* texture : textures) {
+                if (!texture->decoded or !texture->decoded->ready.load(std::memory_order_acquire)) {
+                    continue;
+                }
+                uint32_t& level = next.try_emplace(texture, texture->nextLevel).first->second;
+                if (level == UINT32_MAX) {
+                    continue;   // Every level is planned
+                }
+                VkDeviceSize size = texture->decoded->levels[level].data.size();
+                if (planned > 0 and planned + size > budget) {
+                    continue;
+                }
+                plan.push_back({ texture, level--, size });
+                planned += size;
+                progress = true;
+            }
+        }
+        if (plan.empty()) {
+            return;
+        }
+        reserve(slot, planned);
+
+        std::vector<VkBufferImageCopy> copies;
+        VkDeviceSize offset = 0;
+        for (Level const& item : plan) {
+            StreamedTexture* texture = item.texture;
+            std::memcpy(static_cast<uint8_t*>(mapped[slot]) + offset, texture->decoded->levels[item.level].data.data(), item.size);
+
+            before.push_back(barrier(texture, item.level, 1, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0, VK_ACCESS_TRANSFER_WRITE_BIT));
+            after.push_back(barrier(texture, item.level, 1, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT));
+
+            VkBufferImageCopy region{};
+            region.bufferOffset = offset;
+            region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, item.level, 0, 1 };
+            region.imageExtent = { std::max(texture->extent.width >> item.level, 1u), std::max(texture->extent.height >> item.level, 1u), 1 };
+            copies.push_back(region);
+            offset += item.size;
+        }
+        // Earlier frames may still sample these levels; only execution has to wait for them
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr,
+            static_cast<uint32_t>(before.size()), before.data());
+        for (size_t i = 0; i < plan.size(); i++) {
+            vkCmdCopyBufferToImage(commandBuffer, staging[slot]->buffer, plan[i].texture->Image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copies[i]);
+        }
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr,
+            static_cast<uint32_t>(after.size()), after.data());
+
+        for (Level const& item : plan) {
+            StreamedTexture* texture = item.texture;
+            texture->residentLevel = item.level;
+            texture->nextLevel = item.level - 1;
+            if (item.level == 0) {
+                texture->decoded.reset();   // Everything is on the GPU
+            }
+            uploaded.levels++;
+            uploaded.bytes += item.size;
+        }
+    }
+    void TextureStreamer::reserve(uint32_t slot, VkDeviceSize size) {
+        if (staging[slot] and staging[slot]->size >= size) {
+            return;
+        }
+        if (staging[slot]) {
+            vkUnmapMemory(GPU::device, staging[slot]->memory);
+            delete staging[slot];
+        }
+        staging[slot] = new Buffer(std::max(size, std::min(frameBudget, VkDeviceSize(64) << 20)), VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        VK_CHECK_RESULT(vkMapMemory(GPU::device, staging[slot]->memory, 0, staging[slot]->size, 0, &mapped[slot]));
+    }
+    void TextureStreamer::decode(std::string const& filename, std::shared_ptr<Decoded> decoded)
+    {// The whole chain on the CPU, so the GPU never blits
+        int width, height, channels;
+        stbi_uc* pixels = loadPixels(filename, width, height, channels);
+        if (!pixels) {
+            std::cerr << std::format("failed to load texture image {}!\n", filename);
+            decoded->failed = true;
+            decoded->ready.store(true, std::memory_order_release);
+            return;
+        }
+        decoded->levels = ktx::mipChain(pixels, width, height, true);
+        stbi_image_free(pixels);
+        decoded->ready.store(true, std::memory_order_release);
+    }
+
+    /* Streamed Texture */
+    StreamedTexture::StreamedTexture(TextureStreamer& streamer, const char* filename)
+        : Descriptor(VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_SHADER_STAGE_FRAGMENT_BIT), streamer(streamer),
+        decoded(std::make_shared<TextureStreamer::Decoded>())
+    {
+        // Only the header is read here; the pixels are decoded on a worker
+        int width, height, channels;
+        if (!imageInfo(filename, width, height, channels)) {
+            throw std::runtime_error(std::format("failed to read texture image {}!", filename));
+        }
+        format = VK_FORMAT_R8G8B8A8_SRGB;
+        usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+        extent = { static_cast<uint32_t>(width), static_cast<uint32_t>(height) };
+        mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(extent.width, extent.height)))) + 1;
+        createImage(*this, VK_SAMPLE_COUNT_1_BIT, mipLevels);
+        createImageView(*this, mipLevels);
+
+        views.assign(mipLevels, VK_NULL_HANDLE);
+        views[0] = ImageView;
+        nextLevel = mipLevels - 1;
+        residentLevel = mipLevels;
+        for (uint32_t frame = 0; frame < MAX_FRAMES_IN_FLIGHT; frame++) {
+            writeDescriptorSet(frame);
+        }
+
+        streamer.textures.push_back(this);
+        streamer.enqueue([file = std::string(filename), decoded = decoded] {
+            TextureStreamer::decode(file, decoded);
+        });
+    }
+    StreamedTexture::~StreamedTexture() {
+        std::erase(streamer.textures, this);
+        // views[0] is ImageView, which Image destroys
+        for (uint32_t i = 1; i < views.size(); i++) {
+            if (views[i] != VK_NULL_HANDLE) {
+                vkDestroyImageView(GPU::device, views[i], nullptr);
+            }
+        }
+    }
+    float StreamedTexture::minLod() const {
+        return static_cast<float>(setLevels[SwapChain::currentFrame]);
+    }
+    /* Private */
+    VkImageView StreamedTexture::view(uint32_t baseLevel) {
+        if (views[baseLevel] != VK_NULL_HANDLE) {
+            return views[baseLevel];
+        }
+        VkImageViewCreateInfo viewInfo
+        { VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO };
+        viewInfo.image = Image;
+        viewInfo.format = format;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.subresourceRange = { aspect, baseLevel, mipLevels - baseLevel, 0, 1 };
+
+        VK_CHECK_RESULT(vkCreateImageView(GPU::device, &viewInfo, nullptr, &views[baseLevel]));
+        return views[baseLevel];
+    }
+    void StreamedTexture::writeDescriptorSet(uint32_t frame) {
+        uint32_t level = publishedLevel();
+
+        VkDescriptorImageInfo imageInfo{};
+        imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        imageInfo.imageView = view(level);
+
+        VkWriteDescriptorSet descriptorWrite
+        { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET };
+        descriptorWrite.dstSet = Sets[frame];
+        descriptorWrite.dstBinding = 0;
+        descriptorWrite.dstArrayElement = 0;
+        descriptorWrite.descriptorCount = 1;
+        descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+        descriptorWrite.pImageInfo = &imageInfo;
+        vkUpdateDescriptorSets(GPU::device, 1, &descriptorWrite, 0, nullptr);
+        setLevels[frame] = level;
+    }
+}
@@ -0,0 +1,91 @@
+#pragma once
+#ifndef hStreaming
+#define hStreaming
+
+#include "vk.compute.h"
+#include "vk.image.h"
+#include "vk.buffers.h"
+#include "descriptors.h"
+#include "vk.ktx.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace vk {
+    struct StreamedTexture;
+
+    struct TextureStreamer : ComputeTask
+    {// Decodes images on worker threads and uploads their mips smallest first, within a staging budget per frame
+        TextureStreamer(uint32_t workerCount = std::max(2u, std::thread::hardware_concurrency()) - 1, VkDeviceSize frameBudget = 8 << 20);
+        ~TextureStreamer();
+    public:
+        struct Stats {
+            uint32_t levels = 0;
+            VkDeviceSize bytes = 0;
+        };
+        VkDeviceSize frameBudget;   // Staging bytes per frame; a level larger than the budget still goes up, alone
+        Stats uploaded;             // Since creation
+
+        void record(VkCommandBuffer& commandBuffer) override;
+        bool readsGraphics() const override;    // A set of this slot, which its last graphics submission bound, is out of date
+        void flush();               // Blocks until everything queued is decoded and resident, as on a loading screen
+        bool idle() const;
+        static void benchmark(std::filesystem::path const& directory);
+    private:
+        friend struct StreamedTexture;
+        struct Decoded {
+            std::vector<ktx::Level> levels;     // Finest first
+            std::atomic<bool> ready = false;
+            bool failed = false;
+        };
+        std::vector<StreamedTexture*> textures;
+        std::array<Buffer*, MAX_FRAMES_IN_FLIGHT> staging{};   // Reused once the frame slot's compute fence has been waited on
+        std::array<void*, MAX_FRAMES_IN_FLIGHT> mapped{};
+
+        std::mutex mutex;
+        std::condition_variable_any wake;
+        std::deque<std::function<void()>> jobs;
+        std::vector<std::jthread> workers;
+
+        void enqueue(std::function<void()> job);
+        void upload(VkCommandBuffer& commandBuffer, uint32_t slot, VkDeviceSize budget);
+        void reserve(uint32_t slot, VkDeviceSize size);
+        static void decode(std::string const& filename, std::shared_ptr<Decoded> decoded);
+    };
+
+    struct StreamedTexture : Image, Descriptor
+    {// Sampled image that is usable at once as a grey placeholder and sharpens as its mips arrive
+     // Sets[i] views only levels resident before frame slot i last came around, and is rewritten when it comes around again,
+     // so bind Sets[SwapChain::currentFrame]
+        StreamedTexture(TextureStreamer& streamer, const char* filename);
+        ~StreamedTexture();
+    public:
+        uint32_t resident() const { return residentLevel; }     // Finest level uploaded; mipLevels before the first
+        bool complete() const { return residentLevel == 0; }
+        float minLod() const;   // The clamp the current slot's set applies, for shaders that sample every level through another view
+    private:
+        friend struct TextureStreamer;
+        TextureStreamer& streamer;
+        std::shared_ptr<TextureStreamer::Decoded> decoded;
+        bool initialized = false;   // Every level cleared to the placeholder and readable
+        uint32_t nextLevel;         // Next level to upload, counting down to 0
+        uint32_t residentLevel;
+        std::vector<VkImageView> views;                         // views[i] starts at level i; views[0] is ImageView
+        std::array<uint32_t, MAX_FRAMES_IN_FLIGHT> setLevels;   // Level each frame's set was written with
+
+        uint32_t publishedLevel() const { return std::min(residentLevel, mipLevels - 1); }  // Level a set written now starts at
+        VkImageView view(uint32_t baseLevel);
+        void writeDescriptorSet(uint32_t frame);
+    };
+}
+
+#endif
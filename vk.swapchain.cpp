@@ -1,19 +1,33 @@
 #include "vk.swapchain.h"
 
+#include <cstdlib>
+#include <string_view>
+
 namespace vk {
     /* Swapchain */
     SwapChain::SwapChain()
     {
+        char const* variable = std::getenv("VK_DYNAMIC_RENDERING");
+        dynamicRendering = dynamicRenderingSupported and !(variable and std::string_view(variable) == "0");
+        depthFormat = depth.format;
+        // Both belong to the one graphics pass; the depth outlives it only once sampleDepth is asked for
+        targets.add(color, { 0, 0 }, RenderTargets::Resolved);
+        targets.add(depth, RenderTargets::Persistent);
         createSwapChain(); // Cannot parallelize
         std::thread tImageViews([this] { createImageViews(); });
 
-        std::thread tColorImage([this] { color.createResource(); });
-        std::thread tDepthImage([this] { depth.createResource(); });
+        std::thread tTargets([this] { targets.create(Extent); });
 
-        std::thread tRenderPass([this] { createRenderPass(); });
+        std::thread tRenderPass([this] {
+            if (!dynamicRendering) {
+                createRenderPass();
+            }
+        });
 
-        tImageViews.join(); tColorImage.join(); tDepthImage.join(); tRenderPass.join();
-        createFramebuffers();
+        tImageViews.join(); tTargets.join(); tRenderPass.join();
+        if (!dynamicRendering) {
+            createFramebuffers();
+        }
     }
     SwapChain::~SwapChain()
     {
@@ -36,17 +50,61 @@ namespace vk {
             glfwWaitEvents();
         }
         vkDeviceWaitIdle(device);
+        // The surface decides the new size
+        querySwapChainSupport(physicalDevice);
+        getSwapExtent();
 
         cleanupSwapChain();
 
         createSwapChain();
 
         std::thread tImageViews([this] { createImageViews(); });
-        std::thread tColorImage([this] { color.createResource(); });
-        std::thread tDepthImage([this] { depth.createResource(); });
-        tImageViews.join(); tColorImage.join(); tDepthImage.join();
+        std::thread tTargets([this] { targets.create(Extent); });
+        tImageViews.join(); tTargets.join();
 
-        createFramebuffers();
+        if (!dynamicRendering) {
+            createFramebuffers();
+        }
+        generation++;
+    }
+    void SwapChain::setSampleCount(VkSampleCountFlagBits samples)
+    {// Pipelines read the count as dynamic state, so only the attachments are made again
+        samples = sampleCount(samples);
+        if (samples == msaaSamples) {
+            return;
+        }
+        if (!dynamicSampleCount) {
+            throw std::runtime_error("the sample count is baked into every pipeline on this device!");
+        }
+        if (!dynamicRendering) {
+            // Render pass compatibility includes the attachments' sample counts, so every pipeline would need remaking
+            throw std::runtime_error("the render pass fixes the sample count, and this run has no dynamic rendering!");
+        }
+        vkDeviceWaitIdle(device);
+        targets.destroy();
+        msaaSamples = samples;
+        targets.create(Extent);
+        generation++;
+    }
+    void SwapChain::sampleDepth()
+    {// Render pass compatibility ignores store ops, so pipelines made against the old pass still fit
+        if (depth.sampled()) {
+            return;
+        }
+        vkDeviceWaitIdle(device);
+        depth.usage = (depth.usage & ~VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT) | VK_IMAGE_USAGE_SAMPLED_BIT;
+        for (VkFramebuffer framebuffer : framebuffers) {
+            vkDestroyFramebuffer(device, framebuffer, nullptr);
+        }
+        framebuffers.clear();
+        targets.destroy();
+        targets.create(Extent);
+        if (!dynamicRendering) {
+            vkDestroyRenderPass(device, renderPass, nullptr);
+            createRenderPass();
+            createFramebuffers();
+        }
+        generation++;
     }
     //Private:
     void SwapChain::createSwapChain()
@@ -67,7 +125,9 @@ namespace vk {
         createInfo.imageColorSpace = surfaceFormat.colorSpace;
         createInfo.imageExtent = Extent;
         createInfo.imageArrayLayers = 1;
-        createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+        // Copied from only by Readback captures, where the surface allows it
+        capturable = capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | (capturable ? VK_IMAGE_USAGE_TRANSFER_SRC_BIT : 0);
 
         uint32_t queueFamilyIndices[] = { graphicsFamily.value(), presentFamily.value() };
 
@@ -116,11 +176,11 @@ namespace vk {
         framebuffers.resize(swapChainImageViews.size());
 
         for (size_t i = 0; i < swapChainImageViews.size(); i++) {
-            std::array<VkImageView, 3> attachments = {
-            color.ImageView,
-            depth.ImageView,
-            swapChainImageViews[i]
-            };
+            // At one sample there is no color target; the pass draws straight into the swapchain image
+            std::vector<VkImageView> attachments = { swapChainImageViews[i], depth.ImageView };
+            if (msaaSamples != VK_SAMPLE_COUNT_1_BIT) {
+                attachments = { color.ImageView, depth.ImageView, swapChainImageViews[i] };
+            }
 
             VkFramebufferCreateInfo framebufferInfo
             { VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO };
@@ -136,12 +196,20 @@ namespace vk {
     }
     void SwapChain::createRenderPass()
     {
+        bool resolve = msaaSamples != VK_SAMPLE_COUNT_1_BIT;
         VkAttachmentDescription colorAttachment = color.createAttachment();
         VkAttachmentDescription depthAttachment = depth.createAttachment();
         VkAttachmentDescription colorResolve    = color.createResolve();
+        if (!resolve) {
+            // The swapchain image is the color attachment itself
+            colorAttachment = colorResolve;
+            colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        }
 
-        std::array<VkAttachmentDescription, 3> attachments 
-        { colorAttachment, depthAttachment, colorResolve };
+        std::vector<VkAttachmentDescription> attachments{ colorAttachment, depthAttachment };
+        if (resolve) {
+            attachments.push_back(colorResolve);
+        }
 
         VkAttachmentReference colorAttachmentRef = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
         VkAttachmentReference depthAttachmentRef = { 1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
@@ -153,7 +221,7 @@ namespace vk {
         subpass.colorAttachmentCount = 1;
         subpass.pColorAttachments = &colorAttachmentRef;
         subpass.pDepthStencilAttachment = &depthAttachmentRef;
-        subpass.pResolveAttachments = &colorResolveRef;
+        subpass.pResolveAttachments = resolve ? &colorResolveRef : nullptr;
 
         VkSubpassDependency dependency{};
         dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
@@ -180,9 +248,9 @@ namespace vk {
     {
         std::for_each(std::execution::par, framebuffers.begin(), framebuffers.end(),
             [&](const auto& framebuffer) { vkDestroyFramebuffer(device, framebuffer, nullptr); });
+        framebuffers.clear();
 
-        std::jthread tColorImage([this] { color.destroyResource(); });
-        std::jthread tDepthImage([this] { depth.destroyResource(); });
+        targets.destroy();
 
         std::for_each(std::execution::par, swapChainImageViews.begin(), swapChainImageViews.end(),
             [&](const auto& imageView) { vkDestroyImageView(device, imageView, nullptr); });
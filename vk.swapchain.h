@@ -4,6 +4,7 @@
 
 #include "vk.gpu.h"
 #include "vk.image.h"
+#include "vk.targets.h"
 
 namespace vk {
     inline static double dt;
@@ -16,18 +17,31 @@ namespace vk {
         inline static double lastTime = 0.0;
 
         inline static VkSwapchainKHR swapChainKHR;
-        inline static VkRenderPass renderPass;
+        inline static VkRenderPass renderPass = VK_NULL_HANDLE;     // Stays null under dynamic rendering
+        // Passes begin with vkCmdBeginRendering, without render pass or framebuffers, wherever the device has it, so the
+        // sample count can change at runtime; chosen by the constructor before any pipeline is made, and VK_DYNAMIC_RENDERING=0
+        // keeps the render pass instead
+        inline static bool dynamicRendering = false;
+        inline static VkFormat colorFormat = VK_FORMAT_B8G8R8A8_SRGB;
+        inline static VkFormat depthFormat = VK_FORMAT_UNDEFINED;
         inline static uint32_t currentFrame = 0;
+        inline static uint32_t generation = 0;  // Bumped whenever the swapchain images are recreated
+        inline static bool capturable = false;  // Swapchain images can be copied from
 
         std::vector<VkImage> swapChainImages;
         std::vector<VkImageView> swapChainImageViews;
-        std::vector<VkFramebuffer> framebuffers;
+        std::vector<VkFramebuffer> framebuffers;    // Render pass mode only
         uint32_t mipLevels = 1;
 
         Color color;
         Depth depth;
+        RenderTargets targets;  // Color and depth; after them, so it goes first
 
         void recreateSwapChain();
+        // Takes effect from the next frame; throws, saying why, where the count is baked into pipelines or the render pass
+        void setSampleCount(VkSampleCountFlagBits samples);
+        // Keeps the depth after the pass and makes it sampleable, for readers of the previous frame's depth
+        void sampleDepth();
         
     protected:
         void deltaTime() {
@@ -0,0 +1,127 @@
+#include "vk.targets.h"
+
+#include <algorithm>
+
+namespace vk {
+    RenderTargets::~RenderTargets() {
+        destroy();
+        for (auto& [type, block] : blocks) {
+            vkFreeMemory(GPU::device, block.memory, nullptr);
+        }
+    }
+    /* Public */
+    void RenderTargets::add(Image& image, Lifetime lifetime, Sampling sampling) {
+        image.Image = VK_NULL_HANDLE;
+        image.ImageView = VK_NULL_HANDLE;
+        image.ImageMemory = VK_NULL_HANDLE;     // Never owned by the image itself
+        targets.push_back({ &image, lifetime, sampling });
+    }
+    void RenderTargets::create(VkExtent2D extent) {
+        std::map<uint32_t, std::vector<Target*>> groups;
+        std::map<uint32_t, bool> lazyTypes;
+        stats.requested = 0;
+        for (Target& target : targets) {
+            if (target.sampling == Resolved and GPU::msaaSamples == VK_SAMPLE_COUNT_1_BIT) {
+                continue;
+            }
+            Image& image = *target.image;
+            image.extent = extent;
+            Image::createHandle(image, target.sampling == Single ? VK_SAMPLE_COUNT_1_BIT : GPU::msaaSamples);
+            vkGetImageMemoryRequirements(GPU::device, image.Image, &target.requirements);
+
+            bool lazy;
+            uint32_t type = memoryType(image, target.requirements.memoryTypeBits, lazy);
+            groups[type].push_back(&target);
+            lazyTypes[type] = lazy;
+            stats.requested += target.requirements.size;
+        }
+        // Memory of a type no target wants any more goes back
+        std::erase_if(blocks, [&](auto const& entry) {
+            if (groups.contains(entry.first)) {
+                return false;
+            }
+            vkFreeMemory(GPU::device, entry.second.memory, nullptr);
+            return true;
+        });
+
+        stats.committed = 0;
+        stats.lazy = 0;
+        for (auto& [type, group] : groups) {
+            VkDeviceSize size = place(group);
+            Block& block = blocks[type];
+            // Reallocated to grow, or to give back most of it after a large shrink
+            if (block.size < size or size < block.size / 2) {
+                vkFreeMemory(GPU::device, block.memory, nullptr);
+                block.memory = VK_NULL_HANDLE;
+
+                VkMemoryAllocateInfo allocInfo
+                { VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO };
+                allocInfo.allocationSize = size;
+                allocInfo.memoryTypeIndex = type;
+                VK_CHECK_RESULT(vkAllocateMemory(GPU::device, &allocInfo, nullptr, &block.memory));
+                block.size = size;
+                block.lazy = lazyTypes[type];
+                stats.allocations++;
+            }
+            for (Target* target : group) {
+                VK_CHECK_RESULT(vkBindImageMemory(GPU::device, target->image->Image, block.memory, target->offset));
+                Image::createImageView(*target->image);
+            }
+            stats.committed += block.size;
+            stats.lazy += block.lazy ? block.size : 0;
+        }
+    }
+    void RenderTargets::destroy() {
+        for (Target& target : targets) {
+            Image& image = *target.image;
+            vkDestroyImageView(GPU::device, image.ImageView, nullptr);
+            vkDestroyImage(GPU::device, image.Image, nullptr);
+            image.ImageView = VK_NULL_HANDLE;
+            image.Image = VK_NULL_HANDLE;
+        }
+    }
+    /* Private */
+    VkDeviceSize RenderTargets::place(std::vector<Target*>& group)
+    {// Largest first, each into the first slot whose targets it never overlaps in time; a slot is as large as its first
+        std::sort(group.begin(), group.end(), [](Target const* a, Target const* b) {
+            return a->requirements.size > b->requirements.size; });
+        VkDeviceSize alignment = 1;
+        for (Target const* target : group) {
+            alignment = std::max(alignment, target->requirements.alignment);
+        }
+        struct Slot {
+            VkDeviceSize offset;
+            std::vector<Lifetime> lifetimes;
+        };
+        std::vector<Slot> slots;
+        VkDeviceSize end = 0;
+        for (Target* target : group) {
+            auto slot = std::find_if(slots.begin(), slots.end(), [&](Slot const& slot) {
+                return std::none_of(slot.lifetimes.begin(), slot.lifetimes.end(), [&](Lifetime const& lifetime) {
+                    return lifetime.overlaps(target->lifetime); });
+            });
+            if (slot == slots.end()) {
+                slots.push_back({ end });
+                slot = slots.end() - 1;
+                end = (end + target->requirements.size + alignment - 1) / alignment * alignment;
+            }
+            slot->lifetimes.push_back(target->lifetime);
+            target->offset = slot->offset;
+        }
+        return end;
+    }
+    uint32_t RenderTargets::memoryType(Image const& image, uint32_t typeBits, bool& lazy) {
+        lazy = false;
+        if (image.usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT) {
+            VkPhysicalDeviceMemoryProperties memProperties;
+            vkGetPhysicalDeviceMemoryProperties(GPU::physicalDevice, &memProperties);
+            for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+                if ((typeBits & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT)) {
+                    lazy = true;
+                    return i;
+                }
+            }
+        }
+        return GPU::findMemoryType(typeBits, image.properties);
+    }
+}
@@ -0,0 +1,66 @@
+#pragma once
+#ifndef hTargets
+#define hTargets
+
+#include "vk.image.h"
+
+#include <limits>
+#include <map>
+#include <vector>
+
+namespace vk {
+    struct RenderTargets
+    {// Attachments sized to the swapchain, in memory the pool keeps. Targets whose passes never overlap within a frame share
+     // their memory, so each such pass must begin them from an undefined layout; transient ones sit in lazily allocated
+     // memory where the device has it, which a tile-based GPU need never back. A resize that fits only remakes images and views
+        RenderTargets() = default;
+        ~RenderTargets();
+        RenderTargets(RenderTargets const&) = delete;
+        RenderTargets& operator=(RenderTargets const&) = delete;
+    public:
+        struct Lifetime {
+            uint32_t first;     // Of the frame's passes, in order, the first and last that write or read the target
+            uint32_t last;
+            bool overlaps(Lifetime const& other) const { return first <= other.last and other.first <= last; }
+        };
+        static constexpr Lifetime Persistent{ 0, std::numeric_limits<uint32_t>::max() };   // Read by the next frame too
+        enum Sampling {
+            Single,         // One sample
+            Multisampled,   // GPU::msaaSamples
+            Resolved,       // GPU::msaaSamples, and not made at one sample, where passes draw straight into its resolve target
+        };
+        struct Stats {
+            VkDeviceSize requested = 0;     // The targets' own sizes added up
+            VkDeviceSize committed = 0;     // Allocated for them, of which lazy may have nothing behind it
+            VkDeviceSize lazy = 0;
+            uint32_t allocations = 0;       // Since the pool was made; a resize that fits adds none
+        } stats;
+
+        // The pool creates and destroys the image's handles, from its format, usage, aspect and properties
+        void add(Image& image, Lifetime lifetime, Sampling sampling = Multisampled);
+        void create(VkExtent2D extent);     // Every image and view, at the current sample count
+        void destroy();                     // Images and views; memory is kept for the next create
+    private:
+        struct Target {
+            Image* image;
+            Lifetime lifetime;
+            Sampling sampling;
+            VkMemoryRequirements requirements{};
+            VkDeviceSize offset = 0;
+        };
+        struct Block {
+            VkDeviceMemory memory = VK_NULL_HANDLE;
+            VkDeviceSize size = 0;
+            bool lazy = false;
+        };
+        std::vector<Target> targets;
+        std::map<uint32_t, Block> blocks;   // By memory type
+
+        // Offsets within one block, and the size it needs
+        static VkDeviceSize place(std::vector<Target*>& group);
+        // Lazily allocated for transient attachments where a type has it, the image's own properties otherwise
+        static uint32_t memoryType(Image const& image, uint32_t typeBits, bool& lazy);
+    };
+}
+
+#endif
@@ -4,13 +4,34 @@
 #include <stb_image.h>
 
 namespace vk {
+    uint8_t* loadPixels(std::string const& filename, int& width, int& height, int& channels) {
+        Archive const* assets = Archive::mounted();
+        Archive::Entry const* packed = assets ? assets->find(Archive::name(filename)) : nullptr;
+        if (!packed) {
+            return stbi_load(filename.c_str(), &width, &height, &channels, STBI_rgb_alpha);
+        }
+        std::vector<uint8_t> scratch;
+        std::span<uint8_t const> bytes = assets->contents(*packed, scratch);
+        return stbi_load_from_memory(bytes.data(), static_cast<int>(bytes.size()), &width, &height, &channels, STBI_rgb_alpha);
+    }
+    bool imageInfo(std::string const& filename, int& width, int& height, int& channels) {
+        Archive const* assets = Archive::mounted();
+        Archive::Entry const* packed = assets ? assets->find(Archive::name(filename)) : nullptr;
+        if (!packed) {
+            return stbi_info(filename.c_str(), &width, &height, &channels);
+        }
+        std::vector<uint8_t> scratch;
+        std::span<uint8_t const> bytes = assets->contents(*packed, scratch);
+        return stbi_info_from_memory(bytes.data(), static_cast<int>(bytes.size()), &width, &height, &channels);
+    }
     /*------------------------------------------*/
     Texture::Texture(const char* filename) : Descriptor(VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_SHADER_STAGE_FRAGMENT_BIT)
     {
         format = VK_FORMAT_R8G8B8A8_SRGB;
-        usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+        usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+        MipChain::prepare(*this);
 
-        stbi_uc* pixels = stbi_load(filename, (int*)&extent.width, (int*)&extent.height, &texChannels, STBI_rgb_alpha);
+        stbi_uc* pixels = loadPixels(filename, (int&)extent.width, (int&)extent.height, texChannels);
         if (!pixels) {
             throw std::runtime_error("failed to load texture image!");
         }
@@ -19,11 +40,12 @@ namespace vk {
         createImage(*this, VK_SAMPLE_COUNT_1_BIT, mipLevels);
 
         VkDeviceSize imageSize = static_cast<uint64_t>(extent.width * extent.height * 4);
-        StageBuffer stagePixels(pixels, imageSize);
+        StagingRing::Allocation stagePixels = StagingRing::get().allocate(imageSize);
+        memcpy(stagePixels.data, pixels, static_cast<size_t>(imageSize));
         stbi_image_free(pixels);
 
         transitionImageLayout(VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-        copyBufferToImage(stagePixels.buffer);
+        copyBufferToImage(stagePixels.buffer, stagePixels.offset);
         generateMipmaps();
 
         createImageView(*this, mipLevels);
@@ -60,99 +82,21 @@ namespace vk {
 
         endCommand();
     }
-    void Texture::copyBufferToImage(VkBuffer& buffer)
+    void Texture::copyBufferToImage(VkBuffer& buffer, VkDeviceSize offset)
     {
         VkBufferImageCopy region = createCopyRegion(extent, aspect);
+        region.bufferOffset = offset;
 
         beginCommand();
         vkCmdCopyBufferToImage(Command::cmdBuffer, buffer, Image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
         endCommand();
     }
     void Texture::generateMipmaps()
-    {
-        // Check if image format supports linear blitting
-        VkFormatProperties formatProperties;
-        vkGetPhysicalDeviceFormatProperties(GPU::physicalDevice, format, &formatProperties);
-
-        if (!(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT)) {
-            throw std::runtime_error("texture image format does not support linear blitting!");
-        }
+    {// Every level from level 0 in compute, sRGB-correct; no linear blit support needed
+        MipChain chain(*this);
 
         beginCommand();
-
-        VkImageMemoryBarrier barrier
-        { VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
-        barrier.image = Image;
-        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        barrier.subresourceRange.baseArrayLayer = 0;
-        barrier.subresourceRange.layerCount = 1;
-        barrier.subresourceRange.levelCount = 1;
-
-        int32_t mipWidth = extent.width;
-        int32_t mipHeight = extent.height;
-
-        for (uint32_t i = 1; i < mipLevels; i++) {
-            barrier.subresourceRange.baseMipLevel = i - 1;
-            barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-            barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-            barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-
-            vkCmdPipelineBarrier(Command::cmdBuffer,
-                VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
-                0, nullptr,
-                0, nullptr,
-                1, &barrier);
-
-            VkImageBlit blit{};
-            blit.srcOffsets[0] = { 0, 0, 0 };
-            blit.srcOffsets[1] = { mipWidth, mipHeight, 1 };
-            blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-            blit.srcSubresource.mipLevel = i - 1;
-            blit.srcSubresource.baseArrayLayer = 0;
-            blit.srcSubresource.layerCount = 1;
-            blit.dstOffsets[0] = { 0, 0, 0 };
-            blit.dstOffsets[1] = { mipWidth > 1 ? mipWidth / 2 : 1, mipHeight > 1 ? mipHeight / 2 : 1, 1 };
-            blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-            blit.dstSubresource.mipLevel = i;
-            blit.dstSubresource.baseArrayLayer = 0;
-            blit.dstSubresource.layerCount = 1;
-
-            vkCmdBlitImage(Command::cmdBuffer,
-                Image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-                Image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                1, &blit,
-                VK_FILTER_LINEAR);
-
-            barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-            barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-            barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-            vkCmdPipelineBarrier(Command::cmdBuffer,
-                VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
-                0, nullptr,
-                0, nullptr,
-                1, &barrier);
-
-            if (mipWidth > 1) mipWidth /= 2;
-            if (mipHeight > 1) mipHeight /= 2;
-        }
-
-        barrier.subresourceRange.baseMipLevel = mipLevels - 1;
-        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-        vkCmdPipelineBarrier(Command::cmdBuffer,
-            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
-            0, nullptr,
-            0, nullptr,
-            1, &barrier);
-
+        chain.record(Command::cmdBuffer, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
         endCommand();
     }
 
@@ -180,13 +124,136 @@ namespace vk {
         }
     }
     /*------------------------------------------*/
+    CompressedTexture::CompressedTexture(std::filesystem::path const& base, std::vector<ktx::Codec> const& preference)
+        : Descriptor(VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_SHADER_STAGE_FRAGMENT_BIT)
+    {
+        // A mounted archive is looked in first, under the same names; stored levels are staged straight from its mapping
+        Archive const* assets = Archive::mounted();
+        Archive::Entry const* packed = nullptr;
+        std::filesystem::path path;
+        for (ktx::Codec candidate : preference) {
+            std::filesystem::path file = base;
+            file += "." + std::string(ktx::name(candidate)) + ".ktx2";
+            if (!supported(ktx::format(candidate, false))) {
+                continue;
+            }
+            packed = assets ? assets->find(Archive::name(file)) : nullptr;
+            if (packed or std::filesystem::exists(file)) {
+                path = file;
+                codec = candidate;
+                break;
+            }
+        }
+        if (path.empty()) {
+            throw std::runtime_error("no cooked texture for " + base.string() + " in a format this device samples!");
+        }
+        std::vector<uint8_t> content;
+        std::span<uint8_t const> encoded;
+        if (packed) {
+            encoded = assets->contents(*packed, content);
+        }
+        else {
+            std::ifstream stream(path, std::ios::binary | std::ios::ate);
+            if (!stream) {
+                throw std::runtime_error("failed to open " + path.string() + "!");
+            }
+            content.resize(static_cast<size_t>(stream.tellg()));
+            stream.seekg(0);
+            stream.read(reinterpret_cast<char*>(content.data()), content.size());
+            encoded = content;
+        }
+        ktx::View file = ktx::parse(encoded, path.string());
+        if (!supported(file.format)) {
+            throw std::runtime_error(path.string() + " is in a format this device cannot sample!");
+        }
+        format = file.format;
+        usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+        extent = { file.levels[0].width, file.levels[0].height };
+        mipLevels = static_cast<uint32_t>(file.levels.size());
+        createImage(*this, VK_SAMPLE_COUNT_1_BIT, mipLevels);
+
+        upload(file);
+
+        createImageView(*this, mipLevels);
+        writeDescriptorSets();
+    }
+    /* Private */
+    bool CompressedTexture::supported(VkFormat format)
+    {
+        if (format >= VK_FORMAT_BC1_RGB_UNORM_BLOCK and format <= VK_FORMAT_BC7_SRGB_BLOCK and !GPU::textureCompressionBC) {
+            return false;
+        }
+        VkFormatProperties formatProperties;
+        vkGetPhysicalDeviceFormatProperties(GPU::physicalDevice, format, &formatProperties);
+        VkFormatFeatureFlags required = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT | VK_FORMAT_FEATURE_TRANSFER_DST_BIT;
+        return (formatProperties.optimalTilingFeatures & required) == required;
+    }
+    void CompressedTexture::upload(ktx::View const& file)
+    {// Every level copied once, into the shared staging ring, and uploaded in one submission; nothing is generated on the GPU
+        bytes = 0;
+        for (ktx::LevelView const& level : file.levels) {
+            bytes += level.data.size();
+        }
+        // Level sizes are whole blocks, so every level after the first stays block-aligned too
+        StagingRing::Allocation stagePixels = StagingRing::get().allocate(bytes);
+        std::vector<VkBufferImageCopy> regions(mipLevels);
+        VkDeviceSize offset = 0;
+        for (uint32_t level = 0; level < mipLevels; level++) {
+            regions[level] = {};
+            regions[level].bufferOffset = stagePixels.offset + offset;
+            regions[level].imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1 };
+            regions[level].imageExtent = { file.levels[level].width, file.levels[level].height, 1 };
+            memcpy(static_cast<uint8_t*>(stagePixels.data) + offset, file.levels[level].data.data(), file.levels[level].data.size());
+            offset += file.levels[level].data.size();
+        }
+
+        beginCommand();
+
+        VkImageMemoryBarrier barrier = createMemoryBarrier(Image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mipLevels);
+        vkCmdPipelineBarrier(Command::cmdBuffer,
+            VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+            0, nullptr,
+            0, nullptr,
+            1, &barrier);
+
+        vkCmdCopyBufferToImage(Command::cmdBuffer, stagePixels.buffer, Image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mipLevels, regions.data());
+
+        updateMemoryBarrier(barrier, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        vkCmdPipelineBarrier(Command::cmdBuffer,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+            0, nullptr,
+            0, nullptr,
+            1, &barrier);
+
+        endCommand();
+        totalBytes += bytes;
+    }
+    void CompressedTexture::writeDescriptorSets(uint32_t bindingCount)
+    {
+        VkDescriptorImageInfo imageInfo{};
+        imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        imageInfo.imageView = ImageView;
+
+        for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+            VkWriteDescriptorSet descriptorWrite
+            { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET };
+            descriptorWrite.dstSet = Sets[i];
+            descriptorWrite.dstBinding = 0;
+            descriptorWrite.descriptorCount = 1;
+            descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+            descriptorWrite.pImageInfo = &imageInfo;
+            vkUpdateDescriptorSets(GPU::device, 1, &descriptorWrite, 0, nullptr);
+        }
+    }
+    /*------------------------------------------*/
     CombinedImageSampler::CombinedImageSampler(const char* filename)
         : Descriptor(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
     {
         format = VK_FORMAT_R8G8B8A8_SRGB;
-        usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+        usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+        MipChain::prepare(*this);
 
-        stbi_uc* pixels = stbi_load(filename, (int*)&extent.width, (int*)&extent.height, &texChannels, STBI_rgb_alpha);
+        stbi_uc* pixels = loadPixels(filename, (int&)extent.width, (int&)extent.height, texChannels);
         if (!pixels) {
             throw std::runtime_error("failed to load texture image!");
         }
@@ -195,11 +262,12 @@ namespace vk {
         createImage(*this, VK_SAMPLE_COUNT_1_BIT, mipLevels);
 
         VkDeviceSize imageSize = static_cast<uint64_t>(extent.width * extent.height * 4);
-        StageBuffer stagePixels(pixels, imageSize);
+        StagingRing::Allocation stagePixels = StagingRing::get().allocate(imageSize);
+        memcpy(stagePixels.data, pixels, static_cast<size_t>(imageSize));
         stbi_image_free(pixels);
 
         transitionImageLayout(VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-        copyBufferToImage(stagePixels.buffer);
+        copyBufferToImage(stagePixels.buffer, stagePixels.offset);
         generateMipmaps(); //transitioned to VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL while generating mipmaps
         
         createImageView(*this, mipLevels);
@@ -242,9 +310,10 @@ namespace vk {
 
         endCommand();
     }
-    void CombinedImageSampler::copyBufferToImage(VkBuffer& buffer)
+    void CombinedImageSampler::copyBufferToImage(VkBuffer& buffer, VkDeviceSize offset)
     {
         VkBufferImageCopy region = createCopyRegion(extent, aspect);
+        region.bufferOffset = offset;
 
         beginCommand();
 
@@ -253,65 +322,11 @@ namespace vk {
         endCommand();
     }
     void CombinedImageSampler::generateMipmaps()
-    {
-        // Check if image format supports linear blitting
-        VkFormatProperties formatProperties;
-        vkGetPhysicalDeviceFormatProperties(GPU::physicalDevice, format, &formatProperties);
-
-        if (!(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT)) {
-            throw std::runtime_error("texture image format does not support linear blitting!");
-        }
-
-        VkImageMemoryBarrier barrier = createMemoryBarrier(Image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);      
+    {// Every level from level 0 in compute, sRGB-correct; no linear blit support needed
+        MipChain chain(*this);
 
         beginCommand();
-
-        int32_t mipWidth = extent.width;
-        int32_t mipHeight = extent.height;
-        for (uint32_t i = 1; i < mipLevels; i++) {
-            updateMemoryBarrier(barrier, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
-
-            barrier.subresourceRange.baseMipLevel = i - 1;
-            
-            vkCmdPipelineBarrier(Command::cmdBuffer,
-                VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
-                0, nullptr,
-                0, nullptr,
-                1, &barrier);
-
-            VkImageBlit blit = createBlit(mipWidth, mipHeight, i);
-
-            vkCmdBlitImage(Command::cmdBuffer,
-                Image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-                Image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                1, &blit,
-                VK_FILTER_LINEAR);
-
-            updateMemoryBarrier(barrier, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-
-            vkCmdPipelineBarrier(Command::cmdBuffer,
-                VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
-                0, nullptr,
-                0, nullptr,
-                1, &barrier);
-
-            if (mipWidth > 1) mipWidth /= 2;
-            if (mipHeight > 1) mipHeight /= 2;
-        }
-
-        barrier.subresourceRange.baseMipLevel = mipLevels - 1;
-        //updateMemoryBarrier(barrier, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-        vkCmdPipelineBarrier(Command::cmdBuffer,
-            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
-            0, nullptr,
-            0, nullptr,
-            1, &barrier);
-
+        chain.record(Command::cmdBuffer, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
         endCommand();
     }
 
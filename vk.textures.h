@@ -6,8 +6,18 @@
 #include "vk.image.h"
 #include "vk.buffers.h"
 #include "descriptors.h"
+#include "vk.ktx.h"
+#include "vk.mipmaps.h"
+
+#include <cmath>
+#include <filesystem>
+#include <memory>
 
 namespace vk {
+    // Images are decoded from the mounted Archive when it has them under the same relative path, else from disk
+    uint8_t* loadPixels(std::string const& filename, int& width, int& height, int& channels);  // RGBA8, or nullptr; free with stbi_image_free
+    bool imageInfo(std::string const& filename, int& width, int& height, int& channels);
+
     struct Sampler : Descriptor {
         VkSampler sampler;
         Sampler(uint32_t mipLevels = 1, VkShaderStageFlagBits shaderFlags = VK_SHADER_STAGE_FRAGMENT_BIT)
@@ -70,12 +80,27 @@ namespace vk {
         ~Texture() = default;
     private:
         void transitionImageLayout(VkImageLayout oldLayout, VkImageLayout newLayout);
-        void copyBufferToImage(VkBuffer& buffer);
+        void copyBufferToImage(VkBuffer& buffer, VkDeviceSize offset = 0);
         void generateMipmaps();
 
         void writeDescriptorSets(uint32_t bindingCount = 1) override;
     };
     /*------------------------------------------*/
+    struct CompressedTexture : Image, Command, Descriptor
+    {// Precomputed mips from KTX2 files cooked offline; base.bc7.ktx2, base.bc3.ktx2 ... base.rgba8.ktx2, first one the device can sample
+        CompressedTexture(std::filesystem::path const& base, std::vector<ktx::Codec> const& preference = { ktx::Codec::BC7, ktx::Codec::BC3, ktx::Codec::BC1, ktx::Codec::RGBA8 });
+        ~CompressedTexture() = default;
+    public:
+        ktx::Codec codec;
+        VkDeviceSize bytes;     // Uploaded, over every level
+        inline static VkDeviceSize totalBytes = 0;
+    private:
+        static bool supported(VkFormat format);
+        void upload(ktx::View const& file);
+
+        void writeDescriptorSets(uint32_t bindingCount = 1) override;
+    };
+    /*------------------------------------------*/
     struct CombinedImageSampler : Image, Command, Descriptor {
         VkSampler Sampler;
         int texChannels;
@@ -84,7 +109,7 @@ namespace vk {
         ~CombinedImageSampler();
     private:
         void transitionImageLayout(VkImageLayout oldLayout, VkImageLayout newLayout);
-        void copyBufferToImage(VkBuffer& buffer);
+        void copyBufferToImage(VkBuffer& buffer, VkDeviceSize offset = 0);
         void generateMipmaps();
 
         void createTextureSampler();
@@ -92,25 +117,54 @@ namespace vk {
         void writeDescriptorSets(uint32_t bindingCount = 1) override;
     };
     /*------------------------------------------*/
-    struct ComputeImage : Image, CPU_<1>, Descriptor {
-        ComputeImage(VkExtent2D imageExtent, VkShaderStageFlagBits stageFlags = VK_SHADER_STAGE_VERTEX_BIT)
+    struct ComputeImage : Image, CPU_<1>, Descriptor, ComputeTask {
+        // mipmapped rebuilds the chain every frame, after the compute passes that write level 0
+        ComputeImage(VkExtent2D imageExtent, VkShaderStageFlagBits stageFlags = VK_SHADER_STAGE_VERTEX_BIT, bool mipmapped = false, MipFilter filter = MipFilter::Box)
             : Descriptor(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT | stageFlags)
         {
             format = VK_FORMAT_R8G8B8A8_UNORM;
             usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT;
             extent = imageExtent;
-
-            createImage(*this, VK_SAMPLE_COUNT_1_BIT);
+            if (mipmapped) {
+                mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(extent.width, extent.height)))) + 1;
+            }
+            createImage(*this, VK_SAMPLE_COUNT_1_BIT, mipLevels);
 
             setImageLayout(VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
 
+            // The storage descriptor sees level 0 only
             createImageView(*this);
+            if (mipmapped) {
+                VkImageViewCreateInfo viewInfo
+                { VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO };
+                viewInfo.image = Image;
+                viewInfo.format = format;
+                viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+                viewInfo.subresourceRange = { aspect, 0, mipLevels, 0, 1 };
+                VK_CHECK_RESULT(vkCreateImageView(GPU::device, &viewInfo, nullptr, &SampledView));
+                mips = std::make_unique<MipChain>(*this, filter);
+            }
 
             writeDescriptorSets();
         }
+        ~ComputeImage() {
+            if (SampledView != VK_NULL_HANDLE) {
+                vkDestroyImageView(GPU::device, SampledView, nullptr);
+            }
+        }
+    public:
+        VkImageView SampledView = VK_NULL_HANDLE;   // Every level, for filtered reads; only when mipmapped
+
+        void record(VkCommandBuffer& commandBuffer) override {
+            if (mips) {
+                mips->record(commandBuffer, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+            }
+        }
     private:
+        std::unique_ptr<MipChain> mips;
+
         void setImageLayout(VkImageLayout oldLayout, VkImageLayout newLayout) {
-            VkImageMemoryBarrier memoryBarrier = createMemoryBarrier(Image, oldLayout, newLayout);
+            VkImageMemoryBarrier memoryBarrier = createMemoryBarrier(Image, oldLayout, newLayout, mipLevels);
 
             VkPipelineStageFlags srcStageMask = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
             VkPipelineStageFlags dstStageMask = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
@@ -158,7 +212,6 @@ namespace vk {
         VkSampler Sampler;
         ComputeImage2(VkExtent2D imageExtent, VkShaderStageFlagBits stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT)
         {
-            createDescriptorPool();
             createDescriptorSetLayout(stageFlags);
             allocateDescriptorSets();
 
@@ -176,16 +229,10 @@ namespace vk {
             writeDescriptorSets();
         }
         ~ComputeImage2() {
-            if (Pool != VK_NULL_HANDLE) {
-                vkDestroyDescriptorPool(GPU::device, Pool, nullptr);
-            }
-            if (SetLayout != VK_NULL_HANDLE) {
-                vkDestroyDescriptorSetLayout(GPU::device, SetLayout, nullptr);
-            }
+            DescriptorAllocator::persistent->free(Sets);
             vkDestroySampler(GPU::device, Sampler, nullptr);
         }
     private:
-        VkDescriptorPool Pool;
         void setImageLayout(VkImageLayout oldLayout, VkImageLayout newLayout) {
             VkImageMemoryBarrier memoryBarrier = createMemoryBarrier(Image, oldLayout, newLayout);
 
@@ -233,20 +280,6 @@ namespace vk {
 
             VK_CHECK_RESULT(vkCreateSampler(GPU::device, &samplerInfo, nullptr, &Sampler));
         }
-        void createDescriptorPool() {
-            VkDescriptorPoolSize poolSizes[] = {
-                { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT) },
-                { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT) }
-            };
-
-            VkDescriptorPoolCreateInfo poolInfo
-            { VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO };
-            poolInfo.poolSizeCount = sizeof(poolSizes) / sizeof(*poolSizes);
-            poolInfo.pPoolSizes = poolSizes;
-            poolInfo.maxSets = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
-
-            VK_CHECK_RESULT(vkCreateDescriptorPool(GPU::device, &poolInfo, nullptr, &Pool));
-        }
         void createDescriptorSetLayout(VkShaderStageFlagBits stageFlags) {
             VkDescriptorType types[] = {
                 VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER
@@ -262,26 +295,11 @@ namespace vk {
                 layoutBindings[i].pImmutableSamplers = nullptr;
                 layoutBindings[i].stageFlags = flags[i];
             }
-
-            VkDescriptorSetLayoutCreateInfo layoutInfo
-            { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO };
-            layoutInfo.bindingCount = layoutBindings.size();
-            layoutInfo.pBindings = layoutBindings.data();
-
-            VK_CHECK_RESULT(vkCreateDescriptorSetLayout(GPU::device, &layoutInfo, nullptr, &SetLayout));
+            SetLayout = LayoutCache::setLayout(layoutBindings);
         }
         void allocateDescriptorSets() {
             std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, SetLayout);
-
-            VkDescriptorSetAllocateInfo allocInfo
-            { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO };
-            allocInfo.descriptorPool = Pool;
-            allocInfo.descriptorSetCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
-            allocInfo.pSetLayouts = layouts.data();
-
-            Sets.resize(MAX_FRAMES_IN_FLIGHT);
-
-            VK_CHECK_RESULT(vkAllocateDescriptorSets(GPU::device, &allocInfo, Sets.data()));
+            DescriptorAllocator::persistent->allocate(layouts, Sets);
         }
         void writeDescriptorSets(uint32_t bindingCount = 1) {
             VkWriteDescriptorSet allocWrite
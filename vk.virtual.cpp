@@ -0,0 +1,326 @@
+#include "vk.virtual.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cstring>
+#include <format>
+#include <iostream>
+
+namespace vk {
+    VirtualTexture::VirtualTexture(Shader const& generator, Parameters const& parameters, Settings const& settings, VkShaderStageFlags stages)
+        : settings(settings), generator(generator), parameters(parameters), stages(stages)
+    {
+        if (!std::has_single_bit(settings.window) or settings.window < 8 or settings.levels == 0 or settings.levels > 16) {
+            throw std::runtime_error("VirtualTexture needs a power-of-two window of at least 8 and 1 to 16 levels!");
+        }
+        if (settings.cacheSide * settings.cacheSide > 0xFFFF) {
+            throw std::runtime_error("VirtualTexture table entries index at most 65535 cache slots!");
+        }
+        // A border row and column past each page, so bilinear reads never leave its slot
+        format = VK_FORMAT_R32_SFLOAT;
+        usage = VK_IMAGE_USAGE_STORAGE_BIT;
+        extent = { settings.cacheSide * (settings.pageSize + 1), settings.cacheSide * (settings.pageSize + 1) };
+        createImage(*this, VK_SAMPLE_COUNT_1_BIT);
+        createImageView(*this);
+
+        table.resize(cells());
+        slots.resize(settings.cacheSide * settings.cacheSide);
+        invalidate();
+        tableBuffer = new Buffer(table.size() * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        jobBuffer = new Buffer(maxPagesPerFrame * sizeof(Job), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        // Count, a bit per table cell, then one request per cell at most, so the list cannot overflow
+        VkDeviceSize feedbackSize = requestOffset() + cells() * 4 * sizeof(int32_t);
+        for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+            feedbackBuffers.push_back(new Buffer(feedbackSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT));
+            void* mapped;
+            VK_CHECK_RESULT(vkMapMemory(GPU::device, feedbackBuffers[i]->memory, 0, feedbackSize, 0, &mapped));
+            feedback.push_back(static_cast<uint8_t*>(mapped));
+            memset(mapped, 0, static_cast<size_t>(feedbackSize));
+        }
+        // The cache stays in GENERAL for good; the table starts empty
+        struct Prepare : Command {
+            Prepare(VkImageMemoryBarrier const& barrier, VkBuffer table) {
+                beginCommand();
+                vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0,
+                    0, nullptr, 0, nullptr, 1, &barrier);
+                vkCmdFillBuffer(cmdBuffer, table, 0, VK_WHOLE_SIZE, 0);
+                endCommand();
+            }
+        } prepare(createMemoryBarrier(Image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL), tableBuffer->buffer);
+
+        SetLayout = LayoutCache::setLayout({
+            { 0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, stages, nullptr },
+            { 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, stages, nullptr },
+            { 2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, stages, nullptr }
+        });
+        generatorLayout = LayoutCache::setLayout({
+            { 0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr },
+            { 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr }
+        });
+        std::vector<VkDescriptorSetLayout> setLayouts(MAX_FRAMES_IN_FLIGHT, SetLayout);
+        DescriptorAllocator::persistent->allocate(setLayouts, Sets);
+        std::vector<VkDescriptorSetLayout> generatorLayouts{ generatorLayout };
+        std::vector<VkDescriptorSet> generatorSets;
+        DescriptorAllocator::persistent->allocate(generatorLayouts, generatorSets);
+        generatorSet = generatorSets[0];
+        layout = LayoutCache::pipelineLayout(generatorLayouts, { { VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(Push) } });
+        writeDescriptorSets();
+    }
+    VirtualTexture::~VirtualTexture() {
+        // The layouts belong to LayoutCache
+        DescriptorAllocator::persistent->free(Sets);
+        DescriptorAllocator::persistent->free({ generatorSet });
+        for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+            vkUnmapMemory(GPU::device, feedbackBuffers[i]->memory);
+            delete feedbackBuffers[i];
+        }
+        delete jobBuffer;
+        delete tableBuffer;
+    }
+    /* Public */
+    Specialization VirtualTexture::constants() const {
+        Specialization constants;
+        constants.set(0, settings.pageSize);
+        constants.set(1, settings.window);
+        constants.set(2, settings.levels);
+        constants.set(3, settings.cacheSide);
+        constants.set(4, std::bit_cast<uint32_t>(settings.texelSize));
+        constants.set(5, std::bit_cast<uint32_t>(settings.lodDistance));
+        return constants;
+    }
+    void VirtualTexture::record(VkCommandBuffer& commandBuffer)
+    {// Pages this slot's previous frame sampled are kept, or made, coarse first so there is always something to fall back on;
+     // run waited that frame's graphics fence, so its feedback is complete
+        frame++;
+        stats.generated = stats.evicted = 0;
+        if (!caching) {
+            invalidate();
+        }
+        uint8_t* frameFeedback = feedback[SwapChain::currentFrame];
+        uint32_t count = std::min(*reinterpret_cast<uint32_t*>(frameFeedback), cells());
+        int32_t const* requests = reinterpret_cast<int32_t const*>(frameFeedback + requestOffset());
+        std::vector<Key> missing;
+        for (uint32_t i = 0; i < count; i++) {
+            Key key{ static_cast<uint32_t>(requests[4 * i + 2]), requests[4 * i], requests[4 * i + 1] };
+            // Every ancestor stands in while its descendants are missing, so it is wanted and kept too
+            auto [level, x, y] = key;
+            for (; level < settings.levels; level++, x >>= 1, y >>= 1) {
+                auto page = resident.find({ level, x, y });
+                if (page != resident.end()) {
+                    slots[page->second].lastUsed = frame;
+                }
+                else {
+                    missing.push_back({ level, x, y });
+                }
+            }
+        }
+        std::sort(missing.begin(), missing.end(), [](Key const& a, Key const& b) {
+            return std::get<0>(a) != std::get<0>(b) ? std::get<0>(a) > std::get<0>(b) : a < b; });
+        missing.erase(std::unique(missing.begin(), missing.end()), missing.end());
+
+        stats.requested = count;
+        std::vector<Job> jobs;
+        for (Key const& key : missing) {
+            uint32_t slot;
+            if (jobs.size() == std::min(pagesPerFrame, maxPagesPerFrame) or !claim(slot)) {
+                break;
+            }
+            // The page takes its table cell over from whichever far-off page held it
+            uint32_t index = cell(key);
+            if (table[index] != 0) {
+                evict((table[index] & 0xFFFF) - 1);
+            }
+            slots[slot] = { key, frame };
+            resident[key] = slot;
+            table[index] = entry(key, slot);
+            tableDirty = true;
+
+            auto [level, x, y] = key;
+            int32_t originX = static_cast<int32_t>(slot % settings.cacheSide * (settings.pageSize + 1));
+            int32_t originY = static_cast<int32_t>(slot / settings.cacheSide * (settings.pageSize + 1));
+            jobs.push_back({ { originX, originY, 0, 0 }, { x, y, static_cast<int32_t>(level), 0 } });
+            stats.generated++;
+            stats.total++;
+        }
+        stats.resident = static_cast<uint32_t>(resident.size());
+
+        // Earlier frames' reads of the cache and table, and the last generation's of the jobs, finish before they are rewritten
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr);
+        if (!jobs.empty()) {
+            vkCmdUpdateBuffer(commandBuffer, jobBuffer->buffer, 0, jobs.size() * sizeof(Job), jobs.data());
+            VkMemoryBarrier jobBarrier
+            { VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+            jobBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            jobBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &jobBarrier, 0, nullptr, 0, nullptr);
+
+            Push push{ static_cast<int32_t>(settings.pageSize), parameters.words };
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, ComputeVariants::get(generator, layout, {}));
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, layout, 0, 1, &generatorSet, 0, nullptr);
+            vkCmdPushConstants(commandBuffer, layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(Push), &push);
+            // One 8x8 workgroup per tile of a page and its border, one layer of them per job
+            vkCmdDispatch(commandBuffer, (settings.pageSize + 8) / 8, (settings.pageSize + 8) / 8, static_cast<uint32_t>(jobs.size()));
+        }
+        if (tableDirty) {
+            // vkCmdUpdateBuffer takes 64 KiB at a time
+            VkDeviceSize bytes = table.size() * sizeof(uint32_t);
+            for (VkDeviceSize offset = 0; offset < bytes; offset += 65536) {
+                vkCmdUpdateBuffer(commandBuffer, tableBuffer->buffer, offset, std::min<VkDeviceSize>(65536, bytes - offset),
+                    reinterpret_cast<uint8_t const*>(table.data()) + offset);
+            }
+            tableDirty = false;
+        }
+        vkCmdFillBuffer(commandBuffer, feedbackBuffers[SwapChain::currentFrame]->buffer, 0, requestOffset(), 0);
+
+        VkMemoryBarrier sampleBarrier
+        { VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+        sampleBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        sampleBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 1, &sampleBarrier, 0, nullptr, 0, nullptr);
+    }
+    void VirtualTexture::regenerate(Parameters const& parameters) {
+        if (parameters != this->parameters) {
+            this->parameters = parameters;
+            invalidate();
+        }
+    }
+    void VirtualTexture::invalidate() {
+        // The cache keeps its texels, but nothing points at them any more
+        stats.evicted += static_cast<uint32_t>(resident.size());
+        resident.clear();
+        std::fill(table.begin(), table.end(), 0);
+        std::fill(slots.begin(), slots.end(), Slot{});
+        freeSlots.clear();
+        for (uint32_t slot = static_cast<uint32_t>(slots.size()); slot-- > 0;) {
+            freeSlots.push_back(slot);
+        }
+        tableDirty = true;
+    }
+    void VirtualTexture::benchmark(Shader const& generator, Parameters const& parameters, uint32_t frames)
+    {// Each frame is submitted and waited on alone, so its cost includes the submission; feedback is written here instead of by plane.vert
+        VirtualTexture texture(generator, parameters);
+        texture.pagesPerFrame = maxPagesPerFrame;
+        // What a viewer standing at the origin samples: the four pages meeting there, at every level
+        std::vector<std::array<int32_t, 4>> requests;
+        for (int32_t level = 0; level < static_cast<int32_t>(texture.settings.levels); level++) {
+            for (int32_t y = -1; y <= 0; y++) {
+                for (int32_t x = -1; x <= 0; x++) {
+                    requests.push_back({ x, y, level, 0 });
+                }
+            }
+        }
+        struct Frame : Command {
+            Frame(VirtualTexture& texture) {
+                beginCommand();
+                texture.record(cmdBuffer);
+                endCommand();
+            }
+        };
+        using clock = std::chrono::steady_clock;
+        auto run = [&](bool caching) {
+            texture.caching = caching;
+            texture.invalidate();
+            uint64_t first = texture.stats.total;
+            auto start = clock::now();
+            for (uint32_t i = 0; i < frames; i++) {
+                uint8_t* feedback = texture.feedback[SwapChain::currentFrame];
+                uint32_t count = static_cast<uint32_t>(requests.size());
+                memcpy(feedback, &count, sizeof(count));
+                memcpy(feedback + texture.requestOffset(), requests.data(), requests.size() * sizeof(requests[0]));
+                Frame frame(texture);
+            }
+            return std::pair{ std::chrono::duration<double>(clock::now() - start).count(), texture.stats.total - first };
+        };
+        auto [uncachedSeconds, uncachedPages] = run(false);
+        auto [cachedSeconds, cachedPages] = run(true);
+
+        uint32_t side = texture.settings.pageSize + 1;
+        std::cout << std::format("GPU terrain, {} frames sampling {} pages of {}x{} texels\n", frames, requests.size(), side, side);
+        std::cout << std::format("  uncached:  {:9.3f} ms/frame  {:9.1f} pages/s generated\n", 1000. * uncachedSeconds / frames, uncachedPages / uncachedSeconds);
+        std::cout << std::format("  cached:    {:9.3f} ms/frame  ({} pages generated, all in the first frame)\n", 1000. * cachedSeconds / frames, cachedPages);
+    }
+    /* Private */
+    uint32_t VirtualTexture::cell(Key const& key) const {
+        auto [level, x, y] = key;
+        uint32_t mask = settings.window - 1;
+        return (level * settings.window + (static_cast<uint32_t>(y) & mask)) * settings.window + (static_cast<uint32_t>(x) & mask);
+    }
+    uint32_t VirtualTexture::entry(Key const& key, uint32_t slot) const {
+        // The bits above the window tell apart the pages sharing a cell; the shader rebuilds the same tag
+        auto [level, x, y] = key;
+        int shift = std::countr_zero(settings.window);
+        uint32_t tag = static_cast<uint32_t>((x >> shift) & 0xFF) | (static_cast<uint32_t>((y >> shift) & 0xFF) << 8);
+        return (tag << 16) | (slot + 1);
+    }
+    bool VirtualTexture::claim(uint32_t& slot) {
+        if (freeSlots.empty()) {
+            // Least recently sampled, but never a page this frame asked for
+            uint32_t victim = UINT32_MAX;
+            uint64_t oldest = frame;
+            for (uint32_t i = 0; i < slots.size(); i++) {
+                if (slots[i].lastUsed < oldest) {
+                    oldest = slots[i].lastUsed;
+                    victim = i;
+                }
+            }
+            if (victim == UINT32_MAX) {
+                return false;
+            }
+            evict(victim);
+        }
+        slot = freeSlots.back();
+        freeSlots.pop_back();
+        return true;
+    }
+    void VirtualTexture::evict(uint32_t slot) {
+        Key const& key = slots[slot].key;
+        uint32_t index = cell(key);
+        if (table[index] == entry(key, slot)) {
+            table[index] = 0;
+            tableDirty = true;
+        }
+        resident.erase(key);
+        slots[slot] = {};
+        freeSlots.push_back(slot);
+        stats.evicted++;
+    }
+    void VirtualTexture::writeDescriptorSets() {
+        VkDescriptorImageInfo imageInfo{ VK_NULL_HANDLE, ImageView, VK_IMAGE_LAYOUT_GENERAL };
+        VkDescriptorBufferInfo tableInfo{ tableBuffer->buffer, 0, tableBuffer->size };
+        VkDescriptorBufferInfo jobInfo{ jobBuffer->buffer, 0, jobBuffer->size };
+
+        auto write = [](VkDescriptorSet set, uint32_t binding, VkDescriptorType type) {
+            VkWriteDescriptorSet descriptorWrite
+            { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET };
+            descriptorWrite.dstSet = set;
+            descriptorWrite.dstBinding = binding;
+            descriptorWrite.descriptorCount = 1;
+            descriptorWrite.descriptorType = type;
+            return descriptorWrite;
+        };
+        for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+            VkDescriptorBufferInfo feedbackInfo{ feedbackBuffers[i]->buffer, 0, feedbackBuffers[i]->size };
+            std::array<VkWriteDescriptorSet, 3> descriptorWrites{
+                write(Sets[i], 0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE),
+                write(Sets[i], 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER),
+                write(Sets[i], 2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER)
+            };
+            descriptorWrites[0].pImageInfo = &imageInfo;
+            descriptorWrites[1].pBufferInfo = &tableInfo;
+            descriptorWrites[2].pBufferInfo = &feedbackInfo;
+            vkUpdateDescriptorSets(GPU::device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+        }
+        std::array<VkWriteDescriptorSet, 2> generatorWrites{
+            write(generatorSet, 0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE),
+            write(generatorSet, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER)
+        };
+        generatorWrites[0].pImageInfo = &imageInfo;
+        generatorWrites[1].pBufferInfo = &jobInfo;
+        vkUpdateDescriptorSets(GPU::device, static_cast<uint32_t>(generatorWrites.size()), generatorWrites.data(), 0, nullptr);
+    }
+}
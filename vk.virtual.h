@@ -0,0 +1,111 @@
+#pragma once
+#ifndef hVirtual
+#define hVirtual
+
+#include "vk.compute.h"
+#include "vk.image.h"
+#include "vk.buffers.h"
+#include "vk.allocator.h"
+
+#include <array>
+#include <cstring>
+#include <map>
+#include <tuple>
+#include <type_traits>
+
+namespace vk {
+    struct VirtualTexture : Image, ComputeTask
+    {// One channel over unbounded texel space in fixed VRAM: a page table over a cache of pages that a compute generator
+     // fills on demand, for the pages the sampling shader asked for the last time this frame slot ran.
+     // Each level's table is a window of pages wrapping around the viewer; entries carry the page's high bits as a tag.
+        struct Settings {
+            uint32_t pageSize = 128;    // Texels per page edge, at the page's own level
+            uint32_t window = 32;       // Pages per table edge, per level; a power of two
+            uint32_t levels = 8;        // Each twice as coarse as the one before
+            uint32_t cacheSide = 16;    // Pages per cache edge
+            float texelSize = 0.025f;   // World units per level-0 texel
+            float lodDistance = 256.f;  // Level-0 texels from the viewer before level 1 takes over
+        };
+        struct Parameters
+        {// The generator's push constants past pageSize, e.g. noise::Terrain for plane.comp
+            Parameters() = default;
+            template<typename Block>
+            Parameters(Block const& block) {
+                static_assert(sizeof(Block) <= sizeof(words) and sizeof(Block) % sizeof(uint32_t) == 0 and std::is_trivially_copyable_v<Block>,
+                    "VirtualTexture parameters are at most seven 32-bit scalars");
+                memcpy(words.data(), &block, sizeof(Block));
+            }
+            std::array<uint32_t, 7> words{};
+            bool operator==(Parameters const&) const = default;
+        };
+        // The generator writes r32f set 0 binding 0 from Job records at binding 1; see plane.comp
+        VirtualTexture(Shader const& generator, Parameters const& parameters = {}, Settings const& settings = {}, VkShaderStageFlags stages = VK_SHADER_STAGE_VERTEX_BIT);
+        ~VirtualTexture();
+    public:
+        Settings const settings;
+        inline static constexpr uint32_t maxPagesPerFrame = 256;
+        uint32_t pagesPerFrame = 16;    // Generated at most per frame, coarsest first; up to maxPagesPerFrame
+        bool caching = true;            // Off, every page sampled is generated again each frame; to measure what the cache saves
+        struct Stats {
+            uint32_t requested;     // Pages this slot's previous frame sampled, read once run waited its graphics fence
+            uint32_t resident;
+            uint32_t generated;     // By this frame
+            uint32_t evicted;       // By this frame
+            uint64_t total;         // Generated since creation
+        } stats{};
+
+        VkDescriptorSetLayout SetLayout;
+        std::vector<VkDescriptorSet> Sets;      // Per frame: the cache, the table and that frame's feedback
+
+        Specialization constants() const;       // settings as constant_id 0 to 5 of the sampling shader
+        void record(VkCommandBuffer& commandBuffer) override;
+        bool readsGraphics() const override { return true; }    // The slot's feedback is written by its previous frame's draws
+        // Pages already made stay valid until the parameters actually change
+        void regenerate(Parameters const& parameters);
+        void invalidate();
+        // Generated pages per second and frame cost for a viewer standing still, cached and not
+        static void benchmark(Shader const& generator, Parameters const& parameters, uint32_t frames = 100);
+    private:
+        using Key = std::tuple<uint32_t, int32_t, int32_t>;    // Level, page x, page y
+        struct Slot {
+            Key key;
+            uint64_t lastUsed = 0;      // Frame that last sampled the page or one of its descendants
+        };
+        struct Job {
+            int32_t origin[4];          // Texel of the slot in the cache
+            int32_t page[4];            // x, y, level
+        };
+        struct Push {
+            int32_t pageSize;
+            std::array<uint32_t, 7> parameters;
+        };
+        Shader const& generator;
+        Parameters parameters;
+        VkShaderStageFlags stages;
+        uint64_t frame = 0;
+
+        std::vector<uint32_t> table;    // Slot + 1 in the low half, tag in the high; mirrored to tableBuffer when dirty
+        bool tableDirty = false;
+        std::map<Key, uint32_t> resident;
+        std::vector<Slot> slots;
+        std::vector<uint32_t> freeSlots;
+
+        Buffer* tableBuffer;
+        Buffer* jobBuffer;
+        std::vector<Buffer*> feedbackBuffers;
+        std::vector<uint8_t*> feedback;
+        VkDescriptorSetLayout generatorLayout;
+        VkDescriptorSet generatorSet;
+        VkPipelineLayout layout;
+
+        uint32_t cells() const { return settings.levels * settings.window * settings.window; }
+        VkDeviceSize requestOffset() const { return 16 + cells() / 32 * sizeof(uint32_t); }
+        uint32_t cell(Key const& key) const;
+        uint32_t entry(Key const& key, uint32_t slot) const;
+        bool claim(uint32_t& slot);
+        void evict(uint32_t slot);
+        void writeDescriptorSets();
+    };
+}
+
+#endif